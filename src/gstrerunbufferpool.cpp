@@ -0,0 +1,171 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "gstrerunbufferpool.hpp"
+#include "rerunframepacker.hpp"
+
+#include <gst/video/gstvideometa.h>
+#include <gst/video/gstvideopool.h>
+
+#include <cstdlib>
+#include <sys/mman.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_rerun_buffer_pool_debug);
+#define GST_CAT_DEFAULT gst_rerun_buffer_pool_debug
+
+#define RERUN_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+struct _GstRerunBufferPool {
+    GstBufferPool parent_instance;
+
+    GstVideoInfo info;
+    RerunPlaneLayout layout;
+    gboolean add_video_meta;     // Upstream understands GstVideoMeta, use the tight layout
+    gboolean huge_pages;
+    gsize buffer_size;
+    GstAllocationParams params;
+};
+
+G_DEFINE_TYPE(GstRerunBufferPool, gst_rerun_buffer_pool, GST_TYPE_BUFFER_POOL)
+
+static const gchar** gst_rerun_buffer_pool_get_options(GstBufferPool* pool) {
+    static const gchar* options[] = { GST_BUFFER_POOL_OPTION_VIDEO_META, NULL };
+    return options;
+}
+
+static gboolean gst_rerun_buffer_pool_set_config(GstBufferPool* pool, GstStructure* config) {
+    GstRerunBufferPool* self = GST_RERUN_BUFFER_POOL(pool);
+    GstCaps* caps = NULL;
+    guint size, min_buffers, max_buffers;
+
+    if (!gst_buffer_pool_config_get_params(config, &caps, &size, &min_buffers, &max_buffers) || !caps) {
+        GST_WARNING_OBJECT(pool, "Invalid pool configuration");
+        return FALSE;
+    }
+
+    if (!gst_video_info_from_caps(&self->info, caps)) {
+        GST_WARNING_OBJECT(pool, "Failed to get video info from caps");
+        return FALSE;
+    }
+
+    rerun_plane_layout_init(&self->layout, &self->info);
+    self->add_video_meta = gst_buffer_pool_config_has_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+    // Without GstVideoMeta upstream assumes the default GStreamer layout, which
+    // may pad rows, so the tight layout can only be used when meta is accepted
+    self->buffer_size = self->add_video_meta ? self->layout.size : GST_VIDEO_INFO_SIZE(&self->info);
+
+    gst_allocation_params_init(&self->params);
+    self->params.align = GST_RERUN_BUFFER_POOL_ALIGN;
+
+    GST_DEBUG_OBJECT(pool, "%dx%d %s, %" G_GSIZE_FORMAT " bytes per buffer, video meta: %s, huge pages: %s",
+                     GST_VIDEO_INFO_WIDTH(&self->info), GST_VIDEO_INFO_HEIGHT(&self->info),
+                     gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&self->info)),
+                     self->buffer_size, self->add_video_meta ? "yes" : "no",
+                     self->huge_pages ? "yes" : "no");
+
+    gst_buffer_pool_config_set_params(config, caps, self->buffer_size, min_buffers, max_buffers);
+
+    return GST_BUFFER_POOL_CLASS(gst_rerun_buffer_pool_parent_class)->set_config(pool, config);
+}
+
+static GstMemory* rerun_huge_page_memory_new(gsize size) {
+    gsize maxsize = (size + RERUN_HUGE_PAGE_SIZE - 1) & ~((gsize)RERUN_HUGE_PAGE_SIZE - 1);
+    void* data = NULL;
+
+    if (posix_memalign(&data, RERUN_HUGE_PAGE_SIZE, maxsize) != 0) {
+        return NULL;
+    }
+
+#ifdef MADV_HUGEPAGE
+    // Best effort: the kernel may still back the range with regular pages
+    madvise(data, maxsize, MADV_HUGEPAGE);
+#endif
+
+    return gst_memory_new_wrapped((GstMemoryFlags)0, data, maxsize, 0, size, data, free);
+}
+
+static GstFlowReturn gst_rerun_buffer_pool_alloc_buffer(
+    GstBufferPool* pool,
+    GstBuffer** buffer,
+    GstBufferPoolAcquireParams* params) {
+
+    GstRerunBufferPool* self = GST_RERUN_BUFFER_POOL(pool);
+    GstMemory* memory = NULL;
+
+    if (self->huge_pages) {
+        memory = rerun_huge_page_memory_new(self->buffer_size);
+        if (!memory) {
+            GST_WARNING_OBJECT(pool, "Huge page allocation failed, falling back to regular memory");
+        }
+    }
+
+    if (!memory) {
+        memory = gst_allocator_alloc(NULL, self->buffer_size, &self->params);
+    }
+
+    if (!memory) {
+        GST_ERROR_OBJECT(pool, "Failed to allocate %" G_GSIZE_FORMAT " bytes", self->buffer_size);
+        return GST_FLOW_ERROR;
+    }
+
+    *buffer = gst_buffer_new();
+    gst_buffer_append_memory(*buffer, memory);
+
+    if (self->add_video_meta) {
+        gint strides[GST_VIDEO_MAX_PLANES] = { 0 };
+        for (guint plane = 0; plane < self->layout.n_planes; ++plane) {
+            strides[plane] = (gint)self->layout.row_bytes[plane];
+        }
+
+        gst_buffer_add_video_meta_full(*buffer, GST_VIDEO_FRAME_FLAG_NONE,
+                                       GST_VIDEO_INFO_FORMAT(&self->info),
+                                       GST_VIDEO_INFO_WIDTH(&self->info),
+                                       GST_VIDEO_INFO_HEIGHT(&self->info),
+                                       self->layout.n_planes, self->layout.offset, strides);
+    }
+
+    return GST_FLOW_OK;
+}
+
+static void gst_rerun_buffer_pool_init(GstRerunBufferPool* self) {
+    gst_video_info_init(&self->info);
+    self->add_video_meta = FALSE;
+    self->huge_pages = FALSE;
+    self->buffer_size = 0;
+}
+
+static void gst_rerun_buffer_pool_class_init(GstRerunBufferPoolClass* klass) {
+    GstBufferPoolClass* pool_class = GST_BUFFER_POOL_CLASS(klass);
+
+    pool_class->get_options = gst_rerun_buffer_pool_get_options;
+    pool_class->set_config = gst_rerun_buffer_pool_set_config;
+    pool_class->alloc_buffer = gst_rerun_buffer_pool_alloc_buffer;
+
+    GST_DEBUG_CATEGORY_INIT(gst_rerun_buffer_pool_debug, "rerunbufferpool", 0, "Rerun sink buffer pool");
+}
+
+GstBufferPool* gst_rerun_buffer_pool_new(gboolean huge_pages) {
+    GstRerunBufferPool* self = (GstRerunBufferPool*)g_object_new(GST_TYPE_RERUN_BUFFER_POOL, NULL);
+    self->huge_pages = huge_pages;
+
+    return GST_BUFFER_POOL(self);
+}
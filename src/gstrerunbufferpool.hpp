@@ -0,0 +1,45 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __GST_RERUN_BUFFER_POOL_H__
+#define __GST_RERUN_BUFFER_POOL_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_RERUN_BUFFER_POOL (gst_rerun_buffer_pool_get_type())
+G_DECLARE_FINAL_TYPE(GstRerunBufferPool, gst_rerun_buffer_pool, GST, RERUN_BUFFER_POOL, GstBufferPool)
+
+// Alignment mask (cache line) used for pool memory and allocation params
+#define GST_RERUN_BUFFER_POOL_ALIGN 63
+
+// Buffer pool offered to upstream in the ALLOCATION query. When upstream
+// accepts GstVideoMeta, buffers are laid out exactly as Rerun expects them
+// (planes back to back, no row padding), so they can be logged without
+// repacking. Memory is cache-line aligned and optionally backed by
+// transparent huge pages.
+GstBufferPool* gst_rerun_buffer_pool_new(gboolean huge_pages);
+
+G_END_DECLS
+
+#endif // __GST_RERUN_BUFFER_POOL_H__
@@ -19,6 +19,16 @@
  */
 
 #include "gstrerunsink.hpp"
+#include "gstrerunbufferpool.hpp"
+#include "rerunframepacker.hpp"
+#include "rerunh264.hpp"
+#include "rerunimageencoder.hpp"
+#include "rerunlogworker.hpp"
+#include "rerunmp4.hpp"
+#include "rerunoutput.hpp"
+#include "rerunscaler.hpp"
+#include "rerunswizzle.hpp"
+#include "rerunvideoencoder.hpp"
 
 #include "gst/gstbuffer.h"
 #include "gst/gstminiobject.h"
@@ -37,6 +47,8 @@
 #include <rerun/archetypes/video_stream.hpp>
 #include <rerun/components/image_format.hpp>
 
+#include <deque>
+#include <map>
 #include <vector> 
 
 #ifdef HAVE_NVMM_SUPPORT
@@ -55,186 +67,1855 @@ GST_DEBUG_CATEGORY_STATIC(gst_rerun_sink_debug);
 #define DEFAULT_SPAWN_VIEWER TRUE
 #define DEFAULT_OUTPUT_FILE NULL
 #define DEFAULT_VIDEO_PATH NULL
+#define DEFAULT_HUGE_PAGES FALSE
+#define DEFAULT_ASYNC_LOGGING FALSE
+#define DEFAULT_QUEUE_DEPTH 4
+#define DEFAULT_QUEUE_POLICY RERUN_QUEUE_POLICY_BLOCK
+#define DEFAULT_MAX_FPS 0.0
+#define DEFAULT_KEEP_EVERY 1
+#define DEFAULT_SCALE_FACTOR 1
+#define DEFAULT_TARGET_SIZE 0
+#define DEFAULT_FULL_RES_EVERY 0
+#define DEFAULT_IMAGE_ENCODING RERUN_IMAGE_ENCODING_NONE
+#define DEFAULT_JPEG_QUALITY 85
+#define DEFAULT_ENCODER_THREADS 0
+#define DEFAULT_KEYFRAME_MARKERS FALSE
+#define DEFAULT_REFERENCE_DROPPING FALSE
+#define DEFAULT_FORCE_KEY_UNITS TRUE
+#define DEFAULT_VIDEO_ENCODING RERUN_VIDEO_ENCODING_NONE
+#define DEFAULT_VIDEO_ENCODER "x264enc"
+#define DEFAULT_VIDEO_BITRATE 4000
+#define DEFAULT_KEYFRAME_INTERVAL 60
+#define DEFAULT_SPEED_PRESET "ultrafast"
+#define DEFAULT_SEGMENT_DURATION 0
+#define DEFAULT_OFFLINE FALSE
+#define DEFAULT_OUTPUTS NULL
+#define DEFAULT_ROTATE_SIZE 0
+#define DEFAULT_ROTATE_DURATION 0
+#define DEFAULT_MAX_FILES 0
+#define DEFAULT_INDEX_FILE NULL
+#define DEFAULT_WRITE_SIZE 0
+#define DEFAULT_PREALLOCATE 0
+#define DEFAULT_DIRECT_IO FALSE
+#define DEFAULT_SYNC_INTERVAL 0
+
+// Minimum time between repeated key unit requests while one is pending
+#define KEY_UNIT_RETRY_INTERVAL G_USEC_PER_SEC
+
+// Buffers the sink may hold while upstream keeps producing
+#define POOL_MIN_BUFFERS 2
+
+#define FORMAT_CAPS GST_VIDEO_CAPS_MAKE("{ NV12, NV21, I420, Y42B, Y444, YUY2, UYVY, RGB, RGBA, BGR, BGRA, " \
+                                        "BGRx, RGBx, xRGB, xBGR, ARGB, ABGR, GRAY8, GRAY16_LE }")
+#define FORMAT_NVMM_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{NV12}")
+#define ENCODED_CAPS "video/x-h264, stream-format=(string){ byte-stream, avc, avc3 }, alignment=(string){ au, nal }; video/x-h265, stream-format=(string){ hvc1, hev1, byte-stream }, alignment=(string)au"
+#define IMAGE_CAPS "image/jpeg; image/png"
+
+#ifdef HAVE_NVMM_SUPPORT
+#define RERUN_SINK_CAPS FORMAT_CAPS ";" FORMAT_NVMM_CAPS ";" ENCODED_CAPS ";" IMAGE_CAPS
+#else
+#define RERUN_SINK_CAPS FORMAT_CAPS ";" ENCODED_CAPS ";" IMAGE_CAPS
+#endif
+
+enum {
+  PROP_0,
+  PROP_RECORDING_ID,
+  PROP_IMAGE_PATH,
+  PROP_SPAWN_VIEWER,
+  PROP_OUTPUT_FILE,
+  PROP_GRPC_ADDRESS,
+  PROP_VIDEO_PATH,
+  PROP_HUGE_PAGES,
+  PROP_ASYNC_LOGGING,
+  PROP_QUEUE_DEPTH,
+  PROP_QUEUE_POLICY,
+  PROP_MAX_FPS,
+  PROP_KEEP_EVERY,
+  PROP_SCALE_FACTOR,
+  PROP_TARGET_SIZE,
+  PROP_FULL_RES_EVERY,
+  PROP_IMAGE_ENCODING,
+  PROP_JPEG_QUALITY,
+  PROP_ENCODER_THREADS,
+  PROP_KEYFRAME_MARKERS,
+  PROP_REFERENCE_DROPPING,
+  PROP_FORCE_KEY_UNITS,
+  PROP_VIDEO_ENCODING,
+  PROP_VIDEO_ENCODER,
+  PROP_VIDEO_BITRATE,
+  PROP_KEYFRAME_INTERVAL,
+  PROP_SPEED_PRESET,
+  PROP_SEGMENT_DURATION,
+  PROP_OFFLINE,
+  PROP_OUTPUTS,
+  PROP_ROTATE_SIZE,
+  PROP_ROTATE_DURATION,
+  PROP_MAX_FILES,
+  PROP_INDEX_FILE,
+  PROP_WRITE_SIZE,
+  PROP_PREALLOCATE,
+  PROP_DIRECT_IO,
+  PROP_SYNC_INTERVAL,
+  PROP_STATS,
+};
+
+enum {
+  SIGNAL_RRD_DATA,
+  LAST_SIGNAL,
+};
+
+static guint gst_rerun_sink_signals[LAST_SIGNAL] = { 0 };
+
+#define GST_CAT_DEFAULT gst_rerun_sink_debug
+
+#define GST_TYPE_RERUN_SINK_QUEUE_POLICY (gst_rerun_sink_queue_policy_get_type())
+static GType gst_rerun_sink_queue_policy_get_type(void) {
+    static GType policy_type = 0;
+    static const GEnumValue policies[] = {
+        {RERUN_QUEUE_POLICY_BLOCK, "Block the streaming thread until there is room", "block"},
+        {RERUN_QUEUE_POLICY_DROP_OLDEST, "Drop the oldest queued frame", "drop-oldest"},
+        {RERUN_QUEUE_POLICY_DROP_NEWEST, "Drop the incoming frame", "drop-newest"},
+        {0, NULL, NULL},
+    };
+
+    if (!policy_type) {
+        policy_type = g_enum_register_static("GstRerunSinkQueuePolicy", policies);
+    }
+    return policy_type;
+}
+
+#define GST_TYPE_RERUN_SINK_IMAGE_ENCODING (gst_rerun_sink_image_encoding_get_type())
+static GType gst_rerun_sink_image_encoding_get_type(void) {
+    static GType encoding_type = 0;
+    static const GEnumValue encodings[] = {
+        {RERUN_IMAGE_ENCODING_NONE, "Log raw images", "none"},
+        {RERUN_IMAGE_ENCODING_JPEG, "Log JPEG encoded images", "jpeg"},
+        {RERUN_IMAGE_ENCODING_PNG, "Log PNG encoded images (RGB, RGBA and GRAY8)", "png"},
+        {0, NULL, NULL},
+    };
+
+    if (!encoding_type) {
+        encoding_type = g_enum_register_static("GstRerunSinkImageEncoding", encodings);
+    }
+    return encoding_type;
+}
+
+#define GST_TYPE_RERUN_SINK_VIDEO_ENCODING (gst_rerun_sink_video_encoding_get_type())
+static GType gst_rerun_sink_video_encoding_get_type(void) {
+    static GType encoding_type = 0;
+    static const GEnumValue encodings[] = {
+        {RERUN_VIDEO_ENCODING_NONE, "Log raw frames as images", "none"},
+        {RERUN_VIDEO_ENCODING_H264, "Encode raw frames to an H.264 video stream", "h264"},
+        {0, NULL, NULL},
+    };
+
+    if (!encoding_type) {
+        encoding_type = g_enum_register_static("GstRerunSinkVideoEncoding", encodings);
+    }
+    return encoding_type;
+}
+
+typedef struct _RerunRenderPlan RerunRenderPlan;
+typedef struct _RerunEncodeJob RerunEncodeJob;
+
+typedef GstFlowReturn (*RerunRenderFunc)(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    GstBuffer* buffer,
+    const RerunFrameTime* time);
+
+// Everything the hot path needs to know about the negotiated caps. A plan is
+// built once per caps in set_caps() and never modified afterwards, so render()
+// only has to dereference it. Caps changes publish a new plan instead.
+struct _RerunRenderPlan {
+    gint ref_count;
+    guint generation;                 // Caps generation this plan was built for
+    RerunRenderFunc render;           // Handler selected for these caps
+
+    gint width;
+    gint height;
+
+    // Raw video
+    GstVideoInfo info;
+    RerunPlaneLayout layout;
+    gboolean has_pixel_format;        // Use pixel_format, otherwise color_model + datatype
+    rerun::datatypes::PixelFormat pixel_format;
+    rerun::datatypes::ColorModel color_model;
+    rerun::datatypes::ChannelDatatype datatype;
+
+    // Downscaled preview, only used when scale_factor > 1
+    guint scale_factor;
+    GstVideoInfo scaled_info;
+    RerunPlaneLayout scaled_layout;
+
+    // Compressed logging, only used with an encoder pool running. Also the
+    // format of image/jpeg and image/png input.
+    RerunImageEncoding encoding;
+    gint jpeg_quality;
+
+    // Encoded video
+    gboolean is_h265;
+    rerun::components::VideoCodec codec;  // Unset for H.265, which is not logged as a VideoStream
+    gchar* stream_format;
+    guint nal_length_size;            // avc/avc3/hvc1/hev1 length prefix, 0 for byte-stream
+    gboolean nal_aligned;             // alignment=nal, access units are collected
+    std::vector<std::uint8_t> vps;    // Parameter sets from codec_data, VPS for H.265 only
+    std::vector<std::uint8_t> sps;
+    std::vector<std::uint8_t> pps;
+};
+
+// State of the encoded stream a sink is logging. It lives from start() to
+// stop() and is reset whenever the caps change, so every sink announces its
+// own codec and a restarted pipeline announces it again.
+typedef struct {
+    guint generation;                 // Caps generation the state belongs to
+    gboolean codec_announced;         // Static VideoStream codec logged
+    guint64 samples;                  // Samples logged since the codec was announced
+    guint64 keyframes;
+    guint64 withheld;                 // Access units dropped while waiting for a keyframe
+    gboolean decodable;               // A keyframe with parameter sets was logged
+    gboolean gop_dropping;            // Shedding the rest of the GOP, resume at the next IDR
+    gboolean after_drop;              // The queue dropped jobs right before the one being logged
+    std::vector<std::uint8_t> vps;    // Last parameter sets seen in the stream
+    std::vector<std::uint8_t> sps;
+    std::vector<std::uint8_t> pps;
+    guint outputs;                    // Outputs the current GOP or segment is logged to
+    guint64 gops;                     // GOPs or segments offered to the outputs
+    RerunOutputPacing pacing;
+    RerunMp4Segment segment;          // MP4 segment being collected
+    std::vector<RerunFrameTime> segment_times; // One per segment sample
+    std::vector<std::uint8_t> annexb; // avc input rewritten with start codes
+    std::vector<std::uint8_t> sample; // Access unit with parameter sets injected
+    std::vector<std::uint8_t> pending; // alignment=nal access unit being collected
+    gboolean pending_slice;           // The pending access unit holds a slice
+    RerunFrameTime pending_time;
+} RerunEncodedState;
+
+typedef struct _GstRerunSinkPrivate {
+  RerunOutputSet* output_set;
+  gboolean rerun_initialized;
+
+  gchar *recording_id;
+  gchar *image_path;
+  gchar *video_path;
+
+  gboolean spawn_viewer;      // Whether to spawn a Rerun viewer (only if output_file and grpc_address are not set)
+  gchar *output_file;         // Path to output .rrd file (if set, saves to disk)
+  gchar *grpc_address;        // gRPC connection string (if set to non-default, connects via gRPC)
+  gchar *outputs;             // Output list, replaces the three above when set
+  guint rotate_size;          // MiB after which output-file moves on to a new file, 0 = never
+  guint rotate_duration;      // Seconds after which output-file moves on to a new file, 0 = never
+  guint max_files;            // Rotated files kept, 0 = all
+  gchar *index_file;          // Manifest of the rotated files
+  guint write_size;           // KiB per write of output-file's disk writer, 0 = default
+  guint preallocate;          // MiB of disk reserved at a time for output-file
+  gboolean direct_io;         // Write output-file with O_DIRECT
+  guint sync_interval;        // Seconds between syncs of output-file, 0 = never
+
+  gboolean huge_pages;        // Back the proposed buffer pool with transparent huge pages
+
+  gboolean async_logging;     // Log from a worker thread instead of the streaming thread
+  guint queue_depth;
+  RerunQueuePolicy queue_policy;
+  RerunLogWorker* worker;     // Only while started with async_logging
+  gint worker_flow;           // Last failure reported by the worker, returned from render()
+
+  gdouble max_fps;            // 0 logs every frame
+  guint keep_every;           // Log one frame out of every N
+  guint64 frames_seen;
+  guint64 frames_skipped;
+  GstClockTime next_log_time; // Running time from which the next frame may be logged
+  guint64 gops_seen;          // Encoded video is decimated a GOP at a time
+  gboolean gop_kept;          // Whether the current GOP is logged
+  RerunOutputPacing output_pacing; // Per-output rates of frames admitted by render()
+  RerunOutputCursor output_cursor; // Rotated files this sink has seen
+
+  guint scale_factor;         // Downscale raw frames by this factor before logging
+  guint target_size;          // If set, pick the factor from the longest side instead
+  guint full_res_every;       // Also log every Nth frame at full resolution (0 = never)
+  gchar *full_res_path;       // Sibling of image_path for full-resolution frames
+  guint64 raw_frames_logged;
+  std::vector<std::uint8_t>* scale_buffer;
+
+  RerunImageEncoding image_encoding;
+  gint jpeg_quality;
+  guint encoder_threads;      // 0 uses one thread per CPU
+  GThreadPool* encoder_pool;  // Only while started with image_encoding
+  GMutex encode_lock;
+  GCond encode_cond;
+  guint encode_in_flight;     // Submitted and not logged yet
+  guint encode_max_in_flight;
+  guint64 encode_next_seq;
+  guint64 encode_next_log;
+  std::map<guint64, RerunEncodeJob*>* encode_done;  // Encoded, waiting for earlier frames
+
+  std::vector<std::uint8_t>* pack_buffer;  // Reused for frames whose planes are padded
+  RerunEncodedState* encoded;  // Only while started
+  gboolean keyframe_markers;   // Mark keyframes and index samples in the recording
+  gchar *stream_path;          // VideoStream entity: video_path, or image_path when encoding raw frames
+  gchar *keyframe_path;        // Child of stream_path holding the keyframe markers
+  gboolean reference_dropping; // Shed encoded frames the decoder can do without when behind
+  guint64 non_reference_dropped;
+  guint64 gop_dropped;
+  gboolean force_key_units;    // Ask upstream for an IDR instead of waiting out the GOP
+  gint awaiting_key_unit;      // Requested and not received yet, read by render()
+  gint encoded_flushed;        // Set on FLUSH_STOP, taken by the next encoded buffer
+  gint64 key_unit_requested;   // Monotonic time of the last request
+  guint key_unit_count;
+
+  RerunVideoEncoding video_encoding;
+  gchar *video_encoder_name;   // Element factory of the internal encoder
+  guint video_bitrate;         // kbit/s
+  guint keyframe_interval;
+  gchar *speed_preset;
+  RerunVideoEncoder* video_encoder;  // Only while started with video_encoding
+  RerunRenderPlan* video_plan; // Encoded plan for the internal encoder's output
+  GstCaps* video_caps;
+  GMutex video_time_lock;
+  std::deque<RerunFrameTime>* video_times;  // Frames inside the internal encoder, in push order
+  guint64 video_index;        // Index of the last frame out of the encoder, under video_time_lock
+  guint segment_duration;      // Seconds per MP4 segment, 0 = H.264 per sample, H.265 per GOP
+  gboolean offline;            // No clock sync and no dropping, for file transcoding
+  gboolean sync_before_offline; // The sink's sync setting, given back when offline is turned off
+
+  RerunRenderPlan* plan;      // Current render plan, swapped under the object lock
+  gint caps_generation;       // Atomic, plans are also built on the encoder's thread
+
+} GstRerunSinkPrivate;
+
+typedef struct _GstRerunSink {
+  GstVideoSink      parent_instance;
+  GstRerunSinkPrivate *priv;
+} GstRerunSink;
+
+struct _GstRerunSinkClass {
+  GstVideoSinkClass parent_class;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE(GstRerunSink, gst_rerun_sink, GST_TYPE_VIDEO_SINK)
+
+// A frame on its way through the encoder pool
+struct _RerunEncodeJob {
+    guint64 seq;                      // Frames are logged in submission order
+    GstBuffer* buffer;
+    RerunRenderPlan* plan;
+    gboolean full_res;                // Also encode the full-resolution frame
+    RerunFrameTime time;
+    std::vector<std::uint8_t> image;  // For image-path, downscaled if enabled
+    std::vector<std::uint8_t> full;   // For the full-resolution path
+};
+
+static rerun::archetypes::Image create_image_from_plan(
+    rerun::Collection<std::uint8_t> raw_data,
+    const RerunRenderPlan* plan,
+    gint width,
+    gint height);
+
+static GstFlowReturn process_encoded_video(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    GstBuffer* buffer,
+    const RerunFrameTime* time);
+
+static GstFlowReturn process_encoded_image(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    GstBuffer* buffer,
+    const RerunFrameTime* time);
+
+static GstFlowReturn render_raw_frame(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    GstBuffer* buffer,
+    const RerunFrameTime* time);
+
+#ifdef HAVE_NVMM_SUPPORT
+static GstFlowReturn render_nvmm_frame(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    GstBuffer* buffer,
+    const RerunFrameTime* time);
+
+static GstFlowReturn process_nvmm_buffer(
+    GstRerunSink* self,
+    GstBuffer* buffer,
+    const GstVideoInfo* info,
+    rerun::archetypes::Image& image);
+#endif
+
+static rerun::archetypes::Image process_regular_buffer(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    const GstVideoFrame* frame);
+
+static rerun::archetypes::Image downscale_regular_buffer(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    const GstVideoFrame* frame);
+
+static RerunRenderPlan* rerun_render_plan_ref(RerunRenderPlan* plan) {
+    g_atomic_int_inc(&plan->ref_count);
+    return plan;
+}
+
+static void rerun_render_plan_unref(RerunRenderPlan* plan) {
+    if (g_atomic_int_dec_and_test(&plan->ref_count)) {
+        g_free(plan->stream_format);
+        delete plan;
+    }
+}
+
+// Returns a new reference to the current plan, or NULL before negotiation
+static RerunRenderPlan* gst_rerun_sink_get_plan(GstRerunSink* self) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    RerunRenderPlan* plan = NULL;
+
+    GST_OBJECT_LOCK(self);
+    if (priv->plan) {
+        plan = rerun_render_plan_ref(priv->plan);
+    }
+    GST_OBJECT_UNLOCK(self);
+
+    return plan;
+}
+
+// Takes ownership of @plan (which may be NULL) and releases the previous one
+static void gst_rerun_sink_set_plan(GstRerunSink* self, RerunRenderPlan* plan) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    GST_OBJECT_LOCK(self);
+    RerunRenderPlan* old_plan = priv->plan;
+    priv->plan = plan;
+    GST_OBJECT_UNLOCK(self);
+
+    if (old_plan) {
+        rerun_render_plan_unref(old_plan);
+    }
+}
+
+// Factor raw frames of @width x @height are downscaled by, 1 for none
+static guint gst_rerun_sink_pick_scale_factor(GstRerunSink* self, gint width, gint height) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    if (!priv->target_size) {
+        return priv->scale_factor;
+    }
+
+    // Largest factor that still keeps the longest side at the target size
+    gint longest = MAX(width, height);
+    for (guint factor = RERUN_SCALER_MAX_FACTOR; factor > 1; factor /= 2) {
+        if ((guint)(longest / factor) >= priv->target_size) {
+            return factor;
+        }
+    }
+
+    return 1;
+}
+
+static void rerun_render_plan_init_encoding(GstRerunSink* self, RerunRenderPlan* plan) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    GstVideoFormat format = GST_VIDEO_INFO_FORMAT(&plan->info);
+
+    plan->encoding = priv->image_encoding;
+    plan->jpeg_quality = priv->jpeg_quality;
+
+    if (!rerun_image_encoding_supports(plan->encoding, format)) {
+        GST_WARNING_OBJECT(self, "Cannot log %s frames as %s, logging raw images",
+                           gst_video_format_to_string(format),
+                           rerun_image_encoding_media_type(plan->encoding));
+        plan->encoding = RERUN_IMAGE_ENCODING_NONE;
+    }
+}
+
+static void rerun_render_plan_init_scaling(GstRerunSink* self, RerunRenderPlan* plan) {
+    GstVideoFormat format = GST_VIDEO_INFO_FORMAT(&plan->info);
+    guint factor = gst_rerun_sink_pick_scale_factor(self, plan->width, plan->height);
+
+    plan->scale_factor = 1;
+    if (factor <= 1) {
+        return;
+    }
+
+    if (!rerun_scaler_supports(format, factor)) {
+        GST_WARNING_OBJECT(self, "Cannot downscale %s by %u, logging full resolution",
+                           gst_video_format_to_string(format), factor);
+        return;
+    }
+
+    gint width = plan->width / factor;
+    gint height = plan->height / factor;
+
+    // Subsampled chroma needs whole 2x2 blocks
+    if (GST_VIDEO_INFO_N_PLANES(&plan->info) > 1) {
+        width &= ~1;
+        height &= ~1;
+    }
+
+    if (width == 0 || height == 0) {
+        GST_WARNING_OBJECT(self, "%dx%d frames are too small to downscale by %u",
+                           plan->width, plan->height, factor);
+        return;
+    }
+
+    gst_video_info_set_format(&plan->scaled_info, format, width, height);
+    rerun_plane_layout_init(&plan->scaled_layout, &plan->scaled_info);
+    plan->scale_factor = factor;
+
+    GST_INFO_OBJECT(self, "Downscaling %dx%d frames by %u to %dx%d",
+                    plan->width, plan->height, factor, width, height);
+}
+
+// Rerun's planar YUV formats come in limited and full range variants
+static gboolean is_full_range(const GstVideoInfo* info) {
+    return GST_VIDEO_INFO_COLORIMETRY(info).range == GST_VIDEO_COLOR_RANGE_0_255;
+}
+
+// Formats Rerun has no color model for are reordered into RGB or RGBA while
+// packing. @order gives the source byte of each output channel.
+static void rerun_render_plan_set_swizzle(
+    RerunRenderPlan* plan,
+    const guint8 order[4],
+    gboolean alpha) {
+
+    GstVideoInfo rgb_info;
+    gst_video_info_set_format(&rgb_info, alpha ? GST_VIDEO_FORMAT_RGBA : GST_VIDEO_FORMAT_RGB,
+                              plan->width, plan->height);
+
+    // The layout describes what Rerun receives, not the 4-byte source pixels
+    rerun_plane_layout_init(&plan->layout, &rgb_info);
+    plan->layout.row_op[0] = alpha ? RERUN_ROW_SWIZZLE_RGBA : RERUN_ROW_SWIZZLE_RGB;
+    memcpy(plan->layout.swizzle, order, sizeof(plan->layout.swizzle));
+
+    plan->color_model = alpha ? rerun::datatypes::ColorModel::RGBA : rerun::datatypes::ColorModel::RGB;
+    plan->datatype = rerun::datatypes::ChannelDatatype::U8;
+}
+
+static RerunRenderPlan* rerun_render_plan_new_from_caps(GstRerunSink* self, GstCaps* caps) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    GstStructure* structure = gst_caps_get_structure(caps, 0);
+    const gchar* name = gst_structure_get_name(structure);
+
+    RerunRenderPlan* plan = new RerunRenderPlan();
+    plan->ref_count = 1;
+    plan->generation = (guint)g_atomic_int_add(&priv->caps_generation, 1) + 1;
+
+    if (g_strcmp0(name, "image/jpeg") == 0 || g_strcmp0(name, "image/png") == 0) {
+        plan->render = process_encoded_image;
+        plan->encoding = g_strcmp0(name, "image/jpeg") == 0 ? RERUN_IMAGE_ENCODING_JPEG : RERUN_IMAGE_ENCODING_PNG;
+
+        // Only informative, the viewer reads the size from the image itself
+        gst_structure_get_int(structure, "width", &plan->width);
+        gst_structure_get_int(structure, "height", &plan->height);
+
+        GST_INFO_OBJECT(self, "%s images passed through: %dx%d", name, plan->width, plan->height);
+        return plan;
+    }
+
+    if (g_strcmp0(name, "video/x-h264") == 0 || g_strcmp0(name, "video/x-h265") == 0) {
+        plan->render = process_encoded_video;
+        plan->is_h265 = (g_strcmp0(name, "video/x-h265") == 0);
+        if (!plan->is_h265) {
+            plan->codec = rerun::components::VideoCodec::H264;
+        }
+        plan->stream_format = g_strdup(gst_structure_get_string(structure, "stream-format"));
+        plan->nal_aligned = (g_strcmp0(gst_structure_get_string(structure, "alignment"), "nal") == 0);
+
+        // Everything but byte-stream is length-prefixed, described by codec_data
+        if (plan->stream_format && g_strcmp0(plan->stream_format, "byte-stream") != 0) {
+            const GValue* codec_data = gst_structure_get_value(structure, "codec_data");
+            GstMapInfo map;
+
+            if (!codec_data || !gst_buffer_map(gst_value_get_buffer(codec_data), &map, GST_MAP_READ)) {
+                GST_ERROR_OBJECT(self, "%s stream without codec_data", plan->stream_format);
+                rerun_render_plan_unref(plan);
+                return NULL;
+            }
+
+            plan->nal_length_size = plan->is_h265 ?
+                rerun_h265_parse_hvcc(map.data, map.size, &plan->vps, &plan->sps, &plan->pps) :
+                rerun_h264_parse_avcc(map.data, map.size, &plan->sps, &plan->pps);
+            gst_buffer_unmap(gst_value_get_buffer(codec_data), &map);
+
+            if (!plan->nal_length_size) {
+                GST_ERROR_OBJECT(self, "Invalid %s codec_data", plan->is_h265 ? "hvcC" : "avcC");
+                rerun_render_plan_unref(plan);
+                return NULL;
+            }
+        }
+
+        gst_structure_get_int(structure, "width", &plan->width);
+        if (!plan->width) {
+            GST_ERROR_OBJECT(self, "Failed to get width of encoded frame");
+            rerun_render_plan_unref(plan);
+            return NULL;
+        }
+
+        gst_structure_get_int(structure, "height", &plan->height);
+        if (!plan->height) {
+            GST_ERROR_OBJECT(self, "Failed to get height of encoded frame");
+            rerun_render_plan_unref(plan);
+            return NULL;
+        }
+
+        GST_INFO_OBJECT(self, "%s stream detected: %dx%d, stream-format: %s, alignment: %s",
+                        plan->is_h265 ? "H.265" : "H.264", plan->width, plan->height,
+                        plan->stream_format ? plan->stream_format : "unknown",
+                        plan->nal_aligned ? "nal" : "au");
+        return plan;
+    }
+
+    if (!gst_video_info_from_caps(&plan->info, caps)) {
+        GST_ERROR_OBJECT(self, "Failed to get video info from caps");
+        rerun_render_plan_unref(plan);
+        return NULL;
+    }
+
+    plan->width = GST_VIDEO_INFO_WIDTH(&plan->info);
+    plan->height = GST_VIDEO_INFO_HEIGHT(&plan->info);
+    rerun_plane_layout_init(&plan->layout, &plan->info);
+    plan->render = render_raw_frame;
+    plan->scale_factor = 1;
+
+#ifdef HAVE_NVMM_SUPPORT
+    GstCapsFeatures* features = gst_caps_get_features(caps, 0);
+    if (features && gst_caps_features_contains(features, "memory:NVMM")) {
+        plan->render = render_nvmm_frame;
+    }
+#endif
+
+    switch (GST_VIDEO_INFO_FORMAT(&plan->info)) {
+        case GST_VIDEO_FORMAT_RGB:
+            plan->color_model = rerun::datatypes::ColorModel::RGB;
+            plan->datatype = rerun::datatypes::ChannelDatatype::U8;
+            break;
+
+        case GST_VIDEO_FORMAT_RGBA:
+            plan->color_model = rerun::datatypes::ColorModel::RGBA;
+            plan->datatype = rerun::datatypes::ChannelDatatype::U8;
+            break;
+
+        case GST_VIDEO_FORMAT_BGR:
+            plan->color_model = rerun::datatypes::ColorModel::BGR;
+            plan->datatype = rerun::datatypes::ChannelDatatype::U8;
+            break;
+
+        case GST_VIDEO_FORMAT_BGRA:
+            plan->color_model = rerun::datatypes::ColorModel::BGRA;
+            plan->datatype = rerun::datatypes::ChannelDatatype::U8;
+            break;
+
+        // Padding bytes are dropped, an undefined alpha would hide the image
+        case GST_VIDEO_FORMAT_BGRx: {
+            static const guint8 order[4] = { 2, 1, 0, 3 };
+            rerun_render_plan_set_swizzle(plan, order, FALSE);
+            break;
+        }
+
+        case GST_VIDEO_FORMAT_RGBx: {
+            static const guint8 order[4] = { 0, 1, 2, 3 };
+            rerun_render_plan_set_swizzle(plan, order, FALSE);
+            break;
+        }
+
+        case GST_VIDEO_FORMAT_xRGB: {
+            static const guint8 order[4] = { 1, 2, 3, 0 };
+            rerun_render_plan_set_swizzle(plan, order, FALSE);
+            break;
+        }
+
+        case GST_VIDEO_FORMAT_xBGR: {
+            static const guint8 order[4] = { 3, 2, 1, 0 };
+            rerun_render_plan_set_swizzle(plan, order, FALSE);
+            break;
+        }
+
+        case GST_VIDEO_FORMAT_ARGB: {
+            static const guint8 order[4] = { 1, 2, 3, 0 };
+            rerun_render_plan_set_swizzle(plan, order, TRUE);
+            break;
+        }
+
+        case GST_VIDEO_FORMAT_ABGR: {
+            static const guint8 order[4] = { 3, 2, 1, 0 };
+            rerun_render_plan_set_swizzle(plan, order, TRUE);
+            break;
+        }
+
+        case GST_VIDEO_FORMAT_GRAY8:
+            plan->color_model = rerun::datatypes::ColorModel::L;
+            plan->datatype = rerun::datatypes::ChannelDatatype::U8;
+            break;
+
+        case GST_VIDEO_FORMAT_GRAY16_LE:
+            plan->color_model = rerun::datatypes::ColorModel::L;
+            plan->datatype = rerun::datatypes::ChannelDatatype::U16;
+            break;
+
+        case GST_VIDEO_FORMAT_NV12:
+            plan->has_pixel_format = TRUE;
+            plan->pixel_format = rerun::datatypes::PixelFormat::NV12;
+            break;
+
+        case GST_VIDEO_FORMAT_NV21:
+            // Same as NV12 with V and U swapped, fixed up while packing
+            plan->has_pixel_format = TRUE;
+            plan->pixel_format = rerun::datatypes::PixelFormat::NV12;
+            plan->layout.row_op[1] = RERUN_ROW_SWAP_PAIRS;
+            break;
+
+        case GST_VIDEO_FORMAT_YUY2:
+            plan->has_pixel_format = TRUE;
+            plan->pixel_format = rerun::datatypes::PixelFormat::YUY2;
+            break;
+
+        case GST_VIDEO_FORMAT_UYVY:
+            // Chroma first instead of luma first, fixed up while packing
+            plan->has_pixel_format = TRUE;
+            plan->pixel_format = rerun::datatypes::PixelFormat::YUY2;
+            plan->layout.row_op[0] = RERUN_ROW_SWAP_PAIRS;
+            break;
+
+        case GST_VIDEO_FORMAT_I420:
+            plan->has_pixel_format = TRUE;
+            plan->pixel_format = is_full_range(&plan->info) ?
+                                 rerun::datatypes::PixelFormat::Y_U_V12_FullRange :
+                                 rerun::datatypes::PixelFormat::Y_U_V12_LimitedRange;
+            break;
+
+        case GST_VIDEO_FORMAT_Y42B:
+            plan->has_pixel_format = TRUE;
+            plan->pixel_format = is_full_range(&plan->info) ?
+                                 rerun::datatypes::PixelFormat::Y_U_V16_FullRange :
+                                 rerun::datatypes::PixelFormat::Y_U_V16_LimitedRange;
+            break;
+
+        case GST_VIDEO_FORMAT_Y444:
+            plan->has_pixel_format = TRUE;
+            plan->pixel_format = is_full_range(&plan->info) ?
+                                 rerun::datatypes::PixelFormat::Y_U_V24_FullRange :
+                                 rerun::datatypes::PixelFormat::Y_U_V24_LimitedRange;
+            break;
+
+        default:
+            GST_WARNING_OBJECT(self, "Unsupported format: %s",
+                              gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&plan->info)));
+            rerun_render_plan_unref(plan);
+            return NULL;
+    }
+
+    if (plan->render == render_raw_frame) {
+        rerun_render_plan_init_scaling(self, plan);
+        rerun_render_plan_init_encoding(self, plan);
+    }
+
+    if (plan->layout.row_op[0] == RERUN_ROW_SWIZZLE_RGB || plan->layout.row_op[0] == RERUN_ROW_SWIZZLE_RGBA) {
+        GST_INFO_OBJECT(self, "Reordering %s into %s with the %s kernel",
+                        gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&plan->info)),
+                        plan->layout.row_op[0] == RERUN_ROW_SWIZZLE_RGB ? "RGB" : "RGBA",
+                        rerun_swizzle_get_impl());
+    }
+
+    return plan;
+}
+
+// Tells upstream that frames before the next deadline will be skipped anyway.
+// Decoders and converters treat running times before timestamp + 2 * diff +
+// frame duration as late, so aim one frame short of the deadline to make
+// sure the frame we want still arrives.
+static void gst_rerun_sink_send_throttle(
+    GstRerunSink* self,
+    GstClockTime running_time,
+    GstClockTime deadline,
+    GstClockTime duration) {
+
+    if (!gst_base_sink_is_qos_enabled(GST_BASE_SINK(self)) || duration == 0) {
+        return;
+    }
+
+    GstClockTimeDiff diff = (GstClockTimeDiff)(deadline - running_time) - 2 * (GstClockTimeDiff)duration;
+    if (diff <= 0) {
+        return;
+    }
+
+    GstEvent* event = gst_event_new_qos(GST_QOS_TYPE_THROTTLE, 1.0, diff / 2, running_time);
+    gst_pad_push_event(GST_BASE_SINK_PAD(self), event);
+}
+
+// Applies keep-every and max-fps to the frame or GOP @index starting with
+// @buffer. Only frames are throttled upstream: encoders and parsers upstream
+// of encoded video cannot skip part of a GOP.
+static gboolean gst_rerun_sink_decimate_unit(
+    GstRerunSink* self,
+    GstBuffer* buffer,
+    guint64 index,
+    gboolean throttle) {
+
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    if (priv->keep_every > 1 && index % priv->keep_every != 0) {
+        return FALSE;
+    }
+
+    if (priv->max_fps <= 0.0) {
+        return TRUE;
+    }
+
+    GstClockTime timestamp = GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : GST_BUFFER_DTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(timestamp)) {
+        return TRUE;
+    }
+
+    GstClockTime running_time = gst_segment_to_running_time(&GST_BASE_SINK(self)->segment,
+                                                             GST_FORMAT_TIME, timestamp);
+    if (!GST_CLOCK_TIME_IS_VALID(running_time)) {
+        return TRUE;
+    }
+
+    GstClockTime interval = (GstClockTime)(GST_SECOND / priv->max_fps);
+    GstClockTime duration = GST_BUFFER_DURATION_IS_VALID(buffer) ? GST_BUFFER_DURATION(buffer) : 0;
+
+    // Half a frame of slack keeps timestamp jitter from pushing every
+    // deadline one frame late
+    if (GST_CLOCK_TIME_IS_VALID(priv->next_log_time) && running_time + duration / 2 < priv->next_log_time) {
+        return FALSE;
+    }
+
+    // Deadlines advance by whole intervals so the rate does not drift, and
+    // restart from this frame after a gap
+    if (!GST_CLOCK_TIME_IS_VALID(priv->next_log_time) || running_time >= priv->next_log_time + interval) {
+        priv->next_log_time = running_time + interval;
+    } else {
+        priv->next_log_time += interval;
+    }
+
+    if (throttle) {
+        gst_rerun_sink_send_throttle(self, running_time, priv->next_log_time, duration);
+    }
+
+    return TRUE;
+}
+
+// Decides whether @buffer is logged at all. It runs before anything touches
+// the buffer memory, so a skipped frame costs a couple of comparisons.
+// Encoded video only decodes from a keyframe on, so it is kept or skipped a
+// whole GOP at a time, as its keyframe is; without reliable delta flags
+// (alignment=nal) it is not decimated at all.
+static gboolean gst_rerun_sink_decimate(GstRerunSink* self, const RerunRenderPlan* plan, GstBuffer* buffer) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    guint64 index = priv->frames_seen++;
+
+    if (plan->render != process_encoded_video) {
+        return gst_rerun_sink_decimate_unit(self, buffer, index, TRUE);
+    }
+
+    if (plan->nal_aligned || !(priv->keep_every > 1 || priv->max_fps > 0.0)) {
+        return TRUE;
+    }
+
+    if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+        priv->gop_kept = gst_rerun_sink_decimate_unit(self, buffer, priv->gops_seen++, FALSE);
+    }
+
+    return priv->gop_kept;
+}
+
+// Counters for what the sink did not log, read through the stats property
+static GstStructure* gst_rerun_sink_get_stats(GstRerunSink* self) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    GST_OBJECT_LOCK(self);
+    guint64 queue_dropped = priv->worker ? rerun_log_worker_get_dropped(priv->worker) : 0;
+    GST_OBJECT_UNLOCK(self);
+
+    return gst_structure_new("application/x-rerun-sink-stats",
+                             "frames-seen", G_TYPE_UINT64, priv->frames_seen,
+                             "frames-skipped", G_TYPE_UINT64, priv->frames_skipped,
+                             "queue-dropped", G_TYPE_UINT64, queue_dropped,
+                             "non-reference-dropped", G_TYPE_UINT64, priv->non_reference_dropped,
+                             "gop-dropped", G_TYPE_UINT64, priv->gop_dropped,
+                             NULL);
+}
+
+static void gst_rerun_sink_reset_decimation(GstRerunSink* self) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    priv->frames_seen = 0;
+    priv->frames_skipped = 0;
+    priv->next_log_time = GST_CLOCK_TIME_NONE;
+    priv->gops_seen = 0;
+    priv->gop_kept = TRUE;
+    rerun_output_pacing_reset(&priv->output_pacing);
+}
+
+// Places @buffer on the timelines. Runs on the streaming thread, after
+// gst_rerun_sink_decimate() counted the buffer, while the segment it was
+// received in is still current.
+static void gst_rerun_sink_get_frame_time(GstRerunSink* self, GstBuffer* buffer, RerunFrameTime* time) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    const GstSegment* segment = &GST_BASE_SINK(self)->segment;
+
+    time->pts = GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : GST_BUFFER_DTS(buffer);
+    time->dts = GST_BUFFER_DTS_OR_PTS(buffer);
+    time->running_time = GST_CLOCK_TIME_NONE;
+    time->stream_time = GST_CLOCK_TIME_NONE;
+    time->index = priv->frames_seen - 1;
+
+    if (segment->format == GST_FORMAT_TIME && GST_CLOCK_TIME_IS_VALID(time->pts)) {
+        time->running_time = gst_segment_to_running_time(segment, GST_FORMAT_TIME, time->pts);
+        time->stream_time = gst_segment_to_stream_time(segment, GST_FORMAT_TIME, time->pts);
+    }
+}
+
+static void gst_rerun_sink_set_timeline(
+    const rerun::RecordingStream* stream,
+    const char* timeline,
+    GstClockTime value) {
+
+    // An unknown time must not inherit the previous frame's
+    if (GST_CLOCK_TIME_IS_VALID(value)) {
+        stream->set_time_duration(timeline, nanoseconds(value));
+    } else {
+        stream->disable_timeline(timeline);
+    }
+}
+
+// Sets every timeline for what is logged next from the calling thread, on
+// the streams of the outputs the frame goes to. Rerun keeps the time per
+// thread, so this has to run on whichever thread does the logging.
+static void gst_rerun_sink_set_frame_time(GstRerunSink* self, const RerunFrameTime* time) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    if (!priv->output_set) {
+        return;
+    }
+
+    for (guint i = 0; i < rerun_output_set_get_n_streams(priv->output_set); i++) {
+        if (!(time->outputs & (1u << i))) {
+            continue;
+        }
+
+        const rerun::RecordingStream* stream = rerun_output_set_get_stream(priv->output_set, i);
+        stream->set_time_sequence("frame", (int64_t)time->index);
+        gst_rerun_sink_set_timeline(stream, "pts", time->pts);
+        gst_rerun_sink_set_timeline(stream, "running_time", time->running_time);
+        gst_rerun_sink_set_timeline(stream, "stream_time", time->stream_time);
+    }
+}
+
+static void gst_rerun_sink_set_sequence(GstRerunSink* self, guint outputs, const char* timeline, guint64 value) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    for (guint i = 0; i < rerun_output_set_get_n_streams(priv->output_set); i++) {
+        if (outputs & (1u << i)) {
+            rerun_output_set_get_stream(priv->output_set, i)->set_time_sequence(timeline, (int64_t)value);
+        }
+    }
+}
+
+// Logs @archetype to the stream of every output in @outputs. Outputs that
+// share a stream get the data encoded once; for several streams it is
+// converted to Arrow once and the batches, which share their buffers, are
+// handed to each of them.
+template <typename T>
+static void gst_rerun_sink_log_with_static(
+    GstRerunSink* self, guint outputs, const gchar* path, gboolean static_, const T& archetype) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    guint n_streams = rerun_output_set_get_n_streams(priv->output_set);
+
+    if (!(outputs & (outputs - 1))) {
+        for (guint i = 0; i < n_streams; i++) {
+            if (outputs & (1u << i)) {
+                rerun_output_set_get_stream(priv->output_set, i)->log_with_static(path, static_, archetype);
+            }
+        }
+        return;
+    }
+
+    rerun::Result<rerun::Collection<rerun::ComponentBatch>> batches = rerun::AsComponents<T>().as_batches(archetype);
+    if (batches.is_err()) {
+        GST_WARNING_OBJECT(self, "Failed to serialize %s: %s", path, batches.error.description.c_str());
+        return;
+    }
+
+    std::vector<rerun::ComponentBatch> columns = std::move(batches.value).to_vector();
+    for (guint i = 0; i < n_streams; i++) {
+        if (outputs & (1u << i)) {
+            rerun_output_set_get_stream(priv->output_set, i)->log_serialized_batches(path, static_, columns);
+        }
+    }
+}
+
+template <typename T>
+static void gst_rerun_sink_log(GstRerunSink* self, guint outputs, const gchar* path, const T& archetype) {
+    gst_rerun_sink_log_with_static(self, outputs, path, FALSE, archetype);
+}
+
+// Static data is not subject to any output's rate, but has to be sent
+// again to a stream that moved on to a new file
+template <typename T>
+static void gst_rerun_sink_log_static(GstRerunSink* self, guint outputs, const gchar* path, const T& archetype) {
+    gst_rerun_sink_log_with_static(self, outputs, path, TRUE, archetype);
+}
+
+static GstFlowReturn gst_rerun_sink_render_buffer(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    GstBuffer* buffer,
+    const RerunFrameTime* time) {
+
+    gst_rerun_sink_set_frame_time(self, time);
+    return plan->render(self, plan, buffer, time);
+}
+
+static GstFlowReturn gst_rerun_sink_render(GstBaseSink *sink, GstBuffer *buffer) {
+    GstRerunSink* self = GST_RERUN_SINK(sink);
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    RerunRenderPlan* plan = gst_rerun_sink_get_plan(self);
+    if (!plan) {
+        GST_ERROR_OBJECT(self, "Received a buffer before caps were negotiated");
+        return GST_FLOW_NOT_NEGOTIATED;
+    }
+
+    if (!gst_rerun_sink_decimate(self, plan, buffer)) {
+        priv->frames_skipped++;
+        GST_LOG_OBJECT(self, "Skipping buffer %" GST_TIME_FORMAT, GST_TIME_ARGS(GST_BUFFER_PTS(buffer)));
+        rerun_render_plan_unref(plan);
+        return GST_FLOW_OK;
+    }
+
+    RerunFrameTime time;
+    gst_rerun_sink_get_frame_time(self, buffer, &time);
+
+    // Encoded video can only be thinned a GOP at a time, which is decided
+    // once keyframes are parsed. The internal encoder needs every frame.
+    if (plan->render == process_encoded_video || priv->video_encoder) {
+        time.outputs = rerun_output_set_all(priv->output_set);
+    } else {
+        time.outputs = rerun_output_set_admit(priv->output_set, &priv->output_pacing, time.index, time.running_time);
+        if (!time.outputs) {
+            priv->frames_skipped++;
+            GST_LOG_OBJECT(self, "No output takes buffer %" GST_TIME_FORMAT, GST_TIME_ARGS(GST_BUFFER_PTS(buffer)));
+            rerun_render_plan_unref(plan);
+            return GST_FLOW_OK;
+        }
+    }
+
+    // Once a key unit was requested, delta frames ahead of it would only be
+    // withheld, so they are not queued and the keyframe gets logged sooner.
+    // The frames after the keyframe depend on it and must all be queued, so
+    // the wait ends here rather than once the worker logged the keyframe.
+    if (plan->render == process_encoded_video && !plan->nal_aligned &&
+        g_atomic_int_get(&priv->awaiting_key_unit)) {
+        if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+            GST_LOG_OBJECT(self, "Skipping delta unit while waiting for a keyframe");
+            rerun_render_plan_unref(plan);
+            return GST_FLOW_OK;
+        }
+        g_atomic_int_set(&priv->awaiting_key_unit, FALSE);
+    }
+
+    // The job keeps the buffer and the plan it was negotiated with alive
+    // until the worker is done, so caps changes cannot race with it
+    if (priv->worker) {
+        GstFlowReturn flow = (GstFlowReturn)g_atomic_int_get(&priv->worker_flow);
+        if (flow != GST_FLOW_OK) {
+            rerun_render_plan_unref(plan);
+            return flow;
+        }
+
+        // A frame for an output with policy=block waits for room in the queue
+        RerunLogJob job = { gst_buffer_ref(buffer), plan, time };
+        job.keep = (time.outputs & rerun_output_set_get_blocking(priv->output_set)) != 0;
+        if (!rerun_log_worker_push(priv->worker, &job)) {
+            GST_LOG_OBJECT(self, "Logging queue did not take buffer %" GST_TIME_FORMAT,
+                           GST_TIME_ARGS(GST_BUFFER_PTS(buffer)));
+        }
+        return GST_FLOW_OK;
+    }
+
+    GstFlowReturn ret = gst_rerun_sink_render_buffer(self, plan, buffer, &time);
+    rerun_render_plan_unref(plan);
+
+    return ret;
+}
+
+static void gst_rerun_sink_process_job(RerunLogJob* job, gpointer user_data) {
+    GstRerunSink* self = GST_RERUN_SINK(user_data);
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    RerunRenderPlan* plan = (RerunRenderPlan*)job->data;
+
+    // Taken up by the next access unit, however the buffer is split
+    if (job->after_drop && priv->encoded) {
+        priv->encoded->after_drop = TRUE;
+    }
+
+    GstFlowReturn ret = gst_rerun_sink_render_buffer(self, plan, job->buffer, &job->time);
+    if (ret != GST_FLOW_OK) {
+        GST_WARNING_OBJECT(self, "Asynchronous logging failed: %s", gst_flow_get_name(ret));
+        g_atomic_int_set(&priv->worker_flow, ret);
+    }
+}
+
+static void gst_rerun_sink_release_job(RerunLogJob* job, gpointer user_data) {
+    gst_buffer_unref(job->buffer);
+    rerun_render_plan_unref((RerunRenderPlan*)job->data);
+}
+
+template <typename T>
+static void log_image(GstRerunSink* self, guint outputs, const gchar* path, const T& image) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    if (priv->rerun_initialized && priv->output_set && path) {
+        gst_rerun_sink_log(self, outputs, path, image);
+    } else if (!path) {
+        GST_WARNING_OBJECT(self, "image-path property not set, skipping frame logging");
+    }
+}
+
+// Whether the frame being rendered is also logged at full resolution
+static gboolean gst_rerun_sink_full_res_due(GstRerunSink* self) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    guint64 index = priv->raw_frames_logged++;
+    return priv->full_res_path && priv->full_res_every && index % priv->full_res_every == 0;
+}
+
+static gboolean encode_image(
+    const RerunRenderPlan* plan,
+    const RerunImageSource* source,
+    std::vector<std::uint8_t>* out) {
+
+    gboolean ret = FALSE;
+
+    switch (plan->encoding) {
+        case RERUN_IMAGE_ENCODING_JPEG:
+            ret = rerun_image_encode_jpeg(source, plan->jpeg_quality, out);
+            break;
+        case RERUN_IMAGE_ENCODING_PNG:
+            ret = rerun_image_encode_png(source, out);
+            break;
+        default:
+            break;
+    }
+
+    if (!ret) {
+        out->clear();
+    }
+    return ret;
+}
+
+static void log_encoded_image(GstRerunSink* self, const gchar* path, const RerunEncodeJob* job,
+                              const std::vector<std::uint8_t>& bytes) {
+    if (bytes.empty()) {
+        return;
+    }
+
+    log_image(self, job->time.outputs, path, rerun::archetypes::EncodedImage::from_bytes(
+        rerun::Collection<std::uint8_t>::borrow(bytes.data(), bytes.size()),
+        std::string(rerun_image_encoding_media_type(job->plan->encoding))));
+}
+
+static void rerun_encode_job_free(RerunEncodeJob* job) {
+    if (job->buffer) {
+        gst_buffer_unref(job->buffer);
+    }
+    rerun_render_plan_unref(job->plan);
+    delete job;
+}
+
+// Runs on an encoder pool thread once @job is encoded. Whoever finishes the
+// oldest outstanding frame logs it along with every later frame that is
+// already done, so frames reach Rerun in order even though they are encoded
+// in parallel.
+static void gst_rerun_sink_finish_encode(GstRerunSink* self, RerunEncodeJob* job) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    g_mutex_lock(&priv->encode_lock);
+
+    (*priv->encode_done)[job->seq] = job;
+
+    auto it = priv->encode_done->begin();
+    while (it != priv->encode_done->end() && it->first == priv->encode_next_log) {
+        RerunEncodeJob* done = it->second;
+
+        rerun_output_set_rotate(priv->output_set, &priv->output_cursor, done->time.running_time, TRUE, NULL);
+        gst_rerun_sink_set_frame_time(self, &done->time);
+        log_encoded_image(self, priv->image_path, done, done->image);
+        log_encoded_image(self, priv->full_res_path, done, done->full);
+        rerun_encode_job_free(done);
+
+        it = priv->encode_done->erase(it);
+        priv->encode_next_log++;
+        priv->encode_in_flight--;
+    }
+
+    g_cond_broadcast(&priv->encode_cond);
+    g_mutex_unlock(&priv->encode_lock);
+}
+
+static void gst_rerun_sink_encode_job(gpointer data, gpointer user_data) {
+    GstRerunSink* self = GST_RERUN_SINK(user_data);
+    RerunEncodeJob* job = (RerunEncodeJob*)data;
+    const RerunRenderPlan* plan = job->plan;
+    GstVideoFrame frame;
+
+    if (gst_video_frame_map(&frame, &plan->info, job->buffer, GST_MAP_READ)) {
+        RerunImageSource source;
+
+        if (plan->scale_factor > 1) {
+            static thread_local std::vector<std::uint8_t> scaled;
+            scaled.resize(plan->scaled_layout.size);
+            rerun_frame_downscale(&frame, &plan->scaled_layout, plan->scale_factor, scaled.data());
+
+            rerun_image_source_init_packed(&source, &plan->scaled_info, &plan->scaled_layout, scaled.data());
+            encode_image(plan, &source, &job->image);
+        }
+
+        if (plan->scale_factor <= 1 || job->full_res) {
+            // The encoders take strides, so padded frames need no packing
+            rerun_image_source_init_frame(&source, &frame);
+            encode_image(plan, &source, plan->scale_factor > 1 ? &job->full : &job->image);
+        }
+
+        gst_video_frame_unmap(&frame);
+    } else {
+        GST_ERROR_OBJECT(self, "Failed to map buffer for encoding");
+    }
+
+    // Hand the memory back upstream before waiting for our turn to log
+    gst_buffer_unref(job->buffer);
+    job->buffer = NULL;
+
+    gst_rerun_sink_finish_encode(self, job);
+}
+
+// Queues @buffer on the encoder pool. Only a bounded number of frames may be
+// in flight, which is where a pool that cannot keep up pushes back.
+static GstFlowReturn gst_rerun_sink_submit_encode(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    GstBuffer* buffer,
+    const RerunFrameTime* time,
+    gboolean full_res) {
+
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    RerunEncodeJob* job = new RerunEncodeJob();
+    job->buffer = gst_buffer_ref(buffer);
+    job->plan = rerun_render_plan_ref((RerunRenderPlan*)plan);
+    job->full_res = full_res;
+    job->time = *time;
+
+    g_mutex_lock(&priv->encode_lock);
+    while (priv->encode_in_flight >= priv->encode_max_in_flight) {
+        g_cond_wait(&priv->encode_cond, &priv->encode_lock);
+    }
+    priv->encode_in_flight++;
+    job->seq = priv->encode_next_seq++;
+    g_mutex_unlock(&priv->encode_lock);
+
+    g_thread_pool_push(priv->encoder_pool, job, NULL);
+
+    return GST_FLOW_OK;
+}
+
+// Waits until every submitted frame has been encoded and logged
+static void gst_rerun_sink_drain_encoder(GstRerunSink* self) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    g_mutex_lock(&priv->encode_lock);
+    while (priv->encode_in_flight > 0) {
+        g_cond_wait(&priv->encode_cond, &priv->encode_lock);
+    }
+    g_mutex_unlock(&priv->encode_lock);
+}
+
+static GstFlowReturn render_raw_frame(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    GstBuffer* buffer,
+    const RerunFrameTime* time) {
+
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    GstVideoFrame frame;
+
+    if (priv->video_encoder) {
+        g_mutex_lock(&priv->video_time_lock);
+        priv->video_times->push_back(*time);
+        g_mutex_unlock(&priv->video_time_lock);
+
+        GstFlowReturn ret = rerun_video_encoder_push(priv->video_encoder, &plan->info, gst_buffer_ref(buffer));
+        if (ret == GST_FLOW_ERROR) {
+            GST_ELEMENT_ERROR(self, STREAM, ENCODE, ("Internal video encoder failed"), (NULL));
+        }
+        return ret;
+    }
+
+    gboolean full_res = plan->scale_factor > 1 && gst_rerun_sink_full_res_due(self);
+
+    if (plan->encoding != RERUN_IMAGE_ENCODING_NONE && priv->encoder_pool) {
+        return gst_rerun_sink_submit_encode(self, plan, buffer, time, full_res);
+    }
+
+    // Honors GstVideoMeta strides and offsets when upstream attached them
+    if (!gst_video_frame_map(&frame, &plan->info, buffer, GST_MAP_READ)) {
+        GST_ERROR_OBJECT(self, "Failed to map buffer for reading");
+        return GST_FLOW_ERROR;
+    }
+
+    // Any raw frame can start a new file
+    rerun_output_set_rotate(priv->output_set, &priv->output_cursor, time->running_time, TRUE, NULL);
+
+    const gchar* full_res_path = priv->image_path;
+
+    if (plan->scale_factor > 1) {
+        log_image(self, time->outputs, priv->image_path, downscale_regular_buffer(self, plan, &frame));
+
+        if (!full_res) {
+            gst_video_frame_unmap(&frame);
+            return GST_FLOW_OK;
+        }
+        full_res_path = priv->full_res_path;
+    }
+
+    // Regular buffers are logged straight from the mapped memory, so the
+    // mapping is only released once Rerun has consumed the image.
+    log_image(self, time->outputs, full_res_path, process_regular_buffer(self, plan, &frame));
+    gst_video_frame_unmap(&frame);
+
+    return GST_FLOW_OK;
+}
+
+#ifdef HAVE_NVMM_SUPPORT
+static GstFlowReturn render_nvmm_frame(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    GstBuffer* buffer,
+    const RerunFrameTime* time) {
+
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    rerun::archetypes::Image image;
+
+    GstFlowReturn ret = process_nvmm_buffer(self, buffer, &plan->info, image);
+    if (ret != GST_FLOW_OK) {
+        return ret;
+    }
+
+    rerun_output_set_rotate(priv->output_set, &priv->output_cursor, time->running_time, TRUE, NULL);
+    log_image(self, time->outputs, priv->image_path, image);
+
+    return GST_FLOW_OK;
+}
+#endif
+
+static void gst_rerun_sink_reset_encoded_state(RerunEncodedState* state, guint generation) {
+    state->generation = generation;
+    state->codec_announced = FALSE;
+    state->samples = 0;
+    state->keyframes = 0;
+    state->withheld = 0;
+    state->decodable = FALSE;
+    state->gop_dropping = FALSE;
+    state->after_drop = FALSE;
+    state->outputs = 0;
+    state->gops = 0;
+    rerun_output_pacing_reset(&state->pacing);
+    state->vps.clear();
+    state->sps.clear();
+    state->pps.clear();
+    rerun_mp4_segment_clear(&state->segment);
+    state->segment_times.clear();
+    state->pending.clear();
+    state->pending_slice = FALSE;
+}
+
+// Asks upstream for an IDR with SPS/PPS, so logging can start or resume
+// without waiting for the encoder's next scheduled keyframe. While a request
+// is pending it is only repeated once KEY_UNIT_RETRY_INTERVAL has passed.
+// With @withhold, delta units are useless until the keyframe arrives, and
+// render() stops queuing them; without, as when a new file should start at
+// the keyframe, the stream goes on as it is.
+static void gst_rerun_sink_request_key_unit(GstRerunSink* self, const gchar* reason, gboolean withhold) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    if (!priv->force_key_units) {
+        return;
+    }
+
+    gint64 now = g_get_monotonic_time();
+    if ((g_atomic_int_get(&priv->awaiting_key_unit) || !withhold) &&
+        now - priv->key_unit_requested < KEY_UNIT_RETRY_INTERVAL) {
+        return;
+    }
+
+    priv->key_unit_requested = now;
+    if (withhold) {
+        g_atomic_int_set(&priv->awaiting_key_unit, TRUE);
+    }
+
+    if (priv->video_encoder) {
+        GST_DEBUG_OBJECT(self, "Requesting a key unit from the internal encoder: %s", reason);
+        rerun_video_encoder_force_key_unit(priv->video_encoder);
+        return;
+    }
+
+    GST_DEBUG_OBJECT(self, "Requesting a key unit upstream: %s", reason);
+    GstEvent* event = gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE,
+                                                                  ++priv->key_unit_count);
+    gst_pad_push_event(GST_BASE_SINK_PAD(self), event);
+}
+
+// With the log worker falling behind, decides whether to shed an access unit
+// the decoder can do without. Non-reference frames go first once the queue
+// is half full; with the queue full, a reference frame is dropped along with
+// the rest of its GOP, since every later frame up to the next IDR may
+// depend on it. Keyframes are never shed. Returns TRUE if this access unit
+// alone is shed; shedding the GOP is flagged in @state instead.
+static gboolean gst_rerun_sink_shed_access_unit(
+    GstRerunSink* self,
+    RerunEncodedState* state,
+    gboolean reference) {
+
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    if (!priv->reference_dropping || !priv->worker || priv->offline) {
+        return FALSE;
+    }
+
+    // Jobs queued behind the one being processed
+    guint pending = rerun_log_worker_get_pending(priv->worker);
+    guint backlog = pending > 0 ? pending - 1 : 0;
+
+    if (!reference && backlog * 2 >= priv->queue_depth) {
+        priv->non_reference_dropped++;
+        GST_LOG_OBJECT(self, "Shedding non-reference access unit, %u queued", backlog);
+        return TRUE;
+    }
+
+    if (reference && backlog >= priv->queue_depth) {
+        state->gop_dropping = TRUE;
+        GST_DEBUG_OBJECT(self, "Shedding the rest of the GOP, %u queued", backlog);
+    }
+
+    return FALSE;
+}
+
+static void gst_rerun_sink_mark_keyframe(
+    GstRerunSink* self,
+    RerunEncodedState* state,
+    guint64 sample,
+    guint outputs) {
+
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    state->keyframes++;
+    if (priv->keyframe_markers) {
+        // Shows up as an event on the timeline, so seeks can land on it
+        gchar* text = g_strdup_printf("keyframe %" G_GUINT64_FORMAT " (sample %" G_GUINT64_FORMAT ")",
+                                      state->keyframes, sample);
+        gst_rerun_sink_log(self, outputs, priv->keyframe_path, rerun::archetypes::TextLog(text));
+        g_free(text);
+    }
+}
+
+// Logs the collected segment as an AssetVideo, then one VideoFrameReference
+// per frame at the frame's own time. Rerun 0.24 cannot log H.265 as
+// VideoStream samples, but plays it back from MP4 assets, and for H.264 a
+// long segment costs less per frame than a sample row.
+static void gst_rerun_sink_log_segment(
+    GstRerunSink* self,
+    RerunEncodedState* state,
+    GstClockTime last_duration) {
+
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    RerunMp4Segment* segment = &state->segment;
+
+    if (segment->samples.empty()) {
+        return;
+    }
+
+    if (!rerun_mp4_segment_write(segment, last_duration)) {
+        GST_WARNING_OBJECT(self, "Dropping segment of %" G_GSIZE_FORMAT " frames without parameter sets",
+                           segment->samples.size());
+        rerun_mp4_segment_clear(segment);
+        state->segment_times.clear();
+        return;
+    }
+
+    // Every frame of a segment goes to the outputs that took its first
+    // keyframe, and to a single file, since segments start at a keyframe
+    GstClockTime origin = segment->samples.front().dts;
+    guint outputs = state->segment_times.front().outputs;
+    rerun_output_set_rotate(priv->output_set, &priv->output_cursor,
+                            state->segment_times.front().running_time, TRUE, NULL);
+    gst_rerun_sink_set_frame_time(self, &state->segment_times.front());
+    gst_rerun_sink_log(self, outputs, priv->stream_path, rerun::archetypes::AssetVideo::from_bytes(
+        rerun::Collection<std::uint8_t>::borrow(segment->file.data(), segment->file.size()),
+        rerun::components::MediaType::mp4()));
+
+    for (gsize i = 0; i < segment->samples.size(); i++) {
+        const RerunMp4Sample& sample = segment->samples[i];
+
+        rerun_output_set_rotate(priv->output_set, &priv->output_cursor,
+                                state->segment_times[i].running_time, FALSE, NULL);
+        gst_rerun_sink_set_frame_time(self, &state->segment_times[i]);
+        if (priv->keyframe_markers) {
+            gst_rerun_sink_set_sequence(self, outputs, "video_sample", state->samples);
+        }
+
+        auto timestamp = rerun::components::VideoTimestamp(nanoseconds(sample.pts - origin));
+        gst_rerun_sink_log(self, outputs, priv->stream_path, rerun::archetypes::VideoFrameReference(timestamp));
+
+        if (sample.keyframe) {
+            gst_rerun_sink_mark_keyframe(self, state, state->samples, outputs);
+        }
+        state->samples++;
+    }
+
+    GST_DEBUG_OBJECT(self, "Logged segment of %" G_GSIZE_FORMAT " frames, %" G_GSIZE_FORMAT " bytes",
+                     segment->samples.size(), segment->file.size());
+    rerun_mp4_segment_clear(segment);
+    state->segment_times.clear();
+}
+
+// Adds an access unit to the current segment, logging the segment first when
+// this keyframe closes it: every GOP for H.265, or once segment-duration
+// has been collected
+static void gst_rerun_sink_segment_access_unit(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    RerunEncodedState* state,
+    const guint8* data,
+    gsize size,
+    const RerunFrameTime* time,
+    gboolean keyframe) {
+
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    RerunMp4Segment* segment = &state->segment;
+    GstClockTime dts = time->dts;
+
+    if (!GST_CLOCK_TIME_IS_VALID(dts)) {
+        GST_WARNING_OBJECT(self, "Dropping access unit without timestamps");
+        return;
+    }
+
+    if (keyframe && !segment->samples.empty() &&
+        rerun_mp4_segment_span(segment) >= priv->segment_duration * GST_SECOND) {
+        gst_rerun_sink_log_segment(self, state, dts - segment->samples.back().dts);
+    }
+
+    // Outputs are thinned a segment at a time, by the keyframe that opens it.
+    // A segment no output took ends at the next keyframe.
+    if (keyframe && segment->samples.empty()) {
+        state->outputs = rerun_output_set_admit(priv->output_set, &state->pacing, state->gops++, time->running_time);
+    }
+    if (!state->outputs) {
+        return;
+    }
 
-#define FORMAT_CAPS GST_VIDEO_CAPS_MAKE("{ NV12, I420, RGB, GRAY8, RGBA }")
-#define FORMAT_NVMM_CAPS GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{NV12}")
-#define ENCODED_CAPS "video/x-h264, stream-format=(string)byte-stream; video/x-h265, stream-format=(string){ hvc1, hev1, byte-stream }"
+    // A segment carries the parameter sets its first keyframe relies on
+    if (segment->samples.empty()) {
+        segment->codec = plan->is_h265 ? RERUN_MP4_CODEC_H265 : RERUN_MP4_CODEC_H264;
+        segment->width = plan->width;
+        segment->height = plan->height;
+        segment->vps = state->vps;
+        segment->sps = state->sps;
+        segment->pps = state->pps;
+    }
 
-#ifdef HAVE_NVMM_SUPPORT
-#define RERUN_SINK_CAPS FORMAT_CAPS ";" FORMAT_NVMM_CAPS ";" ENCODED_CAPS
-#else
-#define RERUN_SINK_CAPS FORMAT_CAPS ";" ENCODED_CAPS
-#endif
+    rerun_mp4_segment_add(segment, data, size, GST_CLOCK_TIME_IS_VALID(time->pts) ? time->pts : dts, dts, keyframe);
+    state->segment_times.push_back(*time);
+    state->segment_times.back().outputs = state->outputs;
+}
 
-enum {
-  PROP_0,
-  PROP_RECORDING_ID,
-  PROP_IMAGE_PATH,
-  PROP_SPAWN_VIEWER,
-  PROP_OUTPUT_FILE,
-  PROP_GRPC_ADDRESS,
-  PROP_VIDEO_PATH,
-};
+// Logs one Annex-B access unit. Nothing is logged before the first keyframe,
+// since a decoder cannot start mid-GOP. An IDR access unit that does not
+// carry its own SPS and PPS gets the last ones seen (or those from
+// codec_data) put in front, so every keyframe can be decoded without what
+// came before it.
+static void gst_rerun_sink_log_access_unit(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    RerunEncodedState* state,
+    const guint8* data,
+    gsize size,
+    const RerunFrameTime* time) {
 
-#define GST_CAT_DEFAULT gst_rerun_sink_debug
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    gboolean has_sps = FALSE;
+    gboolean has_pps = FALSE;
+    gboolean has_idr = FALSE;
+    gboolean has_reference = FALSE;
+    gsize prefix_end = 0;
+    RerunNalUnit nal;
+    gsize offset = 0;
+
+    while (rerun_h264_next_nal(data, size, &offset, &nal)) {
+        // nal_ref_idc != 0: later frames may predict from this slice
+        if (nal.type >= RERUN_H264_NAL_SLICE && nal.type <= RERUN_H264_NAL_IDR && (nal.data[0] & 0x60)) {
+            has_reference = TRUE;
+        }
 
-typedef struct _GstRerunSinkPrivate {
-  rerun::RecordingStream* rec_stream;
-  gboolean rerun_initialized;
+        switch (nal.type) {
+            case RERUN_H264_NAL_SPS:
+                state->sps.assign(nal.data, nal.data + nal.size);
+                has_sps = TRUE;
+                break;
+
+            case RERUN_H264_NAL_PPS:
+                state->pps.assign(nal.data, nal.data + nal.size);
+                has_pps = TRUE;
+                break;
+
+            case RERUN_H264_NAL_IDR:
+                has_idr = TRUE;
+                break;
+
+            case RERUN_H264_NAL_AUD:
+                // The delimiter has to stay first in the access unit
+                if (nal.data - data <= 4) {
+                    prefix_end = offset;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
 
-  gchar *recording_id;
-  gchar *image_path;
-  gchar *video_path;
+    gboolean keyframe = has_idr && !state->sps.empty() && !state->pps.empty();
 
-  gboolean spawn_viewer;      // Whether to spawn a Rerun viewer (only if output_file and grpc_address are not set)
-  gchar *output_file;         // Path to output .rrd file (if set, saves to disk)
-  gchar *grpc_address;        // gRPC connection string (if set to non-default, connects via gRPC)
+    // A full queue in drop mode lost frames of this GOP on its own, right
+    // before this one
+    if (state->after_drop) {
+        state->after_drop = FALSE;
+        state->gop_dropping = state->decodable;
+    }
 
-} GstRerunSinkPrivate;
+    if (keyframe) {
+        state->gop_dropping = FALSE;
+        g_atomic_int_set(&priv->awaiting_key_unit, FALSE);
+    } else if (state->decodable && !state->gop_dropping &&
+               gst_rerun_sink_shed_access_unit(self, state, has_reference)) {
+        return;
+    }
 
-typedef struct _GstRerunSink {
-  GstVideoSink      parent_instance;
-  GstRerunSinkPrivate *priv;
-} GstRerunSink;
+    if (state->gop_dropping) {
+        priv->gop_dropped++;
+        gst_rerun_sink_request_key_unit(self, "reference frame dropped", TRUE);
+        return;
+    }
 
-struct _GstRerunSinkClass {
-  GstVideoSinkClass parent_class;
-};
+    if (!state->decodable) {
+        if (!keyframe) {
+            state->withheld++;
+            gst_rerun_sink_request_key_unit(self, "waiting for a keyframe", TRUE);
+            GST_LOG_OBJECT(self, "Withholding access unit until the first keyframe");
+            return;
+        }
 
-G_DEFINE_TYPE_WITH_PRIVATE(GstRerunSink, gst_rerun_sink, GST_TYPE_VIDEO_SINK)
+        state->decodable = TRUE;
+        if (state->withheld) {
+            GST_INFO_OBJECT(self, "Stream decodable after withholding %" G_GUINT64_FORMAT " access units",
+                            state->withheld);
+        }
+    }
 
-static rerun::archetypes::Image create_image_from_format(
-    const std::vector<std::uint8_t>& raw_data,
-    GstVideoFormat format,
-    gint width,
-    gint height);
+    // Segments keep the parameter sets in their own header
+    if (priv->segment_duration) {
+        gst_rerun_sink_segment_access_unit(self, plan, state, data, size, time, keyframe);
+        return;
+    }
 
-static GstFlowReturn process_encoded_video(
-    GstRerunSink* self,
-    GstBuffer* buffer,
-    GstCaps* caps);
+    if (keyframe && !(has_sps && has_pps)) {
+        state->sample.clear();
+        state->sample.insert(state->sample.end(), data, data + prefix_end);
+        rerun_h264_append_nal(&state->sample, state->sps.data(), state->sps.size());
+        rerun_h264_append_nal(&state->sample, state->pps.data(), state->pps.size());
+        state->sample.insert(state->sample.end(), data + prefix_end, data + size);
+
+        GST_LOG_OBJECT(self, "Injected SPS/PPS before IDR access unit");
+        data = state->sample.data();
+        size = state->sample.size();
+    }
 
-static gboolean is_encoded_format(GstCaps* caps);
+    // Rotated files start at a keyframe, and need the codec announced again.
+    // Another sink sharing the outputs may also have rotated them mid-GOP, so
+    // this stream only decodes in the new file from its next keyframe. Either
+    // way, asking for that keyframe now keeps the wait short.
+    gboolean rotation_due = FALSE;
+    guint rotated = rerun_output_set_rotate(priv->output_set, &priv->output_cursor, time->running_time, keyframe,
+                                            &rotation_due);
+
+    if (rotation_due) {
+        gst_rerun_sink_request_key_unit(self, "output rotation due", FALSE);
+    } else if (rotated && !keyframe) {
+        gst_rerun_sink_request_key_unit(self, "output rotated", FALSE);
+    }
 
-#ifdef HAVE_NVMM_SUPPORT
-static gboolean is_nvmm_memory(GstBuffer* buffer);
-static GstFlowReturn process_nvmm_buffer(
+    if (!state->codec_announced) {
+        auto video_stream = rerun::archetypes::VideoStream().with_codec(plan->codec);
+        gst_rerun_sink_log_static(self, rerun_output_set_all(priv->output_set), priv->stream_path, video_stream);
+        state->codec_announced = TRUE;
+        GST_INFO_OBJECT(self, "Announced codec on %s (caps generation %u)", priv->stream_path, plan->generation);
+    } else if (rotated) {
+        auto video_stream = rerun::archetypes::VideoStream().with_codec(plan->codec);
+        gst_rerun_sink_log_static(self, rotated, priv->stream_path, video_stream);
+    }
+
+    // A delta frame is only of use where its keyframe was logged, so outputs
+    // are thinned a GOP at a time
+    if (keyframe) {
+        state->outputs = rerun_output_set_admit(priv->output_set, &state->pacing, state->gops++, time->running_time);
+    }
+    if (!state->outputs) {
+        return;
+    }
+
+    RerunFrameTime sample_time = *time;
+    sample_time.outputs = state->outputs;
+    gst_rerun_sink_set_frame_time(self, &sample_time);
+
+    if (priv->keyframe_markers) {
+        gst_rerun_sink_set_sequence(self, state->outputs, "video_sample", state->samples);
+    }
+
+    auto byte_collection = rerun::Collection<uint8_t>::borrow(data, size);
+    auto sample = rerun::components::VideoSample(std::move(byte_collection));
+    auto video_stream = rerun::archetypes::VideoStream().with_sample(sample);
+
+    gst_rerun_sink_log(self, state->outputs, priv->stream_path, video_stream);
+    state->samples++;
+
+    if (!keyframe) {
+        return;
+    }
+
+    gst_rerun_sink_mark_keyframe(self, state, state->samples - 1, state->outputs);
+}
+
+static void gst_rerun_sink_flush_access_unit(
     GstRerunSink* self,
-    GstBuffer* buffer,
-    const GstVideoInfo* info,
-    rerun::archetypes::Image& image);
-#endif
+    const RerunRenderPlan* plan,
+    RerunEncodedState* state) {
+
+    if (state->pending.empty()) {
+        return;
+    }
+
+    gst_rerun_sink_log_access_unit(self, plan, state, state->pending.data(), state->pending.size(),
+                                   &state->pending_time);
+    state->pending.clear();
+    state->pending_slice = FALSE;
+}
 
-static GstFlowReturn process_regular_buffer(
+// alignment=nal: gathers NAL units into access units and logs each one as
+// soon as the first NAL unit of the next one arrives, or right away when
+// upstream marks the end of the access unit
+static void gst_rerun_sink_collect_nals(
     GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    RerunEncodedState* state,
     GstBuffer* buffer,
-    const GstVideoInfo* info,
-    rerun::archetypes::Image& image);
+    const RerunFrameTime* time,
+    const guint8* data,
+    gsize size) {
 
-static GstFlowReturn gst_rerun_sink_render(GstBaseSink *sink, GstBuffer *buffer) {
-    GstRerunSink* self = GST_RERUN_SINK(sink);
-    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    RerunNalUnit nal;
+    gsize offset = 0;
 
-    GstCaps *caps = gst_pad_get_current_caps(GST_VIDEO_SINK_PAD(sink));
-    if (!caps) {
-        GST_ERROR_OBJECT(self, "Failed to get caps");
-        return GST_FLOW_ERROR;
-    }
+    while (rerun_h264_next_nal(data, size, &offset, &nal)) {
+        if (rerun_h264_starts_access_unit(&nal, state->pending_slice)) {
+            gst_rerun_sink_flush_access_unit(self, plan, state);
+        }
 
-    if (is_encoded_format(caps)) {
-        GstFlowReturn ret = process_encoded_video(self, buffer, caps);
-        gst_caps_unref(caps);
-        return ret;
+        if (state->pending.empty()) {
+            state->pending_time = *time;
+        }
+
+        rerun_h264_append_nal(&state->pending, nal.data, nal.size);
+        if (nal.type >= RERUN_H264_NAL_SLICE && nal.type <= RERUN_H264_NAL_IDR) {
+            state->pending_slice = TRUE;
+        }
     }
 
-    GstVideoInfo info;
-    if (!gst_video_info_from_caps(&info, caps)) {
-        GST_ERROR_OBJECT(self, "Failed to get video info from caps");
-        gst_caps_unref(caps);
-        return GST_FLOW_ERROR;
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_VIDEO_BUFFER_FLAG_MARKER)) {
+        gst_rerun_sink_flush_access_unit(self, plan, state);
     }
-    gst_caps_unref(caps);
+}
 
-    // Process the buffer based on memory type
-    rerun::archetypes::Image image;
-    GstFlowReturn ret;
+// H.265 access units always go to segments, which start at an IRAP picture
+static void gst_rerun_sink_log_h265_access_unit(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    RerunEncodedState* state,
+    const RerunFrameTime* time,
+    const guint8* data,
+    gsize size) {
 
-#ifdef HAVE_NVMM_SUPPORT
-    if (is_nvmm_memory(buffer)) {
-        ret = process_nvmm_buffer(self, buffer, &info, image);
-    } else 
-#endif
-    {
-        ret = process_regular_buffer(self, buffer, &info, image);
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    gboolean keyframe = FALSE;
+    RerunNalUnit nal;
+    gsize offset = 0;
+
+    while (rerun_h264_next_nal(data, size, &offset, &nal)) {
+        guint type = RERUN_H265_NAL_TYPE(&nal);
+
+        if (type >= RERUN_H265_NAL_IRAP_FIRST && type <= RERUN_H265_NAL_IRAP_LAST) {
+            keyframe = TRUE;
+        } else if (type == RERUN_H265_NAL_VPS) {
+            state->vps.assign(nal.data, nal.data + nal.size);
+        } else if (type == RERUN_H265_NAL_SPS) {
+            state->sps.assign(nal.data, nal.data + nal.size);
+        } else if (type == RERUN_H265_NAL_PPS) {
+            state->pps.assign(nal.data, nal.data + nal.size);
+        }
     }
 
-    if (ret != GST_FLOW_OK) {
-        return ret;
-    }
+    keyframe = keyframe && !state->vps.empty() && !state->sps.empty() && !state->pps.empty();
 
-    if (priv->rerun_initialized && priv->rec_stream && priv->image_path) {
-        priv->rec_stream->log(priv->image_path, image);
-    } else if (!priv->image_path) {
-        GST_WARNING_OBJECT(self, "image-path property not set, skipping frame logging");
+    if (!state->decodable) {
+        if (!keyframe) {
+            state->withheld++;
+            gst_rerun_sink_request_key_unit(self, "waiting for a keyframe", TRUE);
+            return;
+        }
+        state->decodable = TRUE;
+        if (state->withheld) {
+            GST_INFO_OBJECT(self, "Stream decodable after withholding %" G_GUINT64_FORMAT " access units",
+                            state->withheld);
+        }
     }
 
-    return GST_FLOW_OK;
-}
+    if (keyframe) {
+        g_atomic_int_set(&priv->awaiting_key_unit, FALSE);
+    }
 
-static gboolean is_encoded_format(GstCaps* caps) {
-    if (!caps) return FALSE;
-    
-    GstStructure* structure = gst_caps_get_structure(caps, 0);
-    if (!structure) return FALSE;
-    
-    const gchar* name = gst_structure_get_name(structure);
-    return (g_strcmp0(name, "video/x-h264") == 0 || 
-            g_strcmp0(name, "video/x-h265") == 0);
+    gst_rerun_sink_segment_access_unit(self, plan, state, data, size, time, keyframe);
 }
 
 static GstFlowReturn process_encoded_video(
     GstRerunSink* self,
+    const RerunRenderPlan* plan,
     GstBuffer* buffer,
-    GstCaps* caps) {
+    const RerunFrameTime* time) {
     
     GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
     
-    if (!priv->rerun_initialized || !priv->rec_stream || !priv->video_path) {
+    if (!priv->rerun_initialized || !priv->output_set || !priv->stream_path) {
         GST_WARNING_OBJECT(self, "video-path property not set, skipping frame logging");
         return GST_FLOW_OK;
     }
-    
-    GstStructure* structure = gst_caps_get_structure(caps, 0);
-    const gchar* format_name = gst_structure_get_name(structure);
-    
-    gint width = 0, height = 0;
-    gst_structure_get_int(structure, "width", &width);
-
-    if (!width) {
-        GST_ERROR_OBJECT(self, "Failed to get width of encoded frame");
-        return GST_FLOW_ERROR;
-    }
-
-    gst_structure_get_int(structure, "height", &height);
-
-    if (!height) {
-        GST_ERROR_OBJECT(self, "Failed to get width of encoded frame");
-        return GST_FLOW_ERROR;
-    }
-    
-    const gchar* codec_data_str = NULL;
-    if (g_strcmp0(format_name, "video/x-h264") == 0) {
-        codec_data_str = gst_structure_get_string(structure, "stream-format");
-        GST_INFO_OBJECT(self, "H.264 stream detected: %dx%d, stream-format: %s", 
-                        width, height, codec_data_str ? codec_data_str : "unknown");
-    } else if (g_strcmp0(format_name, "video/x-h265") == 0) {
-        codec_data_str = gst_structure_get_string(structure, "stream-format");
-        GST_INFO_OBJECT(self, "H.265 stream detected: %dx%d, stream-format: %s", 
-                        width, height, codec_data_str ? codec_data_str : "unknown");
-        GST_DEBUG_OBJECT(self, "Encoded H.265 video support coming soon in Rerun. Buffer size: %" G_GSIZE_FORMAT, 
-                     gst_buffer_get_size(buffer));
 
-        return GST_FLOW_OK;
+    RerunEncodedState* state = priv->encoded;
+    if (state->generation != plan->generation) {
+        gst_rerun_sink_reset_encoded_state(state, plan->generation);
+        state->vps = plan->vps;
+        state->sps = plan->sps;
+        state->pps = plan->pps;
     }
 
     GstMapInfo map;
@@ -243,52 +1924,142 @@ static GstFlowReturn process_encoded_video(
         return GST_FLOW_ERROR;
     }
 
-    auto timestamp = time_point<steady_clock, nanoseconds>(nanoseconds(GST_BUFFER_DTS(buffer)));
-    priv->rec_stream->set_time_timestamp("time", timestamp);
+    const guint8* data = map.data;
+    gsize size = map.size;
+
+    // References may be missing after a discontinuity or a flush, wait for
+    // a keyframe. A GOP being shed is over too: the keyframe that ends it may
+    // be gone, and whatever follows is withheld until the next one anyway.
+    // What was collected before the gap is still a complete run of frames,
+    // unlike a partial access unit.
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT) ||
+        g_atomic_int_compare_and_exchange(&priv->encoded_flushed, TRUE, FALSE)) {
+        state->decodable = FALSE;
+        state->gop_dropping = FALSE;
+        gst_rerun_sink_log_segment(self, state, GST_CLOCK_TIME_NONE);
+
+        if (!state->pending.empty()) {
+            GST_DEBUG_OBJECT(self, "Discarding partial access unit on discontinuity");
+            state->pending.clear();
+            state->pending_slice = FALSE;
+        }
 
-    static bool codec_sent = false;
-    if (!codec_sent) {
-        auto video_stream = rerun::archetypes::VideoStream().with_codec(rerun::components::VideoCodec::H264);
-        priv->rec_stream->log_static(priv->video_path, video_stream);
-        codec_sent = true;
+        if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+            gst_rerun_sink_request_key_unit(self, "discontinuity", TRUE);
+        }
     }
 
-    auto byte_collection = rerun::Collection<uint8_t>::borrow(map.data, map.size);
-    auto sample = rerun::components::VideoSample(std::move(byte_collection));
-    auto video_stream = rerun::archetypes::VideoStream().with_sample(sample);
+    // Length-prefixed input is rewritten into a reused vector, byte-stream is borrowed
+    if (plan->nal_length_size) {
+        state->annexb.clear();
+        if (!rerun_h264_avc_to_annexb(map.data, map.size, plan->nal_length_size, &state->annexb)) {
+            GST_WARNING_OBJECT(self, "Dropping truncated %s buffer of %" G_GSIZE_FORMAT " bytes",
+                               plan->stream_format, map.size);
+            gst_buffer_unmap(buffer, &map);
+            return GST_FLOW_OK;
+        }
+        data = state->annexb.data();
+        size = state->annexb.size();
+    }
 
-    priv->rec_stream->log(priv->video_path, video_stream);
+    if (plan->is_h265) {
+        gst_rerun_sink_log_h265_access_unit(self, plan, state, time, data, size);
+    } else if (plan->nal_aligned) {
+        gst_rerun_sink_collect_nals(self, plan, state, buffer, time, data, size);
+    } else {
+        gst_rerun_sink_log_access_unit(self, plan, state, data, size, time);
+    }
     
     gst_buffer_unmap(buffer, &map);
 
     return GST_FLOW_OK;
 }
 
-#ifdef HAVE_NVMM_SUPPORT
-static gboolean is_nvmm_memory(GstBuffer* buffer) {
-    GstMemory *memory = gst_buffer_peek_memory(buffer, 0);
-    if (!memory) {
-        return FALSE;
+// image/jpeg and image/png buffers are logged as they are. The bytes are
+// borrowed from the mapped buffer, as for VideoSample, so nothing is decoded
+// or copied on the way.
+static GstFlowReturn process_encoded_image(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    GstBuffer* buffer,
+    const RerunFrameTime* time) {
+
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    GstMapInfo map;
+
+    if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+        GST_ERROR_OBJECT(self, "Failed to map buffer for reading");
+        return GST_FLOW_ERROR;
     }
 
-    GstAllocator *allocator = memory->allocator;
-    if (!allocator) {
-        return FALSE;
+    rerun_output_set_rotate(priv->output_set, &priv->output_cursor, time->running_time, TRUE, NULL);
+    log_image(self, time->outputs, priv->image_path, rerun::archetypes::EncodedImage::from_bytes(
+        rerun::Collection<std::uint8_t>::borrow(map.data, map.size),
+        std::string(rerun_image_encoding_media_type(plan->encoding))));
+    gst_buffer_unmap(buffer, &map);
+
+    return GST_FLOW_OK;
+}
+
+// Timelines of the raw frame the encoder turned into @buffer
+static void gst_rerun_sink_take_encoded_time(GstRerunSink* self, GstBuffer* buffer, RerunFrameTime* time) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    gboolean found = FALSE;
+
+    // The encoder keeps frame order and PTS, so frames it dropped are the
+    // ones skipped over
+    g_mutex_lock(&priv->video_time_lock);
+    while (GST_CLOCK_TIME_IS_VALID(pts) && !priv->video_times->empty() && priv->video_times->front().pts < pts) {
+        priv->video_times->pop_front();
+    }
+    if (!priv->video_times->empty() &&
+        (!GST_CLOCK_TIME_IS_VALID(pts) || priv->video_times->front().pts == pts)) {
+        *time = priv->video_times->front();
+        priv->video_times->pop_front();
+        priv->video_index = time->index;
+        found = TRUE;
+    }
+    guint64 index = priv->video_index;
+    g_mutex_unlock(&priv->video_time_lock);
+
+    if (!found) {
+        GST_LOG_OBJECT(self, "No raw frame matches encoded PTS %" GST_TIME_FORMAT, GST_TIME_ARGS(pts));
+        time->pts = pts;
+        time->running_time = GST_CLOCK_TIME_NONE;
+        time->stream_time = GST_CLOCK_TIME_NONE;
+        time->index = index;
+        time->outputs = rerun_output_set_all(priv->output_set);
     }
 
-    const gchar *allocator_name = gst_object_get_name(GST_OBJECT(allocator));
+    time->dts = GST_BUFFER_DTS_OR_PTS(buffer);
+}
 
-    gboolean is_nvmm = (
-        g_strcmp0(allocator_name, "nvfiltermemoryallocator0") == 0 ||
-        g_strcmp0(allocator_name, "nvdsmemoryallocator0") == 0
-    );
-    
-    
-    GST_DEBUG("Allocator: %s, is NVMM: %s", allocator_name, is_nvmm ? "yes" : "no");
-    
-    return is_nvmm;
+// Output of the internal encoder, logged like H.264 coming from upstream.
+// Runs on the encoder's streaming thread, which owns video_plan.
+static void gst_rerun_sink_log_encoded_output(GstCaps* caps, GstBuffer* buffer, gpointer user_data) {
+    GstRerunSink* self = GST_RERUN_SINK(user_data);
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    if (!priv->video_plan || (caps != priv->video_caps && !gst_caps_is_equal(caps, priv->video_caps))) {
+        RerunRenderPlan* plan = rerun_render_plan_new_from_caps(self, caps);
+        if (!plan) {
+            return;
+        }
+
+        if (priv->video_plan) {
+            rerun_render_plan_unref(priv->video_plan);
+        }
+        priv->video_plan = plan;
+        gst_caps_replace(&priv->video_caps, caps);
+    }
+
+    RerunFrameTime time;
+    gst_rerun_sink_take_encoded_time(self, buffer, &time);
+    process_encoded_video(self, priv->video_plan, buffer, &time);
 }
 
+#ifdef HAVE_NVMM_SUPPORT
 static GstFlowReturn process_nvmm_buffer(
     GstRerunSink* self,
     GstBuffer* buffer,
@@ -391,98 +2162,237 @@ static GstFlowReturn process_nvmm_buffer(
 }
 #endif
 
-// Process regular CPU buffer
-static GstFlowReturn process_regular_buffer(
+// Process regular CPU buffer. The image borrows the mapped memory of @frame
+// instead of copying it, so the caller must keep the frame mapped until the
+// image has been logged. Frames whose planes carry stride padding or custom
+// offsets (GstVideoMeta) are packed into a reusable scratch buffer first,
+// since Rerun only understands tightly packed planes.
+static rerun::archetypes::Image process_regular_buffer(
     GstRerunSink* self,
-    GstBuffer* buffer,
-    const GstVideoInfo* info,
-    rerun::archetypes::Image& image) {
+    const RerunRenderPlan* plan,
+    const GstVideoFrame* frame) {
     
-    GstMapInfo map;
-    if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
-        GST_ERROR_OBJECT(self, "Failed to map buffer for reading");
-        return GST_FLOW_ERROR;
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    const RerunPlaneLayout* layout = &plan->layout;
+
+    rerun::Collection<std::uint8_t> raw_data;
+    if (rerun_frame_is_packed(frame, layout)) {
+        raw_data = rerun::Collection<std::uint8_t>::borrow(
+            (const std::uint8_t*)GST_VIDEO_FRAME_PLANE_DATA(frame, 0), layout->size);
+    } else {
+        GST_LOG_OBJECT(self, "Packing padded frame into %" G_GSIZE_FORMAT " bytes", layout->size);
+        if (!priv->pack_buffer) {
+            priv->pack_buffer = new std::vector<std::uint8_t>();
+        }
+        priv->pack_buffer->resize(layout->size);
+        rerun_frame_pack(frame, layout, priv->pack_buffer->data());
+        raw_data = rerun::Collection<std::uint8_t>::borrow(priv->pack_buffer->data(), layout->size);
+    }
+
+    return create_image_from_plan(std::move(raw_data), plan, plan->width, plan->height);
+}
+
+// Box-filters @frame down by plan->scale_factor into a reusable scratch buffer
+static rerun::archetypes::Image downscale_regular_buffer(
+    GstRerunSink* self,
+    const RerunRenderPlan* plan,
+    const GstVideoFrame* frame) {
+
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+    const RerunPlaneLayout* layout = &plan->scaled_layout;
+
+    if (!priv->scale_buffer) {
+        priv->scale_buffer = new std::vector<std::uint8_t>();
+    }
+    priv->scale_buffer->resize(layout->size);
+    rerun_frame_downscale(frame, layout, plan->scale_factor, priv->scale_buffer->data());
+
+    return create_image_from_plan(
+        rerun::Collection<std::uint8_t>::borrow(priv->scale_buffer->data(), layout->size),
+        plan,
+        GST_VIDEO_INFO_WIDTH(&plan->scaled_info),
+        GST_VIDEO_INFO_HEIGHT(&plan->scaled_info));
+}
+
+static rerun::archetypes::Image create_image_from_plan(
+    rerun::Collection<std::uint8_t> raw_data,
+    const RerunRenderPlan* plan,
+    gint width,
+    gint height) {
+
+    if (plan->has_pixel_format) {
+        return rerun::archetypes::Image(
+            std::move(raw_data),
+            rerun::WidthHeight(width, height),
+            plan->pixel_format
+        );
     }
 
-    // Create a copy of the data
-    std::vector<std::uint8_t> raw_data(map.data, map.data + map.size);
+    return rerun::archetypes::Image(
+        std::move(raw_data),
+        rerun::WidthHeight(width, height),
+        plan->color_model,
+        plan->datatype
+    );
+}
+
+static gboolean gst_rerun_sink_set_caps(GstBaseSink *sink, GstCaps *caps) {
+    GstRerunSink *self = GST_RERUN_SINK(sink);
     
-    gint width = GST_VIDEO_INFO_WIDTH(info);
-    gint height = GST_VIDEO_INFO_HEIGHT(info);
+    gchar *caps_str = gst_caps_to_string(caps);
+    GST_INFO_OBJECT(self, "Caps negotiated: %s", caps_str);
+    g_free(caps_str);
+
+    RerunRenderPlan* plan = rerun_render_plan_new_from_caps(self, caps);
+    if (!plan) {
+        return FALSE;
+    }
+    gst_rerun_sink_set_plan(self, plan);
     
-    GST_DEBUG_OBJECT(self, "Regular buffer: %dx%d, format: %s", 
-                     width, height, gst_video_format_to_string(info->finfo->format));
+    return GST_BASE_SINK_CLASS(gst_rerun_sink_parent_class)->set_caps(sink, caps);
+}
 
-    image = create_image_from_format(raw_data, info->finfo->format, width, height);
+static gboolean gst_rerun_sink_event(GstBaseSink *sink, GstEvent *event) {
+    GstRerunSink *self = GST_RERUN_SINK(sink);
+    GstRerunSinkPrivate *priv = (GstRerunSinkPrivate *)gst_rerun_sink_get_instance_private(self);
 
-    gst_buffer_unmap(buffer, &map);
+    // The encoded state belongs to whichever thread logs, so the flush is
+    // only flagged here
+    if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP) {
+        gst_rerun_sink_reset_decimation(self);
+        g_atomic_int_set(&priv->encoded_flushed, TRUE);
+    }
 
-    if (info->finfo->format != GST_VIDEO_FORMAT_RGB &&
-        info->finfo->format != GST_VIDEO_FORMAT_RGBA &&
-        info->finfo->format != GST_VIDEO_FORMAT_GRAY8 &&
-        info->finfo->format != GST_VIDEO_FORMAT_NV12 &&
-        info->finfo->format != GST_VIDEO_FORMAT_I420) {
-        GST_WARNING_OBJECT(self, "Unsupported format: %s",
-                          gst_video_format_to_string(info->finfo->format));
-        return GST_FLOW_NOT_NEGOTIATED;
+    if (priv->worker) {
+        switch (GST_EVENT_TYPE(event)) {
+            case GST_EVENT_FLUSH_START:
+                rerun_log_worker_set_flushing(priv->worker, TRUE);
+                break;
+
+            case GST_EVENT_FLUSH_STOP:
+                rerun_log_worker_set_flushing(priv->worker, FALSE);
+                g_atomic_int_set(&priv->worker_flow, GST_FLOW_OK);
+                break;
+
+            case GST_EVENT_EOS:
+                // Everything must reach Rerun before EOS is posted
+                rerun_log_worker_drain(priv->worker);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (GST_EVENT_TYPE(event) == GST_EVENT_EOS && priv->encoder_pool) {
+        gst_rerun_sink_drain_encoder(self);
+    }
+
+    if (GST_EVENT_TYPE(event) == GST_EVENT_EOS && priv->video_encoder) {
+        rerun_video_encoder_drain(priv->video_encoder);
+    }
+
+    // Nothing follows the last access unit of an alignment=nal stream, or
+    // the last H.265 segment, so they are only complete at EOS. The worker
+    // is drained by now. With the internal encoder, the encoded state follows
+    // the plan of its output, which is idle once the encoder is drained.
+    if (GST_EVENT_TYPE(event) == GST_EVENT_EOS && priv->encoded) {
+        RerunRenderPlan* plan = NULL;
+        if (!priv->video_encoder) {
+            plan = gst_rerun_sink_get_plan(self);
+        } else if (priv->video_plan) {
+            plan = rerun_render_plan_ref(priv->video_plan);
+        }
+        if (plan && plan->generation == priv->encoded->generation) {
+            gst_rerun_sink_flush_access_unit(self, plan, priv->encoded);
+            gst_rerun_sink_log_segment(self, priv->encoded, GST_CLOCK_TIME_NONE);
+        }
+        if (plan) {
+            rerun_render_plan_unref(plan);
+        }
+    }
+
+    return GST_BASE_SINK_CLASS(gst_rerun_sink_parent_class)->event(sink, event);
+}
+
+static gboolean gst_rerun_sink_unlock(GstBaseSink *sink) {
+    GstRerunSink *self = GST_RERUN_SINK(sink);
+    GstRerunSinkPrivate *priv = (GstRerunSinkPrivate *)gst_rerun_sink_get_instance_private(self);
+
+    if (priv->worker) {
+        rerun_log_worker_set_unblocked(priv->worker, TRUE);
+    }
+
+    return TRUE;
+}
+
+static gboolean gst_rerun_sink_unlock_stop(GstBaseSink *sink) {
+    GstRerunSink *self = GST_RERUN_SINK(sink);
+    GstRerunSinkPrivate *priv = (GstRerunSinkPrivate *)gst_rerun_sink_get_instance_private(self);
+
+    if (priv->worker) {
+        rerun_log_worker_set_unblocked(priv->worker, FALSE);
+    }
+
+    return TRUE;
+}
+
+// Offers upstream a pool whose buffers already have the layout Rerun expects,
+// so decoders and converters write frames that can be logged without repacking
+static gboolean gst_rerun_sink_propose_allocation(GstBaseSink *sink, GstQuery *query) {
+    GstRerunSink *self = GST_RERUN_SINK(sink);
+    GstRerunSinkPrivate *priv = (GstRerunSinkPrivate *)gst_rerun_sink_get_instance_private(self);
+
+    GstCaps *caps = NULL;
+    gboolean need_pool = FALSE;
+    gst_query_parse_allocation(query, &caps, &need_pool);
+
+    if (!caps) {
+        GST_DEBUG_OBJECT(self, "Allocation query without caps");
+        return FALSE;
     }
 
-    return GST_FLOW_OK;
-}
+    // Encoded streams and NVMM surfaces have no CPU frame layout to propose
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    GstCapsFeatures *features = gst_caps_get_features(caps, 0);
+    if (!gst_structure_has_name(structure, "video/x-raw") ||
+        (features && gst_caps_features_contains(features, "memory:NVMM"))) {
+        return TRUE;
+    }
 
-static rerun::archetypes::Image create_image_from_format(
-    const std::vector<std::uint8_t>& raw_data,
-    GstVideoFormat format,
-    gint width,
-    gint height) {
-    
-    switch (format) {
-        case GST_VIDEO_FORMAT_RGB:
-            return rerun::archetypes::Image::from_rgb24(
-                raw_data,
-                rerun::WidthHeight(width, height)
-            );
+    GstVideoInfo info;
+    if (!gst_video_info_from_caps(&info, caps)) {
+        GST_DEBUG_OBJECT(self, "Invalid caps in allocation query");
+        return FALSE;
+    }
 
-        case GST_VIDEO_FORMAT_RGBA:
-            return rerun::archetypes::Image::from_rgba32(
-                raw_data,
-                rerun::WidthHeight(width, height)
-            );
+    GstBufferPool *pool = NULL;
+    if (need_pool) {
+        pool = gst_rerun_buffer_pool_new(priv->huge_pages);
 
-        case GST_VIDEO_FORMAT_GRAY8:
-            return rerun::archetypes::Image::from_grayscale8(
-                raw_data,
-                rerun::WidthHeight(width, height)
-            );
+        GstStructure *config = gst_buffer_pool_get_config(pool);
+        gst_buffer_pool_config_set_params(config, caps, GST_VIDEO_INFO_SIZE(&info), POOL_MIN_BUFFERS, 0);
+        if (!gst_buffer_pool_set_config(pool, config)) {
+            GST_ERROR_OBJECT(self, "Failed to configure buffer pool");
+            gst_object_unref(pool);
+            return FALSE;
+        }
+    }
 
-        case GST_VIDEO_FORMAT_NV12:
-            return rerun::archetypes::Image(
-                raw_data,
-                rerun::WidthHeight(width, height),
-                rerun::datatypes::PixelFormat::NV12
-            );
+    GstAllocationParams params;
+    gst_allocation_params_init(&params);
+    params.align = GST_RERUN_BUFFER_POOL_ALIGN;
 
-        case GST_VIDEO_FORMAT_I420:
-            return rerun::archetypes::Image(
-                raw_data,
-                rerun::WidthHeight(width, height),
-                rerun::datatypes::PixelFormat::Y_U_V12_LimitedRange
-            );
+    gst_query_add_allocation_pool(query, pool, GST_VIDEO_INFO_SIZE(&info), POOL_MIN_BUFFERS, 0);
+    gst_query_add_allocation_param(query, NULL, &params);
+    gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
 
-        default:
-            // Return empty image for unsupported formats
-            return rerun::archetypes::Image();
+    if (pool) {
+        gst_object_unref(pool);
     }
-}
 
-static gboolean gst_rerun_sink_set_caps(GstBaseSink *sink, GstCaps *caps) {
-    GstRerunSink *self = GST_RERUN_SINK(sink);
-    
-    gchar *caps_str = gst_caps_to_string(caps);
-    GST_INFO_OBJECT(self, "Caps negotiated: %s", caps_str);
-    g_free(caps_str);
-    
-    return GST_BASE_SINK_CLASS(gst_rerun_sink_parent_class)->set_caps(sink, caps);
+    return TRUE;
 }
 
 static void gst_rerun_sink_set_property(GObject *object, guint prop_id,
@@ -525,6 +2435,182 @@ static void gst_rerun_sink_set_property(GObject *object, guint prop_id,
             priv->grpc_address = g_value_dup_string(value);
             GST_INFO_OBJECT(self, "Set grpc-address: %s", priv->grpc_address);
             break;
+
+        case PROP_HUGE_PAGES:
+            priv->huge_pages = g_value_get_boolean(value);
+            GST_INFO_OBJECT(self, "Set huge-pages: %s", priv->huge_pages ? "true" : "false");
+            break;
+
+        case PROP_ASYNC_LOGGING:
+            priv->async_logging = g_value_get_boolean(value);
+            GST_INFO_OBJECT(self, "Set async-logging: %s", priv->async_logging ? "true" : "false");
+            break;
+
+        case PROP_QUEUE_DEPTH:
+            priv->queue_depth = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set queue-depth: %u", priv->queue_depth);
+            break;
+
+        case PROP_QUEUE_POLICY:
+            priv->queue_policy = (RerunQueuePolicy)g_value_get_enum(value);
+            GST_INFO_OBJECT(self, "Set queue-policy: %d", priv->queue_policy);
+            break;
+
+        case PROP_MAX_FPS:
+            priv->max_fps = g_value_get_double(value);
+            GST_INFO_OBJECT(self, "Set max-fps: %f", priv->max_fps);
+            break;
+
+        case PROP_KEEP_EVERY:
+            priv->keep_every = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set keep-every: %u", priv->keep_every);
+            break;
+
+        case PROP_SCALE_FACTOR:
+            // The kernels halve one or more times, so 3 fits the range but
+            // cannot be done
+            if (g_value_get_uint(value) & (g_value_get_uint(value) - 1)) {
+                GST_WARNING_OBJECT(self, "Refusing scale-factor %u, keeping %u: only 1, 2 and 4 are supported",
+                                   g_value_get_uint(value), priv->scale_factor);
+                break;
+            }
+            priv->scale_factor = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set scale-factor: %u", priv->scale_factor);
+            break;
+
+        case PROP_TARGET_SIZE:
+            priv->target_size = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set target-size: %u", priv->target_size);
+            break;
+
+        case PROP_FULL_RES_EVERY:
+            priv->full_res_every = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set full-res-every: %u", priv->full_res_every);
+            break;
+
+        case PROP_IMAGE_ENCODING:
+            priv->image_encoding = (RerunImageEncoding)g_value_get_enum(value);
+            GST_INFO_OBJECT(self, "Set image-encoding: %d", priv->image_encoding);
+            break;
+
+        case PROP_JPEG_QUALITY:
+            priv->jpeg_quality = g_value_get_int(value);
+            GST_INFO_OBJECT(self, "Set jpeg-quality: %d", priv->jpeg_quality);
+            break;
+
+        case PROP_ENCODER_THREADS:
+            priv->encoder_threads = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set encoder-threads: %u", priv->encoder_threads);
+            break;
+
+        case PROP_KEYFRAME_MARKERS:
+            priv->keyframe_markers = g_value_get_boolean(value);
+            GST_INFO_OBJECT(self, "Set keyframe-markers: %s", priv->keyframe_markers ? "true" : "false");
+            break;
+
+        case PROP_REFERENCE_DROPPING:
+            priv->reference_dropping = g_value_get_boolean(value);
+            GST_INFO_OBJECT(self, "Set reference-dropping: %s", priv->reference_dropping ? "true" : "false");
+            break;
+
+        case PROP_FORCE_KEY_UNITS:
+            priv->force_key_units = g_value_get_boolean(value);
+            GST_INFO_OBJECT(self, "Set force-key-units: %s", priv->force_key_units ? "true" : "false");
+            break;
+
+        case PROP_VIDEO_ENCODING:
+            priv->video_encoding = (RerunVideoEncoding)g_value_get_enum(value);
+            GST_INFO_OBJECT(self, "Set video-encoding: %d", priv->video_encoding);
+            break;
+
+        case PROP_VIDEO_ENCODER:
+            g_free(priv->video_encoder_name);
+            priv->video_encoder_name = g_value_dup_string(value);
+            GST_INFO_OBJECT(self, "Set video-encoder: %s", priv->video_encoder_name);
+            break;
+
+        case PROP_VIDEO_BITRATE:
+            priv->video_bitrate = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set video-bitrate: %u", priv->video_bitrate);
+            break;
+
+        case PROP_KEYFRAME_INTERVAL:
+            priv->keyframe_interval = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set keyframe-interval: %u", priv->keyframe_interval);
+            break;
+
+        case PROP_SPEED_PRESET:
+            g_free(priv->speed_preset);
+            priv->speed_preset = g_value_dup_string(value);
+            GST_INFO_OBJECT(self, "Set speed-preset: %s", priv->speed_preset);
+            break;
+
+        case PROP_SEGMENT_DURATION:
+            priv->segment_duration = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set segment-duration: %u", priv->segment_duration);
+            break;
+
+        case PROP_OUTPUTS:
+            g_free(priv->outputs);
+            priv->outputs = g_value_dup_string(value);
+            GST_INFO_OBJECT(self, "Set outputs: %s", priv->outputs);
+            break;
+
+        case PROP_ROTATE_SIZE:
+            priv->rotate_size = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set rotate-size: %u", priv->rotate_size);
+            break;
+
+        case PROP_ROTATE_DURATION:
+            priv->rotate_duration = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set rotate-duration: %u", priv->rotate_duration);
+            break;
+
+        case PROP_MAX_FILES:
+            priv->max_files = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set max-files: %u", priv->max_files);
+            break;
+
+        case PROP_INDEX_FILE:
+            g_free(priv->index_file);
+            priv->index_file = g_value_dup_string(value);
+            GST_INFO_OBJECT(self, "Set index-file: %s", priv->index_file);
+            break;
+
+        case PROP_WRITE_SIZE:
+            priv->write_size = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set write-size: %u", priv->write_size);
+            break;
+
+        case PROP_PREALLOCATE:
+            priv->preallocate = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set preallocate: %u", priv->preallocate);
+            break;
+
+        case PROP_DIRECT_IO:
+            priv->direct_io = g_value_get_boolean(value);
+            GST_INFO_OBJECT(self, "Set direct-io: %s", priv->direct_io ? "true" : "false");
+            break;
+
+        case PROP_SYNC_INTERVAL:
+            priv->sync_interval = g_value_get_uint(value);
+            GST_INFO_OBJECT(self, "Set sync-interval: %u", priv->sync_interval);
+            break;
+
+        case PROP_OFFLINE: {
+            gboolean offline = g_value_get_boolean(value);
+            // Buffers are rendered as soon as they arrive instead of at their
+            // running time; leaving offline gives back the sync set before
+            if (offline && !priv->offline) {
+                priv->sync_before_offline = gst_base_sink_get_sync(GST_BASE_SINK(self));
+                gst_base_sink_set_sync(GST_BASE_SINK(self), FALSE);
+            } else if (!offline && priv->offline) {
+                gst_base_sink_set_sync(GST_BASE_SINK(self), priv->sync_before_offline);
+            }
+            priv->offline = offline;
+            GST_INFO_OBJECT(self, "Set offline: %s", priv->offline ? "true" : "false");
+            break;
+        }
             
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -561,6 +2647,134 @@ static void gst_rerun_sink_get_property(GObject *object, guint prop_id,
         case PROP_GRPC_ADDRESS:
             g_value_set_string(value, priv->grpc_address);
             break;
+
+        case PROP_HUGE_PAGES:
+            g_value_set_boolean(value, priv->huge_pages);
+            break;
+
+        case PROP_ASYNC_LOGGING:
+            g_value_set_boolean(value, priv->async_logging);
+            break;
+
+        case PROP_QUEUE_DEPTH:
+            g_value_set_uint(value, priv->queue_depth);
+            break;
+
+        case PROP_QUEUE_POLICY:
+            g_value_set_enum(value, priv->queue_policy);
+            break;
+
+        case PROP_MAX_FPS:
+            g_value_set_double(value, priv->max_fps);
+            break;
+
+        case PROP_KEEP_EVERY:
+            g_value_set_uint(value, priv->keep_every);
+            break;
+
+        case PROP_SCALE_FACTOR:
+            g_value_set_uint(value, priv->scale_factor);
+            break;
+
+        case PROP_TARGET_SIZE:
+            g_value_set_uint(value, priv->target_size);
+            break;
+
+        case PROP_FULL_RES_EVERY:
+            g_value_set_uint(value, priv->full_res_every);
+            break;
+
+        case PROP_IMAGE_ENCODING:
+            g_value_set_enum(value, priv->image_encoding);
+            break;
+
+        case PROP_JPEG_QUALITY:
+            g_value_set_int(value, priv->jpeg_quality);
+            break;
+
+        case PROP_ENCODER_THREADS:
+            g_value_set_uint(value, priv->encoder_threads);
+            break;
+
+        case PROP_KEYFRAME_MARKERS:
+            g_value_set_boolean(value, priv->keyframe_markers);
+            break;
+
+        case PROP_REFERENCE_DROPPING:
+            g_value_set_boolean(value, priv->reference_dropping);
+            break;
+
+        case PROP_FORCE_KEY_UNITS:
+            g_value_set_boolean(value, priv->force_key_units);
+            break;
+
+        case PROP_VIDEO_ENCODING:
+            g_value_set_enum(value, priv->video_encoding);
+            break;
+
+        case PROP_VIDEO_ENCODER:
+            g_value_set_string(value, priv->video_encoder_name);
+            break;
+
+        case PROP_VIDEO_BITRATE:
+            g_value_set_uint(value, priv->video_bitrate);
+            break;
+
+        case PROP_KEYFRAME_INTERVAL:
+            g_value_set_uint(value, priv->keyframe_interval);
+            break;
+
+        case PROP_SPEED_PRESET:
+            g_value_set_string(value, priv->speed_preset);
+            break;
+
+        case PROP_SEGMENT_DURATION:
+            g_value_set_uint(value, priv->segment_duration);
+            break;
+
+        case PROP_OFFLINE:
+            g_value_set_boolean(value, priv->offline);
+            break;
+
+        case PROP_OUTPUTS:
+            g_value_set_string(value, priv->outputs);
+            break;
+
+        case PROP_ROTATE_SIZE:
+            g_value_set_uint(value, priv->rotate_size);
+            break;
+
+        case PROP_ROTATE_DURATION:
+            g_value_set_uint(value, priv->rotate_duration);
+            break;
+
+        case PROP_MAX_FILES:
+            g_value_set_uint(value, priv->max_files);
+            break;
+
+        case PROP_INDEX_FILE:
+            g_value_set_string(value, priv->index_file);
+            break;
+
+        case PROP_WRITE_SIZE:
+            g_value_set_uint(value, priv->write_size);
+            break;
+
+        case PROP_PREALLOCATE:
+            g_value_set_uint(value, priv->preallocate);
+            break;
+
+        case PROP_DIRECT_IO:
+            g_value_set_boolean(value, priv->direct_io);
+            break;
+
+        case PROP_SYNC_INTERVAL:
+            g_value_set_uint(value, priv->sync_interval);
+            break;
+
+        case PROP_STATS:
+            g_value_take_boxed(value, gst_rerun_sink_get_stats(self));
+            break;
             
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -571,7 +2785,7 @@ static void gst_rerun_sink_get_property(GObject *object, guint prop_id,
 static void gst_rerun_sink_init(GstRerunSink *self) {
     GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
 
-    priv->rec_stream = nullptr;
+    priv->output_set = NULL;
     priv->rerun_initialized = FALSE;
     priv->recording_id = DEFAULT_RECORDING_ID;
     priv->image_path = DEFAULT_IMAGE_PATH;
@@ -580,6 +2794,122 @@ static void gst_rerun_sink_init(GstRerunSink *self) {
     priv->spawn_viewer = DEFAULT_SPAWN_VIEWER;
     priv->output_file = DEFAULT_OUTPUT_FILE;
     priv->grpc_address = g_strdup(DEFAULT_GRPC_ADDRESS);
+    priv->outputs = DEFAULT_OUTPUTS;
+    priv->rotate_size = DEFAULT_ROTATE_SIZE;
+    priv->rotate_duration = DEFAULT_ROTATE_DURATION;
+    priv->max_files = DEFAULT_MAX_FILES;
+    priv->index_file = DEFAULT_INDEX_FILE;
+    priv->write_size = DEFAULT_WRITE_SIZE;
+    priv->preallocate = DEFAULT_PREALLOCATE;
+    priv->direct_io = DEFAULT_DIRECT_IO;
+    priv->sync_interval = DEFAULT_SYNC_INTERVAL;
+    priv->huge_pages = DEFAULT_HUGE_PAGES;
+
+    priv->async_logging = DEFAULT_ASYNC_LOGGING;
+    priv->queue_depth = DEFAULT_QUEUE_DEPTH;
+    priv->queue_policy = DEFAULT_QUEUE_POLICY;
+    priv->worker = NULL;
+    priv->worker_flow = GST_FLOW_OK;
+
+    priv->max_fps = DEFAULT_MAX_FPS;
+    priv->keep_every = DEFAULT_KEEP_EVERY;
+    priv->frames_seen = 0;
+    priv->frames_skipped = 0;
+    priv->next_log_time = GST_CLOCK_TIME_NONE;
+    priv->gops_seen = 0;
+    priv->gop_kept = TRUE;
+    rerun_output_pacing_reset(&priv->output_pacing);
+
+    priv->scale_factor = DEFAULT_SCALE_FACTOR;
+    priv->target_size = DEFAULT_TARGET_SIZE;
+    priv->full_res_every = DEFAULT_FULL_RES_EVERY;
+    priv->full_res_path = NULL;
+    priv->raw_frames_logged = 0;
+    priv->scale_buffer = nullptr;
+
+    priv->image_encoding = DEFAULT_IMAGE_ENCODING;
+    priv->jpeg_quality = DEFAULT_JPEG_QUALITY;
+    priv->encoder_threads = DEFAULT_ENCODER_THREADS;
+    priv->encoder_pool = NULL;
+    g_mutex_init(&priv->encode_lock);
+    g_cond_init(&priv->encode_cond);
+    priv->encode_in_flight = 0;
+    priv->encode_max_in_flight = 0;
+    priv->encode_next_seq = 0;
+    priv->encode_next_log = 0;
+    priv->encode_done = nullptr;
+
+    priv->pack_buffer = nullptr;
+    priv->encoded = nullptr;
+    priv->keyframe_markers = DEFAULT_KEYFRAME_MARKERS;
+    priv->keyframe_path = NULL;
+    priv->reference_dropping = DEFAULT_REFERENCE_DROPPING;
+    priv->non_reference_dropped = 0;
+    priv->gop_dropped = 0;
+    priv->force_key_units = DEFAULT_FORCE_KEY_UNITS;
+    priv->awaiting_key_unit = FALSE;
+    priv->encoded_flushed = FALSE;
+    priv->key_unit_requested = 0;
+    priv->key_unit_count = 0;
+
+    priv->video_encoding = DEFAULT_VIDEO_ENCODING;
+    priv->video_encoder_name = g_strdup(DEFAULT_VIDEO_ENCODER);
+    priv->video_bitrate = DEFAULT_VIDEO_BITRATE;
+    priv->keyframe_interval = DEFAULT_KEYFRAME_INTERVAL;
+    priv->speed_preset = g_strdup(DEFAULT_SPEED_PRESET);
+    priv->video_encoder = NULL;
+    priv->video_plan = NULL;
+    priv->video_caps = NULL;
+    g_mutex_init(&priv->video_time_lock);
+    priv->video_times = new std::deque<RerunFrameTime>();
+    priv->video_index = 0;
+    priv->segment_duration = DEFAULT_SEGMENT_DURATION;
+    priv->offline = DEFAULT_OFFLINE;
+    priv->sync_before_offline = TRUE;
+    priv->stream_path = NULL;
+
+    priv->plan = NULL;
+    priv->caps_generation = 0;
+}
+
+// Callback outputs: hands a chunk of the .rrd byte stream to the application.
+// Runs on the output's own thread.
+static void gst_rerun_sink_emit_rrd_data(const guint8* data, gsize size, gpointer user_data) {
+    GstRerunSink* self = GST_RERUN_SINK(user_data);
+    GBytes* bytes = g_bytes_new(data, size);
+
+    g_signal_emit(self, gst_rerun_sink_signals[SIGNAL_RRD_DATA], 0, bytes);
+    g_bytes_unref(bytes);
+}
+
+// The outputs property, or else the single output output-file, grpc-address
+// and spawn-viewer describe. A file and a custom gRPC address together are
+// both fed at full rate.
+static gboolean gst_rerun_sink_get_outputs(GstRerunSink* self, std::vector<RerunOutput>* outputs, GError** error) {
+    GstRerunSinkPrivate* priv = (GstRerunSinkPrivate*)gst_rerun_sink_get_instance_private(self);
+
+    if (priv->outputs) {
+        return rerun_output_parse(priv->outputs, outputs, error);
+    }
+
+    gboolean has_custom_grpc = (priv->grpc_address &&
+                                g_strcmp0(priv->grpc_address, DEFAULT_GRPC_ADDRESS) != 0);
+
+    if (priv->output_file) {
+        outputs->push_back({ RERUN_OUTPUT_FILE, g_strdup(priv->output_file), -1, 0.0, 0,
+                             (guint64)priv->rotate_size * 1024 * 1024, priv->rotate_duration * GST_SECOND,
+                             priv->max_files, g_strdup(priv->index_file),
+                             { (gsize)priv->write_size * 1024, (guint64)priv->preallocate * 1024 * 1024,
+                               priv->direct_io, priv->sync_interval * GST_SECOND } });
+    }
+    if (has_custom_grpc) {
+        outputs->push_back({ RERUN_OUTPUT_GRPC, g_strdup(priv->grpc_address), -1, 0.0, 0, 0, 0, 0, NULL });
+    }
+    if (outputs->empty() && priv->spawn_viewer) {
+        outputs->push_back({ RERUN_OUTPUT_SPAWN, NULL, -1, 0.0, 0, 0, 0, 0, NULL });
+    }
+
+    return TRUE;
 }
 
 static gboolean gst_rerun_sink_start(GstBaseSink *sink) {
@@ -588,52 +2918,31 @@ static gboolean gst_rerun_sink_start(GstBaseSink *sink) {
 
     if (!priv->rerun_initialized) {
         const char* rec_id = priv->recording_id ? priv->recording_id : "gst-rerun";
-        priv->rec_stream = new rerun::RecordingStream(rec_id);
-
-        // Check for conflicting options
-        gboolean has_output_file = (priv->output_file != NULL);
-        gboolean has_custom_grpc = (priv->grpc_address && 
-                                   g_strcmp0(priv->grpc_address, DEFAULT_GRPC_ADDRESS) != 0);
-        
-        gint options_count = (has_output_file ? 1 : 0) + (has_custom_grpc ? 1 : 0);
-        
-        if (options_count > 1) {
-            GST_ERROR_OBJECT(self, "Conflicting output options: both output-file and custom grpc-address are set. "
-                           "Please use only one output method at a time.");
-            delete priv->rec_stream;
-            priv->rec_stream = nullptr;
+        std::vector<RerunOutput> outputs;
+        GError* error = NULL;
+
+        if (!gst_rerun_sink_get_outputs(self, &outputs, &error)) {
+            GST_ELEMENT_ERROR(self, RESOURCE, SETTINGS, ("Invalid outputs"), ("%s", error->message));
+            g_clear_error(&error);
+            rerun_output_clear(&outputs);
             return FALSE;
         }
-        
-        if (has_output_file) {
-            GST_INFO_OBJECT(self, "Saving to disk: %s", priv->output_file);
-            auto result = priv->rec_stream->save(priv->output_file);
-            if (result.is_err()) {
-                GST_ERROR_OBJECT(self, "Failed to save to disk: %s", priv->output_file);
-                delete priv->rec_stream;
-                priv->rec_stream = nullptr;
-                return FALSE;
-            }
-        } else if (has_custom_grpc) {
-            GST_INFO_OBJECT(self, "Connecting to gRPC at: %s", priv->grpc_address);
-            auto result = priv->rec_stream->connect_grpc(priv->grpc_address);
-            if (result.is_err()) {
-                GST_ERROR_OBJECT(self, "Failed to connect to gRPC: %s", priv->grpc_address);
-                delete priv->rec_stream;
-                priv->rec_stream = nullptr;
-                return FALSE;
-            }
-        } else if (priv->spawn_viewer) {
-            GST_INFO_OBJECT(self, "Spawning Rerun viewer");
-            rerun::Error err = priv->rec_stream->spawn();
-            if (err.is_err()) {
-                GST_ERROR_OBJECT(self, "Error spawning Rerun viewer");
-                return FALSE;
-            }
-        } else {
+
+        if (outputs.empty()) {
             GST_WARNING_OBJECT(self, "No output method enabled: spawn-viewer is false and no output-file or custom grpc-address specified");
             // This is valid - user might just want to create recording without output
         }
+
+        // Sinks with the same recording id and outputs share them
+        priv->output_set = rerun_output_set_acquire(rec_id, outputs, gst_rerun_sink_emit_rrd_data, self, &error);
+        rerun_output_clear(&outputs);
+        if (!priv->output_set) {
+            GST_ELEMENT_ERROR(self, RESOURCE, OPEN_WRITE, ("Failed to open outputs"), ("%s", error->message));
+            g_clear_error(&error);
+            return FALSE;
+        }
+        rerun_output_cursor_reset(&priv->output_cursor);
+
         #ifdef HAVE_NVMM_SUPPORT
             // Initialize CUDA context (required for NVMM handling)
             cudaFree(0);
@@ -643,6 +2952,82 @@ static gboolean gst_rerun_sink_start(GstBaseSink *sink) {
         GST_INFO_OBJECT(self, "Initialized Rerun with recording ID: %s", rec_id);
     }
 
+    gst_rerun_sink_reset_decimation(self);
+
+    // Generation 0 never matches a plan, so the codec is announced again
+    if (!priv->encoded) {
+        priv->encoded = new RerunEncodedState();
+    }
+    gst_rerun_sink_reset_encoded_state(priv->encoded, 0);
+    priv->non_reference_dropped = 0;
+    priv->gop_dropped = 0;
+    g_atomic_int_set(&priv->awaiting_key_unit, FALSE);
+    g_atomic_int_set(&priv->encoded_flushed, FALSE);
+
+    // Raw frames encoded in the sink end up next to where images would go
+    g_free(priv->stream_path);
+    priv->stream_path = g_strdup(priv->video_path);
+    if (!priv->stream_path && priv->video_encoding != RERUN_VIDEO_ENCODING_NONE) {
+        priv->stream_path = g_strdup(priv->image_path);
+    }
+
+    g_free(priv->keyframe_path);
+    priv->keyframe_path = priv->stream_path ? g_strdup_printf("%s/keyframes", priv->stream_path) : NULL;
+
+    g_free(priv->full_res_path);
+    priv->full_res_path = (priv->full_res_every && priv->image_path) ?
+                          g_strdup_printf("%s_full", priv->image_path) : NULL;
+    priv->raw_frames_logged = 0;
+
+    if (priv->image_encoding != RERUN_IMAGE_ENCODING_NONE && !priv->encoder_pool) {
+        if (!rerun_image_encoding_available()) {
+            GST_WARNING_OBJECT(self, "Built without image encoding support, logging raw images");
+        } else {
+            guint threads = priv->encoder_threads ? priv->encoder_threads : g_get_num_processors();
+            GError* error = NULL;
+
+            priv->encoder_pool = g_thread_pool_new(gst_rerun_sink_encode_job, self, threads, FALSE, &error);
+            if (!priv->encoder_pool) {
+                GST_ERROR_OBJECT(self, "Failed to start encoder threads: %s", error->message);
+                g_error_free(error);
+                return FALSE;
+            }
+
+            // Enough to keep every thread busy while the next frames queue up
+            priv->encode_max_in_flight = threads * 2;
+            priv->encode_in_flight = 0;
+            priv->encode_next_seq = 0;
+            priv->encode_next_log = 0;
+            priv->encode_done = new std::map<guint64, RerunEncodeJob*>();
+            GST_INFO_OBJECT(self, "Encoding images on %u threads", threads);
+        }
+    }
+
+    if (priv->video_encoding != RERUN_VIDEO_ENCODING_NONE && !priv->video_encoder) {
+        RerunVideoEncoderConfig config = {
+            priv->video_encoder_name, priv->video_bitrate, priv->keyframe_interval, priv->speed_preset
+        };
+        GError* error = NULL;
+
+        priv->video_encoder = rerun_video_encoder_new(&config, gst_rerun_sink_log_encoded_output, self, &error);
+        if (!priv->video_encoder) {
+            GST_ELEMENT_ERROR(self, LIBRARY, INIT, ("Failed to start video encoder %s", priv->video_encoder_name),
+                              ("%s", error ? error->message : "unknown error"));
+            g_clear_error(&error);
+            return FALSE;
+        }
+    }
+
+    if (priv->async_logging && !priv->worker) {
+        // Nothing is late when transcoding, so frames are never worth losing
+        RerunQueuePolicy policy = priv->offline ? RERUN_QUEUE_POLICY_BLOCK : priv->queue_policy;
+
+        GST_INFO_OBJECT(self, "Logging asynchronously, queue-depth: %u", priv->queue_depth);
+        priv->worker_flow = GST_FLOW_OK;
+        priv->worker = rerun_log_worker_new("rerunsink-log", priv->queue_depth, policy,
+                                            gst_rerun_sink_process_job, gst_rerun_sink_release_job, self);
+    }
+
     return TRUE;
 }
 
@@ -650,13 +3035,74 @@ static gboolean gst_rerun_sink_stop(GstBaseSink *sink) {
     GstRerunSink *self = GST_RERUN_SINK(sink);
     GstRerunSinkPrivate *priv = (GstRerunSinkPrivate *)gst_rerun_sink_get_instance_private(self);
 
-    if (priv->rec_stream) {
-        delete priv->rec_stream;
-        priv->rec_stream = nullptr;
+    // Logs whatever is still queued before the stream goes away
+    if (priv->worker) {
+        GST_INFO_OBJECT(self, "Stopping logging worker, %" G_GUINT64_FORMAT " frames dropped",
+                        rerun_log_worker_get_dropped(priv->worker));
+
+        // The stats property may be reading the worker
+        GST_OBJECT_LOCK(self);
+        RerunLogWorker* worker = priv->worker;
+        priv->worker = NULL;
+        GST_OBJECT_UNLOCK(self);
+
+        rerun_log_worker_free(worker);
+    }
+
+    // Frames still inside the encoder are lost on a stop without EOS
+    if (priv->video_encoder) {
+        rerun_video_encoder_free(priv->video_encoder);
+        priv->video_encoder = NULL;
+    }
+    priv->video_times->clear();
+    priv->video_index = 0;
+    if (priv->video_plan) {
+        rerun_render_plan_unref(priv->video_plan);
+        priv->video_plan = NULL;
+    }
+    gst_caps_replace(&priv->video_caps, NULL);
+
+    if (priv->non_reference_dropped || priv->gop_dropped) {
+        GST_INFO_OBJECT(self, "Shed %" G_GUINT64_FORMAT " non-reference and %" G_GUINT64_FORMAT
+                        " GOP tail access units", priv->non_reference_dropped, priv->gop_dropped);
+    }
+
+    // Waits for queued frames, which are logged before the pool goes away
+    if (priv->encoder_pool) {
+        g_thread_pool_free(priv->encoder_pool, FALSE, TRUE);
+        priv->encoder_pool = NULL;
+        delete priv->encode_done;
+        priv->encode_done = nullptr;
+    }
+
+    if (priv->frames_skipped) {
+        GST_INFO_OBJECT(self, "Skipped %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " frames",
+                        priv->frames_skipped, priv->frames_seen);
+    }
+
+    if (priv->output_set) {
+        rerun_output_set_release(priv->output_set);
+        priv->output_set = NULL;
         priv->rerun_initialized = FALSE;
         GST_INFO_OBJECT(self, "Stopped Rerun recording");
     }
 
+    delete priv->pack_buffer;
+    priv->pack_buffer = nullptr;
+    if (priv->encoded && priv->encoded->samples) {
+        GST_INFO_OBJECT(self, "Logged %" G_GUINT64_FORMAT " samples, %" G_GUINT64_FORMAT " keyframes",
+                        priv->encoded->samples, priv->encoded->keyframes);
+    }
+    delete priv->encoded;
+    priv->encoded = nullptr;
+    g_clear_pointer(&priv->keyframe_path, g_free);
+    g_clear_pointer(&priv->stream_path, g_free);
+    delete priv->scale_buffer;
+    priv->scale_buffer = nullptr;
+    g_clear_pointer(&priv->full_res_path, g_free);
+
+    gst_rerun_sink_set_plan(self, NULL);
+
     return TRUE;
 }
 
@@ -668,10 +3114,28 @@ static void gst_rerun_sink_dispose(GObject *object) {
     g_clear_pointer(&priv->image_path, g_free);
     g_clear_pointer(&priv->output_file, g_free);
     g_clear_pointer(&priv->grpc_address, g_free);
+    g_clear_pointer(&priv->outputs, g_free);
+    g_clear_pointer(&priv->index_file, g_free);
+
+    gst_rerun_sink_set_plan(self, NULL);
 
     G_OBJECT_CLASS(gst_rerun_sink_parent_class)->dispose(object);
 }
 
+static void gst_rerun_sink_finalize(GObject *object) {
+    GstRerunSink *self = GST_RERUN_SINK(object);
+    GstRerunSinkPrivate *priv = (GstRerunSinkPrivate *)gst_rerun_sink_get_instance_private(self);
+
+    g_mutex_clear(&priv->encode_lock);
+    g_cond_clear(&priv->encode_cond);
+    g_mutex_clear(&priv->video_time_lock);
+    delete priv->video_times;
+    g_free(priv->video_encoder_name);
+    g_free(priv->speed_preset);
+
+    G_OBJECT_CLASS(gst_rerun_sink_parent_class)->finalize(object);
+}
+
 static gboolean plugin_init(GstPlugin *plugin) {
     GST_DEBUG_CATEGORY_INIT(gst_rerun_sink_debug, "rerunsink", 0, "Rerun sink");
     
@@ -692,10 +3156,12 @@ static void gst_rerun_sink_class_init(GstRerunSinkClass *klass) {
     gobject_class->set_property = gst_rerun_sink_set_property;
     gobject_class->get_property = gst_rerun_sink_get_property;
     gobject_class->dispose = gst_rerun_sink_dispose;
+    gobject_class->finalize = gst_rerun_sink_finalize;
 
     g_object_class_install_property(gobject_class, PROP_RECORDING_ID,
         g_param_spec_string("recording-id", "Recording ID",
-                            "Rerun recording/session identifier",
+                            "Rerun recording/session identifier. Sinks with the same identifier and "
+                            "outputs share a single recording stream",
                             DEFAULT_RECORDING_ID,
                             (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
                         
@@ -729,10 +3195,232 @@ static void gst_rerun_sink_class_init(GstRerunSinkClass *klass) {
                             DEFAULT_GRPC_ADDRESS,
                             (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+    g_object_class_install_property(gobject_class, PROP_HUGE_PAGES,
+        g_param_spec_boolean("huge-pages", "Huge Pages",
+                             "Back the buffer pool proposed to upstream with transparent huge pages",
+                             DEFAULT_HUGE_PAGES,
+                             (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_ASYNC_LOGGING,
+        g_param_spec_boolean("async-logging", "Async Logging",
+                             "Log frames from a worker thread so the streaming thread only queues them",
+                             DEFAULT_ASYNC_LOGGING,
+                             (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_QUEUE_DEPTH,
+        g_param_spec_uint("queue-depth", "Queue Depth",
+                          "Frames the asynchronous logging queue can hold",
+                          1, 1024, DEFAULT_QUEUE_DEPTH,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_QUEUE_POLICY,
+        g_param_spec_enum("queue-policy", "Queue Policy",
+                          "What to do when the asynchronous logging queue is full",
+                          GST_TYPE_RERUN_SINK_QUEUE_POLICY, DEFAULT_QUEUE_POLICY,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_MAX_FPS,
+        g_param_spec_double("max-fps", "Max FPS",
+                            "Maximum rate at which frames are logged, based on buffer timestamps (0 = unlimited)",
+                            0.0, G_MAXDOUBLE, DEFAULT_MAX_FPS,
+                            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_KEEP_EVERY,
+        g_param_spec_uint("keep-every", "Keep Every",
+                          "Log only one frame out of every N (1 = all frames)",
+                          1, G_MAXUINT, DEFAULT_KEEP_EVERY,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_SCALE_FACTOR,
+        g_param_spec_uint("scale-factor", "Scale Factor",
+                          "Downscale raw frames by this factor (1, 2 or 4, other values are refused) "
+                          "before logging",
+                          1, RERUN_SCALER_MAX_FACTOR, DEFAULT_SCALE_FACTOR,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_TARGET_SIZE,
+        g_param_spec_uint("target-size", "Target Size",
+                          "Pick the largest scale factor that keeps the longest side at least this many pixels "
+                          "(0 = use scale-factor)",
+                          0, G_MAXUINT, DEFAULT_TARGET_SIZE,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_FULL_RES_EVERY,
+        g_param_spec_uint("full-res-every", "Full Resolution Every",
+                          "When downscaling, also log every Nth frame at full resolution to '<image-path>_full' "
+                          "(0 = never)",
+                          0, G_MAXUINT, DEFAULT_FULL_RES_EVERY,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_IMAGE_ENCODING,
+        g_param_spec_enum("image-encoding", "Image Encoding",
+                          "Compress raw frames before logging them (requires WITH_IMAGE_ENCODING)",
+                          GST_TYPE_RERUN_SINK_IMAGE_ENCODING, DEFAULT_IMAGE_ENCODING,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_JPEG_QUALITY,
+        g_param_spec_int("jpeg-quality", "JPEG Quality",
+                         "Quality of JPEG encoded images",
+                         1, 100, DEFAULT_JPEG_QUALITY,
+                         (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_ENCODER_THREADS,
+        g_param_spec_uint("encoder-threads", "Encoder Threads",
+                          "Threads compressing frames in parallel (0 = one per CPU)",
+                          0, 64, DEFAULT_ENCODER_THREADS,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_KEYFRAME_MARKERS,
+        g_param_spec_boolean("keyframe-markers", "Keyframe Markers",
+                             "Log a marker under <video-path>/keyframes for every keyframe and "
+                             "index encoded samples on a video_sample timeline",
+                             DEFAULT_KEYFRAME_MARKERS,
+                             (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_REFERENCE_DROPPING,
+        g_param_spec_boolean("reference-dropping", "Reference Dropping",
+                             "With async-logging, shed H.264 non-reference frames and then GOP tails "
+                             "when the queue backs up, resuming at the next IDR",
+                             DEFAULT_REFERENCE_DROPPING,
+                             (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_FORCE_KEY_UNITS,
+        g_param_spec_boolean("force-key-units", "Force Key Units",
+                             "Ask upstream for a keyframe when encoded logging starts or resumes "
+                             "instead of waiting for the next one",
+                             DEFAULT_FORCE_KEY_UNITS,
+                             (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_VIDEO_ENCODING,
+        g_param_spec_enum("video-encoding", "Video Encoding",
+                          "Encode raw frames to a video stream inside the sink",
+                          GST_TYPE_RERUN_SINK_VIDEO_ENCODING, DEFAULT_VIDEO_ENCODING,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_VIDEO_ENCODER,
+        g_param_spec_string("video-encoder", "Video Encoder",
+                            "H.264 encoder element used with video-encoding",
+                            DEFAULT_VIDEO_ENCODER,
+                            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_VIDEO_BITRATE,
+        g_param_spec_uint("video-bitrate", "Video Bitrate",
+                          "Bitrate of the internal encoder in kbit/s",
+                          1, G_MAXINT / 1000, DEFAULT_VIDEO_BITRATE,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_KEYFRAME_INTERVAL,
+        g_param_spec_uint("keyframe-interval", "Keyframe Interval",
+                          "Frames between keyframes of the internal encoder (0 = encoder default)",
+                          0, G_MAXINT, DEFAULT_KEYFRAME_INTERVAL,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_SPEED_PRESET,
+        g_param_spec_string("speed-preset", "Speed Preset",
+                            "Speed preset of the internal encoder",
+                            DEFAULT_SPEED_PRESET,
+                            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_SEGMENT_DURATION,
+        g_param_spec_uint("segment-duration", "Segment Duration",
+                          "Log encoded video as keyframe-aligned MP4 segments of at least this many "
+                          "seconds with a frame reference per frame (0 = H.264 per sample, H.265 per GOP)",
+                          0, G_MAXINT, DEFAULT_SEGMENT_DURATION,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_OFFLINE,
+        g_param_spec_boolean("offline", "Offline",
+                             "Log buffers as fast as they arrive instead of in real time, and block "
+                             "instead of dropping when the logging queue is full",
+                             DEFAULT_OFFLINE,
+                             (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_OUTPUTS,
+        g_param_spec_string("outputs", "Outputs",
+                            "Outputs of the recording, separated by ';', each with optional "
+                            "max-fps, keep-every and policy=drop|block (e.g. 'file, location=out.rrd, "
+                            "policy=block; grpc, url=rerun+http://host:9876/proxy, max-fps=5; spawn'). "
+                            "Frames for a policy=block output are never dropped by queue-policy. "
+                            "Outputs with the same rate share one stream; each distinct rate gets its "
+                            "own, which encodes and sends its own copy of the frames they share. "
+                            "stdout, 'fd, fd=N' and callback (the rrd-data signal) receive the .rrd byte stream. "
+                            "Overrides output-file, grpc-address and spawn-viewer",
+                            DEFAULT_OUTPUTS,
+                            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_ROTATE_SIZE,
+        g_param_spec_uint("rotate-size", "Rotate Size",
+                          "Start a new output-file once the current one reaches this many MiB, taking "
+                          "output-file as a strftime template (0 = never)",
+                          0, G_MAXUINT, DEFAULT_ROTATE_SIZE,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_ROTATE_DURATION,
+        g_param_spec_uint("rotate-duration", "Rotate Duration",
+                          "Start a new output-file once the current one spans this many seconds, taking "
+                          "output-file as a strftime template (0 = never)",
+                          0, G_MAXUINT, DEFAULT_ROTATE_DURATION,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_MAX_FILES,
+        g_param_spec_uint("max-files", "Max Files",
+                          "Rotated output files kept, the oldest are deleted first (0 = all)",
+                          0, G_MAXUINT, DEFAULT_MAX_FILES,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_INDEX_FILE,
+        g_param_spec_string("index-file", "Index File",
+                            "JSON manifest mapping running time ranges to the rotated output files",
+                            DEFAULT_INDEX_FILE,
+                            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    // Setting any of these writes output-file through the sink's disk writer
+    g_object_class_install_property(gobject_class, PROP_WRITE_SIZE,
+        g_param_spec_uint("write-size", "Write Size",
+                          "KiB output-file is written in at a time, rounded up to 4 KiB blocks "
+                          "(0 = 1 MiB when the disk writer is used)",
+                          0, G_MAXUINT / 1024, DEFAULT_WRITE_SIZE,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_PREALLOCATE,
+        g_param_spec_uint("preallocate", "Preallocate",
+                          "MiB of disk space reserved at a time ahead of output-file's writes (0 = none)",
+                          0, G_MAXUINT, DEFAULT_PREALLOCATE,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_DIRECT_IO,
+        g_param_spec_boolean("direct-io", "Direct I/O",
+                             "Write output-file with O_DIRECT, bypassing the page cache",
+                             DEFAULT_DIRECT_IO,
+                             (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_SYNC_INTERVAL,
+        g_param_spec_uint("sync-interval", "Sync Interval",
+                          "Seconds between syncs of output-file to disk (0 = leave it to the kernel)",
+                          0, G_MAXUINT, DEFAULT_SYNC_INTERVAL,
+                          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_STATS,
+        g_param_spec_boxed("stats", "Statistics",
+                           "Counters of frames seen, skipped and dropped",
+                           GST_TYPE_STRUCTURE,
+                           (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+    // Chunks of the .rrd byte stream for callback outputs, as a GBytes.
+    // Emitted from a thread of the sink's own while the recording is
+    // written; the last one arrives before stop() returns.
+    gst_rerun_sink_signals[SIGNAL_RRD_DATA] =
+        g_signal_new("rrd-data", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                     G_TYPE_NONE, 1, G_TYPE_BYTES);
+
     basesink_class->start = GST_DEBUG_FUNCPTR(gst_rerun_sink_start);
     basesink_class->stop = GST_DEBUG_FUNCPTR(gst_rerun_sink_stop);
     basesink_class->render = GST_DEBUG_FUNCPTR(gst_rerun_sink_render);
     basesink_class->set_caps = GST_DEBUG_FUNCPTR(gst_rerun_sink_set_caps);
+    basesink_class->propose_allocation = GST_DEBUG_FUNCPTR(gst_rerun_sink_propose_allocation);
+    basesink_class->event = GST_DEBUG_FUNCPTR(gst_rerun_sink_event);
+    basesink_class->unlock = GST_DEBUG_FUNCPTR(gst_rerun_sink_unlock);
+    basesink_class->unlock_stop = GST_DEBUG_FUNCPTR(gst_rerun_sink_unlock_stop);
 
     gst_element_class_add_pad_template(element_class,
         gst_pad_template_new("sink", GST_PAD_SINK, GST_PAD_ALWAYS, gst_caps_from_string(RERUN_SINK_CAPS)));
@@ -0,0 +1,123 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __RERUN_BOUNDED_QUEUE_H__
+#define __RERUN_BOUNDED_QUEUE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Lock-free bounded multi-producer/multi-consumer queue (Vyukov). Every cell
+// carries a sequence number telling producers and consumers whose turn it
+// is, so neither side ever takes a lock. The sink pushes from the streaming
+// thread and pops from the logging worker; the streaming thread may also pop
+// to discard the oldest entry when the queue is full.
+template <typename T>
+class RerunBoundedQueue {
+  public:
+    explicit RerunBoundedQueue(size_t capacity)
+        : capacity_(capacity ? capacity : 1), cells_(new Cell[capacity_]) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueue_pos_.store(0, std::memory_order_relaxed);
+        dequeue_pos_.store(0, std::memory_order_relaxed);
+    }
+
+    RerunBoundedQueue(const RerunBoundedQueue&) = delete;
+    RerunBoundedQueue& operator=(const RerunBoundedQueue&) = delete;
+
+    bool try_push(const T& value) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        for (;;) {
+            cell = &cells_[pos % capacity_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Full
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        for (;;) {
+            cell = &cells_[pos % capacity_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Empty
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = cell->data;
+        cell->sequence.store(pos + capacity_, std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot: concurrent pushes and pops may change it right away
+    size_t size_approx() const {
+        size_t enqueued = enqueue_pos_.load(std::memory_order_acquire);
+        size_t dequeued = dequeue_pos_.load(std::memory_order_acquire);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    size_t capacity() const { return capacity_; }
+
+  private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static constexpr size_t kCacheLine = 64;
+
+    const size_t capacity_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(kCacheLine) std::atomic<size_t> enqueue_pos_;
+    alignas(kCacheLine) std::atomic<size_t> dequeue_pos_;
+};
+
+#endif // __RERUN_BOUNDED_QUEUE_H__
@@ -0,0 +1,303 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include "rerundiskwriter.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <deque>
+
+GST_DEBUG_CATEGORY_STATIC(rerun_disk_writer_debug);
+#define GST_CAT_DEFAULT rerun_disk_writer_debug
+
+// Block size O_DIRECT needs buffers, offsets and lengths aligned to. 4 KiB
+// covers disks with 512 byte and 4 KiB sectors alike.
+#define ALIGNMENT 4096
+
+#define DEFAULT_WRITE_SIZE (1024 * 1024)
+
+// Batches that may wait for the disk at once. When they all do, the pipe
+// feeding the writer fills up and holds up Rerun's own file writer, never
+// the thread logging.
+#define N_BUFFERS 8
+
+typedef struct {
+  guint8* data;
+  gsize size;
+} RerunDiskBatch;
+
+struct _RerunDiskWriter {
+  gchar* path;
+  gint fd;
+  gboolean direct;
+  gsize write_size;
+  guint64 preallocate;
+  gint64 sync_interval;       // Microseconds
+
+  // Only touched by the thread handing data over
+  RerunDiskBatch filling;
+  guint64 received;
+
+  // Only touched by the writer's thread
+  guint64 offset;             // Includes the padding of a last O_DIRECT block
+  guint64 allocated;          // End of the preallocated space
+  gint64 next_sync;
+  gboolean failed;
+
+  GMutex lock;
+  GCond cond;
+  std::deque<guint8*> free_buffers;
+  std::deque<RerunDiskBatch> pending;
+  gboolean closing;
+
+  GThread* thread;
+};
+
+static void rerun_disk_writer_init_debug(void) {
+    static gsize initialized = 0;
+
+    if (g_once_init_enter(&initialized)) {
+        GST_DEBUG_CATEGORY_INIT(rerun_disk_writer_debug, "rerundiskwriter", 0, "Rerun sink disk writer");
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
+gboolean rerun_disk_writer_options_enabled(const RerunDiskWriterOptions* options) {
+    return options->write_size || options->preallocate || options->direct || options->sync_interval;
+}
+
+// Reserved past the end of the file, so a reader or a crash never sees the
+// reserved space as zeros in the recording
+static void rerun_disk_writer_preallocate(RerunDiskWriter* writer, guint64 end) {
+#ifdef FALLOC_FL_KEEP_SIZE
+    while (writer->preallocate && end > writer->allocated) {
+        if (fallocate(writer->fd, FALLOC_FL_KEEP_SIZE, writer->allocated, writer->preallocate) != 0) {
+            GST_WARNING("Failed to preallocate %s, writing without: %s", writer->path, g_strerror(errno));
+            writer->preallocate = 0;
+        } else {
+            writer->allocated += writer->preallocate;
+        }
+    }
+#endif
+}
+
+static void rerun_disk_writer_write_batch(RerunDiskWriter* writer, RerunDiskBatch* batch) {
+    gsize size = batch->size;
+
+    // Only the last batch is ever short. O_DIRECT still writes it as whole
+    // blocks, and the file is cut back to its real size when closed.
+    if (writer->direct && size % ALIGNMENT) {
+        gsize padded = GST_ROUND_UP_N(size, ALIGNMENT);
+        memset(batch->data + size, 0, padded - size);
+        size = padded;
+    }
+
+    rerun_disk_writer_preallocate(writer, writer->offset + size);
+
+    const guint8* data = batch->data;
+    while (size > 0 && !writer->failed) {
+        gssize written = pwrite(writer->fd, data, size, writer->offset);
+
+        if (written >= 0) {
+            data += written;
+            size -= written;
+            writer->offset += written;
+        } else if (errno != EINTR) {
+            GST_WARNING("Failed to write %s, dropping the rest of the stream: %s", writer->path, g_strerror(errno));
+            writer->failed = TRUE;
+        }
+    }
+
+    gint64 now = g_get_monotonic_time();
+    if (writer->sync_interval && !writer->failed && now >= writer->next_sync) {
+        if (fdatasync(writer->fd) != 0) {
+            GST_WARNING("Failed to sync %s: %s", writer->path, g_strerror(errno));
+        }
+        writer->next_sync = now + writer->sync_interval;
+    }
+}
+
+static gpointer rerun_disk_writer_loop(gpointer data) {
+    RerunDiskWriter* writer = (RerunDiskWriter*)data;
+
+    g_mutex_lock(&writer->lock);
+    for (;;) {
+        while (writer->pending.empty() && !writer->closing) {
+            g_cond_wait(&writer->cond, &writer->lock);
+        }
+        if (writer->pending.empty()) {
+            break;
+        }
+
+        RerunDiskBatch batch = writer->pending.front();
+        g_mutex_unlock(&writer->lock);
+
+        rerun_disk_writer_write_batch(writer, &batch);
+
+        g_mutex_lock(&writer->lock);
+        writer->pending.pop_front();
+        writer->free_buffers.push_back(batch.data);
+        g_cond_broadcast(&writer->cond);
+    }
+    g_mutex_unlock(&writer->lock);
+
+    return NULL;
+}
+
+RerunDiskWriter* rerun_disk_writer_new(const gchar* path, const RerunDiskWriterOptions* options, GError** error) {
+    rerun_disk_writer_init_debug();
+
+    gint flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    gboolean direct = FALSE;
+    gint fd = -1;
+
+    if (options->direct) {
+#ifdef O_DIRECT
+        fd = open(path, flags | O_DIRECT, 0666);
+        direct = fd >= 0;
+
+        // tmpfs and some network file systems refuse it
+        if (fd < 0 && errno == EINVAL) {
+            GST_WARNING("%s does not support O_DIRECT, writing through the page cache", path);
+        }
+#else
+        GST_WARNING("O_DIRECT is not available, writing %s through the page cache", path);
+#endif
+    }
+
+    if (fd < 0) {
+        fd = open(path, flags, 0666);
+    }
+
+    if (fd < 0) {
+        g_set_error(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_OPEN_WRITE, "Failed to open %s: %s", path,
+                    g_strerror(errno));
+        return NULL;
+    }
+
+    RerunDiskWriter* writer = new RerunDiskWriter();
+    writer->path = g_strdup(path);
+    writer->fd = fd;
+    writer->direct = direct;
+    writer->write_size = GST_ROUND_UP_N(options->write_size ? options->write_size : DEFAULT_WRITE_SIZE, ALIGNMENT);
+    writer->preallocate = options->preallocate;
+    writer->sync_interval = options->sync_interval / GST_USECOND;
+    writer->filling = { NULL, 0 };
+    writer->received = 0;
+    writer->offset = 0;
+    writer->allocated = 0;
+    writer->next_sync = g_get_monotonic_time() + writer->sync_interval;
+    writer->failed = FALSE;
+    writer->closing = FALSE;
+
+    for (guint i = 0; i < N_BUFFERS; i++) {
+        void* buffer = NULL;
+        if (posix_memalign(&buffer, ALIGNMENT, writer->write_size) != 0) {
+            g_error("Failed to allocate %" G_GSIZE_FORMAT " bytes", writer->write_size);
+        }
+        writer->free_buffers.push_back((guint8*)buffer);
+    }
+
+    g_mutex_init(&writer->lock);
+    g_cond_init(&writer->cond);
+    writer->thread = g_thread_new("rerunsink-disk", rerun_disk_writer_loop, writer);
+
+    GST_INFO("Writing %s in %" G_GSIZE_FORMAT " byte batches%s, preallocating %" G_GUINT64_FORMAT " bytes",
+             path, writer->write_size, direct ? " with O_DIRECT" : "", writer->preallocate);
+
+    return writer;
+}
+
+static void rerun_disk_writer_submit(RerunDiskWriter* writer) {
+    g_mutex_lock(&writer->lock);
+    writer->pending.push_back(writer->filling);
+    writer->filling = { NULL, 0 };
+    g_cond_broadcast(&writer->cond);
+    g_mutex_unlock(&writer->lock);
+}
+
+void rerun_disk_writer_write(const guint8* data, gsize size, gpointer user_data) {
+    RerunDiskWriter* writer = (RerunDiskWriter*)user_data;
+
+    while (size > 0) {
+        if (!writer->filling.data) {
+            g_mutex_lock(&writer->lock);
+            while (writer->free_buffers.empty()) {
+                g_cond_wait(&writer->cond, &writer->lock);
+            }
+            writer->filling = { writer->free_buffers.front(), 0 };
+            writer->free_buffers.pop_front();
+            g_mutex_unlock(&writer->lock);
+        }
+
+        gsize chunk = MIN(size, writer->write_size - writer->filling.size);
+        memcpy(writer->filling.data + writer->filling.size, data, chunk);
+        writer->filling.size += chunk;
+        writer->received += chunk;
+        data += chunk;
+        size -= chunk;
+
+        if (writer->filling.size == writer->write_size) {
+            rerun_disk_writer_submit(writer);
+        }
+    }
+}
+
+void rerun_disk_writer_free(RerunDiskWriter* writer) {
+    if (writer->filling.data) {
+        rerun_disk_writer_submit(writer);
+    }
+
+    g_mutex_lock(&writer->lock);
+    writer->closing = TRUE;
+    g_cond_broadcast(&writer->cond);
+    g_mutex_unlock(&writer->lock);
+    g_thread_join(writer->thread);
+
+    // Drops the padding of the last block and hands back preallocated space
+    // past the end
+    guint64 end = MIN(writer->offset, writer->received);
+    if ((writer->offset != end || writer->allocated > end) && ftruncate(writer->fd, end) != 0) {
+        GST_WARNING("Failed to truncate %s: %s", writer->path, g_strerror(errno));
+    }
+
+    if (writer->sync_interval && !writer->failed && fdatasync(writer->fd) != 0) {
+        GST_WARNING("Failed to sync %s: %s", writer->path, g_strerror(errno));
+    }
+
+    if (close(writer->fd) != 0) {
+        GST_WARNING("Failed to close %s: %s", writer->path, g_strerror(errno));
+    }
+
+    for (guint8* buffer : writer->free_buffers) {
+        free(buffer);
+    }
+
+    g_mutex_clear(&writer->lock);
+    g_cond_clear(&writer->cond);
+    g_free(writer->path);
+    delete writer;
+}
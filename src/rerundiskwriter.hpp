@@ -0,0 +1,56 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef __RERUN_DISK_WRITER_H__
+#define __RERUN_DISK_WRITER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct {
+  gsize write_size;           // Bytes per write, rounded up to whole blocks, 0 = 1 MiB
+  guint64 preallocate;        // Disk space reserved ahead of the writes at a time, 0 = none
+  gboolean direct;            // Bypass the page cache with O_DIRECT
+  GstClockTime sync_interval; // Time between fdatasync() calls, 0 = leave it to the kernel
+} RerunDiskWriterOptions;
+
+typedef struct _RerunDiskWriter RerunDiskWriter;
+
+// Whether any option asks for the writer instead of a plain file
+gboolean rerun_disk_writer_options_enabled(const RerunDiskWriterOptions* options);
+
+// Writes a byte stream to @path from a thread of its own, in batches of
+// write_size bytes. Batches are aligned to the file system block size, so
+// O_DIRECT and the page cache both see whole blocks. Truncates @path.
+RerunDiskWriter* rerun_disk_writer_new(const gchar* path, const RerunDiskWriterOptions* options, GError** error);
+
+// RerunPipeFunc queuing @data on the writer in @user_data. Only waits when
+// every batch is queued for the disk already.
+void rerun_disk_writer_write(const guint8* data, gsize size, gpointer user_data);
+
+// Writes what is left, gives back unused preallocated space and closes
+void rerun_disk_writer_free(RerunDiskWriter* writer);
+
+G_END_DECLS
+
+#endif // __RERUN_DISK_WRITER_H__
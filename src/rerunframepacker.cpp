@@ -0,0 +1,128 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rerunframepacker.hpp"
+#include "rerunswizzle.hpp"
+
+#include <cstring>
+
+void rerun_plane_layout_init(RerunPlaneLayout* layout, const GstVideoInfo* info) {
+    memset(layout, 0, sizeof(*layout));
+    layout->n_planes = GST_VIDEO_INFO_N_PLANES(info);
+
+    for (guint plane = 0; plane < layout->n_planes; ++plane) {
+        // The first component stored in a plane gives its geometry
+        for (guint comp = 0; comp < GST_VIDEO_INFO_N_COMPONENTS(info); ++comp) {
+            if (GST_VIDEO_INFO_COMP_PLANE(info, comp) != (gint)plane) {
+                continue;
+            }
+            layout->row_bytes[plane] = (gsize)GST_VIDEO_INFO_COMP_WIDTH(info, comp) *
+                                       GST_VIDEO_INFO_COMP_PSTRIDE(info, comp);
+            layout->rows[plane] = GST_VIDEO_INFO_COMP_HEIGHT(info, comp);
+            break;
+        }
+
+        layout->offset[plane] = layout->size;
+        layout->size += layout->row_bytes[plane] * layout->rows[plane];
+    }
+}
+
+gboolean rerun_frame_is_packed(const GstVideoFrame* frame, const RerunPlaneLayout* layout) {
+    const guint8* base = (const guint8*)GST_VIDEO_FRAME_PLANE_DATA(frame, 0);
+
+    for (guint plane = 0; plane < layout->n_planes; ++plane) {
+        if (layout->row_op[plane] != RERUN_ROW_COPY) {
+            return FALSE;
+        }
+
+        // A single row has no padding to drop, whatever the stride says
+        if (layout->rows[plane] > 1 &&
+            (gsize)GST_VIDEO_FRAME_PLANE_STRIDE(frame, plane) != layout->row_bytes[plane]) {
+            return FALSE;
+        }
+        if ((const guint8*)GST_VIDEO_FRAME_PLANE_DATA(frame, plane) != base + layout->offset[plane]) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+void rerun_copy_rows(guint8* dest, gsize dest_stride,
+                     const guint8* src, gsize src_stride,
+                     gsize row_bytes, guint rows) {
+    // Contiguous on both sides: one large copy lets memcpy use its widest path
+    if (dest_stride == row_bytes && src_stride == row_bytes) {
+        memcpy(dest, src, row_bytes * rows);
+        return;
+    }
+
+    for (guint row = 0; row < rows; ++row) {
+        memcpy(dest, src, row_bytes);
+        dest += dest_stride;
+        src += src_stride;
+    }
+}
+
+void rerun_swap_pair_rows(guint8* dest, gsize dest_stride,
+                          const guint8* src, gsize src_stride,
+                          gsize row_bytes, guint rows) {
+    for (guint row = 0; row < rows; ++row) {
+        // Plain byte loop, which compilers turn into vector shuffles
+        for (gsize i = 0; i + 1 < row_bytes; i += 2) {
+            dest[i] = src[i + 1];
+            dest[i + 1] = src[i];
+        }
+        dest += dest_stride;
+        src += src_stride;
+    }
+}
+
+void rerun_frame_pack(const GstVideoFrame* frame, const RerunPlaneLayout* layout, guint8* dest) {
+    for (guint plane = 0; plane < layout->n_planes; ++plane) {
+        guint8* plane_dest = dest + layout->offset[plane];
+        const guint8* src = (const guint8*)GST_VIDEO_FRAME_PLANE_DATA(frame, plane);
+        gsize src_stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, plane);
+
+        switch (layout->row_op[plane]) {
+            case RERUN_ROW_SWAP_PAIRS:
+                rerun_swap_pair_rows(plane_dest, layout->row_bytes[plane], src, src_stride,
+                                     layout->row_bytes[plane], layout->rows[plane]);
+                break;
+
+            // Reordering happens on the copy the frame gets anyway, so it
+            // costs no extra pass over memory
+            case RERUN_ROW_SWIZZLE_RGB:
+            case RERUN_ROW_SWIZZLE_RGBA: {
+                guint channels = layout->row_op[plane] == RERUN_ROW_SWIZZLE_RGB ? 3 : 4;
+                rerun_swizzle_rows(plane_dest, layout->row_bytes[plane], src, src_stride,
+                                   layout->row_bytes[plane] / channels, layout->rows[plane],
+                                   layout->swizzle, channels);
+                break;
+            }
+
+            case RERUN_ROW_COPY:
+            default:
+                rerun_copy_rows(plane_dest, layout->row_bytes[plane], src, src_stride,
+                                layout->row_bytes[plane], layout->rows[plane]);
+                break;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RERUN_FRAME_PACKER_H__
+#define __RERUN_FRAME_PACKER_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+// How a plane's rows are transformed while packing, for layouts Rerun only
+// understands in a different byte order
+typedef enum {
+    RERUN_ROW_COPY,             // Already in Rerun's byte order
+    RERUN_ROW_SWAP_PAIRS,       // Swap the bytes of every pair (UYVY to YUY2, NV21 to NV12 chroma)
+    RERUN_ROW_SWIZZLE_RGB,      // 4-byte pixels reordered into RGB, see RerunPlaneLayout.swizzle
+    RERUN_ROW_SWIZZLE_RGBA,     // 4-byte pixels reordered into RGBA
+} RerunRowOp;
+
+// Tightly packed layout Rerun expects for a raw frame: planes back to back,
+// rows without any padding.
+typedef struct {
+    guint n_planes;
+    gsize row_bytes[GST_VIDEO_MAX_PLANES];
+    guint rows[GST_VIDEO_MAX_PLANES];
+    gsize offset[GST_VIDEO_MAX_PLANES];
+    RerunRowOp row_op[GST_VIDEO_MAX_PLANES];  // RERUN_ROW_COPY after init
+    guint8 swizzle[4];          // Source byte for each output channel of a swizzle
+    gsize size;
+} RerunPlaneLayout;
+
+void rerun_plane_layout_init(RerunPlaneLayout* layout, const GstVideoInfo* info);
+
+// TRUE if the mapped frame already matches @layout, so its memory can be
+// handed to Rerun as-is. Never the case when a plane needs a row transform.
+gboolean rerun_frame_is_packed(const GstVideoFrame* frame, const RerunPlaneLayout* layout);
+
+// Copies every plane of @frame into @dest (at least layout->size bytes),
+// dropping the stride padding and plane offsets of the source and applying
+// the row transform of each plane.
+void rerun_frame_pack(const GstVideoFrame* frame, const RerunPlaneLayout* layout, guint8* dest);
+
+void rerun_copy_rows(guint8* dest, gsize dest_stride,
+                     const guint8* src, gsize src_stride,
+                     gsize row_bytes, guint rows);
+
+void rerun_swap_pair_rows(guint8* dest, gsize dest_stride,
+                          const guint8* src, gsize src_stride,
+                          gsize row_bytes, guint rows);
+
+G_END_DECLS
+
+#endif // __RERUN_FRAME_PACKER_H__
@@ -0,0 +1,253 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "rerunh264.hpp"
+
+#include <cstring>
+
+// First byte of the next 00 00 01 start code in [@p, @end), or @end
+static const guint8* find_start_code(const guint8* p, const guint8* end) {
+    if (end - p < 3) {
+        return end;
+    }
+
+    // memchr skips to candidate 0x01 bytes much faster than a byte loop
+    const guint8* q = p + 2;
+    while (q < end) {
+        q = (const guint8*)memchr(q, 0x01, end - q);
+        if (!q) {
+            return end;
+        }
+        if (q[-1] == 0 && q[-2] == 0) {
+            return q - 2;
+        }
+        ++q;
+    }
+
+    return end;
+}
+
+gboolean rerun_h264_next_nal(const guint8* data, gsize size, gsize* offset, RerunNalUnit* nal) {
+    const guint8* end = data + size;
+
+    while (*offset < size) {
+        const guint8* start_code = find_start_code(data + *offset, end);
+        if (start_code == end) {
+            *offset = size;
+            return FALSE;
+        }
+
+        const guint8* start = start_code + 3;
+        const guint8* next = find_start_code(start, end);
+
+        // Zeros before the next start code belong to it (4-byte form)
+        const guint8* stop = next;
+        while (stop > start && stop[-1] == 0) {
+            --stop;
+        }
+
+        *offset = next - data;
+        if (stop == start) {
+            continue;
+        }
+
+        nal->data = start;
+        nal->size = stop - start;
+        nal->type = start[0] & 0x1f;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+gboolean rerun_h264_starts_access_unit(const RerunNalUnit* nal, gboolean have_slice) {
+    if (!have_slice) {
+        return FALSE;
+    }
+
+    switch (nal->type) {
+        case RERUN_H264_NAL_SLICE:
+        case 2:
+        case RERUN_H264_NAL_IDR:
+            // ue(v) first_mb_in_slice is 0 exactly when its first bit is set
+            return nal->size > 1 && (nal->data[1] & 0x80);
+
+        case RERUN_H264_NAL_SEI:
+        case RERUN_H264_NAL_SPS:
+        case RERUN_H264_NAL_PPS:
+        case RERUN_H264_NAL_AUD:
+        case 14:
+        case 15:
+        case 16:
+        case 17:
+        case 18:
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+void rerun_h264_append_nal(std::vector<std::uint8_t>* out, const guint8* data, gsize size) {
+    static const guint8 start_code[] = {0x00, 0x00, 0x00, 0x01};
+
+    out->insert(out->end(), start_code, start_code + sizeof(start_code));
+    out->insert(out->end(), data, data + size);
+}
+
+// Copies the @count 16-bit length-prefixed parameter sets at *@offset into
+// @last (keeping the last one) and moves *@offset past them
+static gboolean read_parameter_sets(
+    const guint8* data,
+    gsize size,
+    gsize* offset,
+    guint count,
+    std::vector<std::uint8_t>* last) {
+
+    for (guint i = 0; i < count; i++) {
+        if (*offset + 2 > size) {
+            return FALSE;
+        }
+
+        gsize length = (data[*offset] << 8) | data[*offset + 1];
+        *offset += 2;
+        if (*offset + length > size) {
+            return FALSE;
+        }
+
+        last->assign(data + *offset, data + *offset + length);
+        *offset += length;
+    }
+
+    return TRUE;
+}
+
+guint rerun_h264_parse_avcc(
+    const guint8* data,
+    gsize size,
+    std::vector<std::uint8_t>* sps,
+    std::vector<std::uint8_t>* pps) {
+
+    // version, profile, compatibility, level, length size, SPS count
+    if (size < 7 || data[0] != 1) {
+        return 0;
+    }
+
+    guint length_size = (data[4] & 0x03) + 1;
+    if (length_size == 3) {
+        return 0;
+    }
+
+    gsize offset = 6;
+    if (!read_parameter_sets(data, size, &offset, data[5] & 0x1f, sps)) {
+        return 0;
+    }
+
+    if (offset >= size) {
+        return 0;
+    }
+
+    guint pps_count = data[offset++];
+    if (!read_parameter_sets(data, size, &offset, pps_count, pps)) {
+        return 0;
+    }
+
+    return length_size;
+}
+
+guint rerun_h265_parse_hvcc(
+    const guint8* data,
+    gsize size,
+    std::vector<std::uint8_t>* vps,
+    std::vector<std::uint8_t>* sps,
+    std::vector<std::uint8_t>* pps) {
+
+    // 22 bytes of profile and format fields, then the NAL unit arrays
+    if (size < 23) {
+        return 0;
+    }
+
+    guint length_size = (data[21] & 0x03) + 1;
+    if (length_size == 3) {
+        return 0;
+    }
+
+    guint arrays = data[22];
+    gsize offset = 23;
+
+    for (guint i = 0; i < arrays; i++) {
+        if (offset + 3 > size) {
+            return 0;
+        }
+
+        guint type = data[offset] & 0x3f;
+        guint count = (data[offset + 1] << 8) | data[offset + 2];
+        offset += 3;
+
+        std::vector<std::uint8_t> ignored;
+        std::vector<std::uint8_t>* last = &ignored;
+        if (type == RERUN_H265_NAL_VPS) {
+            last = vps;
+        } else if (type == RERUN_H265_NAL_SPS) {
+            last = sps;
+        } else if (type == RERUN_H265_NAL_PPS) {
+            last = pps;
+        }
+
+        if (!read_parameter_sets(data, size, &offset, count, last)) {
+            return 0;
+        }
+    }
+
+    return length_size;
+}
+
+gboolean rerun_h264_avc_to_annexb(
+    const guint8* data,
+    gsize size,
+    guint length_size,
+    std::vector<std::uint8_t>* out) {
+
+    gsize offset = 0;
+
+    // The output is about the size of the input and the vector is reused
+    // across buffers, so allocations stop after the first few frames
+    out->reserve(out->size() + size + 4);
+
+    while (offset + length_size <= size) {
+        gsize length = 0;
+        for (guint i = 0; i < length_size; i++) {
+            length = (length << 8) | data[offset + i];
+        }
+        offset += length_size;
+
+        if (length > size - offset) {
+            return FALSE;
+        }
+
+        if (length > 0) {
+            rerun_h264_append_nal(out, data + offset, length);
+        }
+        offset += length;
+    }
+
+    return offset == size;
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __RERUN_H264_H__
+#define __RERUN_H264_H__
+
+#include <gst/gst.h>
+
+#include <cstdint>
+#include <vector>
+
+G_BEGIN_DECLS
+
+#define RERUN_H264_NAL_SLICE 1
+#define RERUN_H264_NAL_IDR 5
+#define RERUN_H264_NAL_SEI 6
+#define RERUN_H264_NAL_SPS 7
+#define RERUN_H264_NAL_PPS 8
+#define RERUN_H264_NAL_AUD 9
+
+// H.265 types that matter to the sink. 16 to 23 are IRAP pictures (BLA,
+// IDR and CRA), where decoding can start.
+#define RERUN_H265_NAL_IRAP_FIRST 16
+#define RERUN_H265_NAL_IRAP_LAST 23
+#define RERUN_H265_NAL_VPS 32
+#define RERUN_H265_NAL_SPS 33
+#define RERUN_H265_NAL_PPS 34
+#define RERUN_H265_NAL_AUD 35
+
+// rerun_h264_next_nal() fills in the H.264 type. H.265 keeps its type in
+// the upper bits of a two-byte NAL header.
+#define RERUN_H265_NAL_TYPE(nal) (((nal)->data[0] >> 1) & 0x3f)
+
+// A NAL unit inside a caller-owned buffer, without its start code
+typedef struct {
+    const guint8* data;
+    gsize size;
+    guint8 type;
+} RerunNalUnit;
+
+// Finds the next Annex-B NAL unit at or after *@offset in @data and moves
+// *@offset past it. Returns FALSE once no NAL unit is left. Nothing is
+// copied or allocated, so it is cheap enough to run on every buffer.
+gboolean rerun_h264_next_nal(const guint8* data, gsize size, gsize* offset, RerunNalUnit* nal);
+
+// TRUE if @nal opens a new access unit, given whether the access unit
+// collected so far already holds a slice. Follows the first-NAL rules of
+// H.264 7.4.1.2.3, using first_mb_in_slice == 0 to spot a new picture.
+gboolean rerun_h264_starts_access_unit(const RerunNalUnit* nal, gboolean have_slice);
+
+G_END_DECLS
+
+// Appends @nal to @out behind a 4-byte Annex-B start code
+void rerun_h264_append_nal(std::vector<std::uint8_t>* out, const guint8* data, gsize size);
+
+// Reads an avcC record, the codec_data of stream-format=avc and avc3.
+// Returns the size of the NAL length prefix in bytes, or 0 if the record
+// is malformed. The last SPS and PPS it carries are copied to @sps/@pps.
+guint rerun_h264_parse_avcc(
+    const guint8* data,
+    gsize size,
+    std::vector<std::uint8_t>* sps,
+    std::vector<std::uint8_t>* pps);
+
+// Reads an hvcC record, the codec_data of stream-format=hvc1 and hev1.
+// Returns the size of the NAL length prefix in bytes, or 0 if the record
+// is malformed. The last VPS, SPS and PPS it carries are copied out.
+guint rerun_h265_parse_hvcc(
+    const guint8* data,
+    gsize size,
+    std::vector<std::uint8_t>* vps,
+    std::vector<std::uint8_t>* sps,
+    std::vector<std::uint8_t>* pps);
+
+// Appends the length-prefixed NAL units in @data to @out in Annex-B form.
+// Works for both codecs, only the codec_data records differ.
+// Returns FALSE if a unit runs past the end of @data.
+gboolean rerun_h264_avc_to_annexb(
+    const guint8* data,
+    gsize size,
+    guint length_size,
+    std::vector<std::uint8_t>* out);
+
+#endif // __RERUN_H264_H__
@@ -0,0 +1,286 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "rerunimageencoder.hpp"
+
+#include <cstring>
+
+#ifdef HAVE_IMAGE_ENCODING
+#include <png.h>
+#include <turbojpeg.h>
+#endif
+
+void rerun_image_source_init_frame(RerunImageSource* source, const GstVideoFrame* frame) {
+    memset(source, 0, sizeof(*source));
+    source->format = GST_VIDEO_FRAME_FORMAT(frame);
+    source->width = GST_VIDEO_FRAME_WIDTH(frame);
+    source->height = GST_VIDEO_FRAME_HEIGHT(frame);
+
+    for (guint plane = 0; plane < GST_VIDEO_FRAME_N_PLANES(frame); ++plane) {
+        source->data[plane] = (const guint8*)GST_VIDEO_FRAME_PLANE_DATA(frame, plane);
+        source->stride[plane] = GST_VIDEO_FRAME_PLANE_STRIDE(frame, plane);
+    }
+}
+
+void rerun_image_source_init_packed(
+    RerunImageSource* source,
+    const GstVideoInfo* info,
+    const RerunPlaneLayout* layout,
+    const guint8* data) {
+
+    memset(source, 0, sizeof(*source));
+    source->format = GST_VIDEO_INFO_FORMAT(info);
+    source->width = GST_VIDEO_INFO_WIDTH(info);
+    source->height = GST_VIDEO_INFO_HEIGHT(info);
+
+    for (guint plane = 0; plane < layout->n_planes; ++plane) {
+        source->data[plane] = data + layout->offset[plane];
+        source->stride[plane] = layout->row_bytes[plane];
+    }
+}
+
+const gchar* rerun_image_encoding_media_type(RerunImageEncoding encoding) {
+    switch (encoding) {
+        case RERUN_IMAGE_ENCODING_JPEG:
+            return "image/jpeg";
+        case RERUN_IMAGE_ENCODING_PNG:
+            return "image/png";
+        default:
+            return NULL;
+    }
+}
+
+gboolean rerun_image_encoding_available(void) {
+#ifdef HAVE_IMAGE_ENCODING
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+gboolean rerun_image_encoding_supports(RerunImageEncoding encoding, GstVideoFormat format) {
+    switch (encoding) {
+        case RERUN_IMAGE_ENCODING_NONE:
+            return TRUE;
+
+#ifdef HAVE_IMAGE_ENCODING
+        case RERUN_IMAGE_ENCODING_JPEG:
+            return format == GST_VIDEO_FORMAT_RGB || format == GST_VIDEO_FORMAT_RGBA ||
+                   format == GST_VIDEO_FORMAT_GRAY8 || format == GST_VIDEO_FORMAT_NV12 ||
+                   format == GST_VIDEO_FORMAT_I420;
+
+        case RERUN_IMAGE_ENCODING_PNG:
+            return format == GST_VIDEO_FORMAT_RGB || format == GST_VIDEO_FORMAT_RGBA ||
+                   format == GST_VIDEO_FORMAT_GRAY8;
+#endif
+
+        default:
+            return FALSE;
+    }
+}
+
+#ifdef HAVE_IMAGE_ENCODING
+
+GST_DEBUG_CATEGORY_STATIC(rerun_image_encoder_debug);
+#define GST_CAT_DEFAULT rerun_image_encoder_debug
+
+static void rerun_image_encoder_init_debug(void) {
+    static gsize initialized = 0;
+
+    if (g_once_init_enter(&initialized)) {
+        GST_DEBUG_CATEGORY_INIT(rerun_image_encoder_debug, "rerunimageencoder", 0, "Rerun sink image encoder");
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
+// Compressor and scratch memory of the calling thread, created on first use
+struct RerunJpegState {
+    tjhandle handle = nullptr;
+    std::vector<std::uint8_t> output;   // Worst-case sized, so TurboJPEG never reallocates
+    std::vector<std::uint8_t> chroma;   // NV12 chroma split into U and V planes
+
+    ~RerunJpegState() {
+        if (handle) {
+            tjDestroy(handle);
+        }
+    }
+};
+
+static thread_local RerunJpegState jpeg_state;
+
+gboolean rerun_image_encode_jpeg(const RerunImageSource* source, gint quality, std::vector<std::uint8_t>* out) {
+    RerunJpegState* state = &jpeg_state;
+    rerun_image_encoder_init_debug();
+
+    if (!state->handle && !(state->handle = tjInitCompress())) {
+        GST_ERROR("Failed to create a JPEG compressor");
+        return FALSE;
+    }
+
+    int width = (int)source->width;
+    int height = (int)source->height;
+    int pixel_format = -1;
+    int subsampling = TJSAMP_420;
+
+    switch (source->format) {
+        case GST_VIDEO_FORMAT_RGB:
+            pixel_format = TJPF_RGB;
+            break;
+        case GST_VIDEO_FORMAT_RGBA:
+            pixel_format = TJPF_RGBA;
+            break;
+        case GST_VIDEO_FORMAT_GRAY8:
+            pixel_format = TJPF_GRAY;
+            subsampling = TJSAMP_GRAY;
+            break;
+        case GST_VIDEO_FORMAT_I420:
+        case GST_VIDEO_FORMAT_NV12:
+            break;
+        default:
+            GST_WARNING("Cannot encode %s as JPEG", gst_video_format_to_string(source->format));
+            return FALSE;
+    }
+
+    state->output.resize(tjBufSize(width, height, subsampling));
+    unsigned char* jpeg = state->output.data();
+    unsigned long jpeg_size = state->output.size();
+    int flags = TJFLAG_NOREALLOC | TJFLAG_FASTDCT;
+    int ret;
+
+    if (pixel_format >= 0) {
+        ret = tjCompress2(state->handle, source->data[0], width, (int)source->stride[0], height,
+                          pixel_format, &jpeg, &jpeg_size, subsampling, quality, flags);
+    } else {
+        // 4:2:0 planes go straight to the DCT, skipping any color conversion
+        const unsigned char* planes[3] = { source->data[0], source->data[1], source->data[2] };
+        int strides[3] = { (int)source->stride[0], (int)source->stride[1], (int)source->stride[2] };
+
+        if (source->format == GST_VIDEO_FORMAT_NV12) {
+            int chroma_width = (width + 1) / 2;
+            int chroma_height = (height + 1) / 2;
+
+            state->chroma.resize((gsize)chroma_width * chroma_height * 2);
+            guint8* u = state->chroma.data();
+            guint8* v = u + (gsize)chroma_width * chroma_height;
+
+            for (int row = 0; row < chroma_height; ++row) {
+                const guint8* uv = source->data[1] + row * source->stride[1];
+                guint8* u_row = u + (gsize)row * chroma_width;
+                guint8* v_row = v + (gsize)row * chroma_width;
+                for (int x = 0; x < chroma_width; ++x) {
+                    u_row[x] = uv[2 * x];
+                    v_row[x] = uv[2 * x + 1];
+                }
+            }
+
+            planes[1] = u;
+            planes[2] = v;
+            strides[1] = strides[2] = chroma_width;
+        }
+
+        ret = tjCompressFromYUVPlanes(state->handle, planes, width, strides, height,
+                                      subsampling, &jpeg, &jpeg_size, quality, flags);
+    }
+
+    if (ret != 0) {
+        GST_WARNING("JPEG encoding failed: %s", tjGetErrorStr2(state->handle));
+        return FALSE;
+    }
+
+    out->assign(jpeg, jpeg + jpeg_size);
+    return TRUE;
+}
+
+static void rerun_png_write(png_structp png, png_bytep data, png_size_t length) {
+    std::vector<std::uint8_t>* out = (std::vector<std::uint8_t>*)png_get_io_ptr(png);
+    out->insert(out->end(), data, data + length);
+}
+
+static void rerun_png_flush(png_structp png) {
+}
+
+gboolean rerun_image_encode_png(const RerunImageSource* source, std::vector<std::uint8_t>* out) {
+    rerun_image_encoder_init_debug();
+
+    int color_type;
+    switch (source->format) {
+        case GST_VIDEO_FORMAT_RGB:
+            color_type = PNG_COLOR_TYPE_RGB;
+            break;
+        case GST_VIDEO_FORMAT_RGBA:
+            color_type = PNG_COLOR_TYPE_RGBA;
+            break;
+        case GST_VIDEO_FORMAT_GRAY8:
+            color_type = PNG_COLOR_TYPE_GRAY;
+            break;
+        default:
+            GST_WARNING("Cannot encode %s as PNG", gst_video_format_to_string(source->format));
+            return FALSE;
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png) {
+        return FALSE;
+    }
+
+    png_infop info = png_create_info_struct(png);
+    if (!info) {
+        png_destroy_write_struct(&png, NULL);
+        return FALSE;
+    }
+
+    if (setjmp(png_jmpbuf(png))) {
+        GST_WARNING("PNG encoding failed");
+        png_destroy_write_struct(&png, &info);
+        return FALSE;
+    }
+
+    out->clear();
+    png_set_write_fn(png, out, rerun_png_write, rerun_png_flush);
+
+    // Lossless is the point here, not the smallest file: favour speed
+    png_set_compression_level(png, 1);
+
+    png_set_IHDR(png, info, source->width, source->height, 8, color_type,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+
+    for (guint row = 0; row < source->height; ++row) {
+        png_write_row(png, (png_const_bytep)(source->data[0] + row * source->stride[0]));
+    }
+
+    png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
+
+    return TRUE;
+}
+
+#else
+
+gboolean rerun_image_encode_jpeg(const RerunImageSource* source, gint quality, std::vector<std::uint8_t>* out) {
+    return FALSE;
+}
+
+gboolean rerun_image_encode_png(const RerunImageSource* source, std::vector<std::uint8_t>* out) {
+    return FALSE;
+}
+
+#endif
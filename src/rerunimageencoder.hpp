@@ -0,0 +1,71 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __RERUN_IMAGE_ENCODER_H__
+#define __RERUN_IMAGE_ENCODER_H__
+
+#include "rerunframepacker.hpp"
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include <cstdint>
+#include <vector>
+
+typedef enum {
+  RERUN_IMAGE_ENCODING_NONE,        // Log raw pixels with rerun::archetypes::Image
+  RERUN_IMAGE_ENCODING_JPEG,        // Lossy, every supported raw format
+  RERUN_IMAGE_ENCODING_PNG,         // Lossless, RGB, RGBA and GRAY8 only
+} RerunImageEncoding;
+
+// Planes of a raw image to encode; rows may be padded
+typedef struct {
+  GstVideoFormat format;
+  guint width;
+  guint height;
+  const guint8* data[GST_VIDEO_MAX_PLANES];
+  gsize stride[GST_VIDEO_MAX_PLANES];
+} RerunImageSource;
+
+void rerun_image_source_init_frame(RerunImageSource* source, const GstVideoFrame* frame);
+
+// Image stored in @data with the packed @layout of @info
+void rerun_image_source_init_packed(
+    RerunImageSource* source,
+    const GstVideoInfo* info,
+    const RerunPlaneLayout* layout,
+    const guint8* data);
+
+// Media type of the output of @encoding, e.g. "image/jpeg"
+const gchar* rerun_image_encoding_media_type(RerunImageEncoding encoding);
+
+// FALSE when the plugin was built without WITH_IMAGE_ENCODING
+gboolean rerun_image_encoding_available(void);
+
+gboolean rerun_image_encoding_supports(RerunImageEncoding encoding, GstVideoFormat format);
+
+// Both encoders are safe to call from several threads at once; every thread
+// keeps its own codec state and scratch memory. @out is replaced with the
+// encoded image.
+gboolean rerun_image_encode_jpeg(const RerunImageSource* source, gint quality, std::vector<std::uint8_t>* out);
+gboolean rerun_image_encode_png(const RerunImageSource* source, std::vector<std::uint8_t>* out);
+
+#endif // __RERUN_IMAGE_ENCODER_H__
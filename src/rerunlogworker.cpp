@@ -0,0 +1,298 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "rerunlogworker.hpp"
+#include "rerunboundedqueue.hpp"
+
+#include <atomic>
+
+// The queue itself is lock-free; the mutex and condition only exist so that
+// an idle worker, a producer blocked on a full queue or a drain can sleep.
+// Each side advertises that it is about to sleep, and the other side only
+// takes the lock to wake it when that flag or counter says so.
+struct _RerunLogWorker {
+  RerunBoundedQueue<RerunLogJob>* queue;
+  RerunQueuePolicy policy;
+
+  RerunLogJobFunc process;
+  RerunLogJobFunc release;
+  gpointer user_data;
+
+  GThread* thread;
+  GMutex lock;
+  GCond cond;
+
+  std::atomic<gint> pending;          // Queued or being processed
+  std::atomic<gint> waiters;          // Producers and drains sleeping on cond
+  std::atomic<gboolean> worker_idle;  // Worker sleeping on cond
+  std::atomic<gboolean> running;
+  std::atomic<gboolean> flushing;
+  std::atomic<gboolean> unblocked;
+  std::atomic<guint64> dropped;
+  std::atomic<gint> kept;             // Queued jobs with keep set
+
+  guint64 next_seq;                   // Only touched by the producer
+  guint64 last_seq;                   // Only touched by the worker thread
+};
+
+static void rerun_log_worker_wake(RerunLogWorker* worker) {
+    g_mutex_lock(&worker->lock);
+    g_cond_broadcast(&worker->cond);
+    g_mutex_unlock(&worker->lock);
+}
+
+static void rerun_log_worker_wake_waiters(RerunLogWorker* worker) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (worker->waiters.load()) {
+        rerun_log_worker_wake(worker);
+    }
+}
+
+static void rerun_log_worker_wake_worker(RerunLogWorker* worker) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (worker->worker_idle.load()) {
+        rerun_log_worker_wake(worker);
+    }
+}
+
+static void rerun_log_worker_dequeued(RerunLogWorker* worker, const RerunLogJob* job) {
+    if (job->keep) {
+        worker->kept.fetch_sub(1);
+    }
+}
+
+// Marks a job that left the queue as finished, letting drains make progress
+static void rerun_log_worker_complete(RerunLogWorker* worker, RerunLogJob* job) {
+    worker->release(job, worker->user_data);
+    worker->pending.fetch_sub(1);
+    rerun_log_worker_wake_waiters(worker);
+}
+
+static void rerun_log_worker_drop(RerunLogWorker* worker, RerunLogJob* job) {
+    worker->dropped.fetch_add(1);
+    rerun_log_worker_complete(worker, job);
+}
+
+static gpointer rerun_log_worker_loop(gpointer data) {
+    RerunLogWorker* worker = (RerunLogWorker*)data;
+    RerunLogJob job;
+
+    for (;;) {
+        if (worker->queue->try_pop(job)) {
+            rerun_log_worker_dequeued(worker, &job);
+
+            // A slot just freed up for a producer blocked on a full queue
+            rerun_log_worker_wake_waiters(worker);
+
+            // Whatever was pushed between the last job and this one never
+            // made it here
+            job.after_drop = job.seq != worker->last_seq + 1;
+            worker->last_seq = job.seq;
+
+            worker->process(&job, worker->user_data);
+            rerun_log_worker_complete(worker, &job);
+            continue;
+        }
+
+        g_mutex_lock(&worker->lock);
+        worker->worker_idle.store(TRUE);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (worker->queue->size_approx() == 0 && worker->running.load()) {
+            g_cond_wait(&worker->cond, &worker->lock);
+        }
+        worker->worker_idle.store(FALSE);
+        gboolean running = worker->running.load();
+        g_mutex_unlock(&worker->lock);
+
+        if (!running && worker->queue->size_approx() == 0) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+RerunLogWorker* rerun_log_worker_new(
+    const gchar* name,
+    guint depth,
+    RerunQueuePolicy policy,
+    RerunLogJobFunc process,
+    RerunLogJobFunc release,
+    gpointer user_data) {
+
+    RerunLogWorker* worker = new RerunLogWorker();
+    worker->queue = new RerunBoundedQueue<RerunLogJob>(depth);
+    worker->policy = policy;
+    worker->process = process;
+    worker->release = release;
+    worker->user_data = user_data;
+
+    g_mutex_init(&worker->lock);
+    g_cond_init(&worker->cond);
+
+    worker->pending.store(0);
+    worker->waiters.store(0);
+    worker->worker_idle.store(FALSE);
+    worker->running.store(TRUE);
+    worker->flushing.store(FALSE);
+    worker->unblocked.store(FALSE);
+    worker->dropped.store(0);
+    worker->kept.store(0);
+    worker->next_seq = 1;
+    worker->last_seq = 0;
+
+    worker->thread = g_thread_new(name, rerun_log_worker_loop, worker);
+
+    return worker;
+}
+
+gboolean rerun_log_worker_push(RerunLogWorker* worker, const RerunLogJob* job) {
+    RerunLogJob pushed = *job;
+    pushed.seq = worker->next_seq++;
+    pushed.after_drop = FALSE;
+
+    if (worker->flushing.load() || worker->unblocked.load()) {
+        worker->release(&pushed, worker->user_data);
+        return FALSE;
+    }
+
+    worker->pending.fetch_add(1);
+
+    // Counted before the push, so the worker never sees it go below zero
+    if (pushed.keep) {
+        worker->kept.fetch_add(1);
+    }
+
+    RerunQueuePolicy policy = pushed.keep ? RERUN_QUEUE_POLICY_BLOCK : worker->policy;
+
+    for (;;) {
+        if (worker->queue->try_push(pushed)) {
+            rerun_log_worker_wake_worker(worker);
+            return TRUE;
+        }
+
+        // There is a single producer, so while no kept job is counted none
+        // can be in the queue
+        if (policy == RERUN_QUEUE_POLICY_DROP_OLDEST && worker->kept.load() > 0) {
+            policy = RERUN_QUEUE_POLICY_DROP_NEWEST;
+        }
+
+        switch (policy) {
+            case RERUN_QUEUE_POLICY_DROP_NEWEST:
+                rerun_log_worker_drop(worker, &pushed);
+                return FALSE;
+
+            case RERUN_QUEUE_POLICY_DROP_OLDEST: {
+                RerunLogJob oldest;
+                if (worker->queue->try_pop(oldest)) {
+                    rerun_log_worker_dequeued(worker, &oldest);
+                    rerun_log_worker_drop(worker, &oldest);
+                }
+                break;
+            }
+
+            case RERUN_QUEUE_POLICY_BLOCK:
+            default: {
+                gboolean queued = FALSE;
+
+                worker->waiters.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                // A flush frees the queue up too, so it is checked before
+                // retrying or the job would be queued behind its back
+                g_mutex_lock(&worker->lock);
+                while (!worker->flushing.load() && !worker->unblocked.load() &&
+                       !(queued = worker->queue->try_push(pushed))) {
+                    g_cond_wait(&worker->cond, &worker->lock);
+                }
+                g_mutex_unlock(&worker->lock);
+                worker->waiters.fetch_sub(1);
+
+                if (queued) {
+                    rerun_log_worker_wake_worker(worker);
+                    return TRUE;
+                }
+
+                // Interrupted by a flush or unlock, not a policy drop
+                rerun_log_worker_dequeued(worker, &pushed);
+                rerun_log_worker_complete(worker, &pushed);
+                return FALSE;
+            }
+        }
+    }
+}
+
+void rerun_log_worker_drain(RerunLogWorker* worker) {
+    worker->waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    g_mutex_lock(&worker->lock);
+    while (worker->pending.load() > 0) {
+        g_cond_wait(&worker->cond, &worker->lock);
+    }
+    g_mutex_unlock(&worker->lock);
+    worker->waiters.fetch_sub(1);
+}
+
+void rerun_log_worker_set_flushing(RerunLogWorker* worker, gboolean flushing) {
+    worker->flushing.store(flushing);
+
+    if (!flushing) {
+        return;
+    }
+
+    RerunLogJob job;
+    while (worker->queue->try_pop(job)) {
+        rerun_log_worker_dequeued(worker, &job);
+        rerun_log_worker_complete(worker, &job);
+    }
+    rerun_log_worker_wake(worker);
+}
+
+void rerun_log_worker_set_unblocked(RerunLogWorker* worker, gboolean unblocked) {
+    worker->unblocked.store(unblocked);
+
+    if (unblocked) {
+        rerun_log_worker_wake(worker);
+    }
+}
+
+guint64 rerun_log_worker_get_dropped(RerunLogWorker* worker) {
+    return worker->dropped.load();
+}
+
+guint rerun_log_worker_get_pending(RerunLogWorker* worker) {
+    return MAX(worker->pending.load(), 0);
+}
+
+void rerun_log_worker_free(RerunLogWorker* worker) {
+    rerun_log_worker_drain(worker);
+
+    g_mutex_lock(&worker->lock);
+    worker->running.store(FALSE);
+    g_cond_broadcast(&worker->cond);
+    g_mutex_unlock(&worker->lock);
+
+    g_thread_join(worker->thread);
+
+    g_mutex_clear(&worker->lock);
+    g_cond_clear(&worker->cond);
+    delete worker->queue;
+    delete worker;
+}
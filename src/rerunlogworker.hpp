@@ -0,0 +1,107 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __RERUN_LOG_WORKER_H__
+#define __RERUN_LOG_WORKER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// What to do when a job is pushed while the queue is full
+typedef enum {
+  RERUN_QUEUE_POLICY_BLOCK,         // Wait for the worker to make room
+  RERUN_QUEUE_POLICY_DROP_OLDEST,   // Discard the oldest queued job
+  RERUN_QUEUE_POLICY_DROP_NEWEST,   // Discard the job being pushed
+} RerunQueuePolicy;
+
+// Where a buffer sits on the recording's timelines. It is taken on the
+// streaming thread, where the segment the buffer belongs to is known, and
+// travels with the buffer to wherever it ends up being logged.
+typedef struct {
+  GstClockTime pts;           // Buffer PTS, or DTS when there is none
+  GstClockTime dts;           // Decode order, only used to mux encoded video
+  GstClockTime running_time;
+  GstClockTime stream_time;
+  guint64 index;              // Buffers received since start, skipped ones included
+  guint outputs;              // Output streams the frame is logged to, one bit each
+} RerunFrameTime;
+
+// A unit of work handed to the worker. The buffer reference and @data are
+// owned by the job and released through the worker's release function,
+// whether the job was processed or dropped.
+typedef struct {
+  GstBuffer* buffer;
+  gpointer data;
+  RerunFrameTime time;
+  gboolean keep;              // Never dropped for a full queue, the producer blocks instead
+
+  // Set by the worker: the order the job was pushed in, and whether jobs
+  // pushed right before it were dropped instead of processed
+  guint64 seq;
+  gboolean after_drop;
+} RerunLogJob;
+
+typedef void (*RerunLogJobFunc)(RerunLogJob* job, gpointer user_data);
+
+typedef struct _RerunLogWorker RerunLogWorker;
+
+// Starts a thread that runs @process on every pushed job, in push order.
+// Jobs travel through a lock-free bounded queue of @depth entries, so the
+// producer only pays for the handoff unless it has to block on a full queue.
+RerunLogWorker* rerun_log_worker_new(
+    const gchar* name,
+    guint depth,
+    RerunQueuePolicy policy,
+    RerunLogJobFunc process,
+    RerunLogJobFunc release,
+    gpointer user_data);
+
+// Queues @job, taking ownership of it. Returns FALSE if the job was dropped
+// instead (full queue with drop-newest, or the worker is flushing). A job
+// with @keep set blocks on a full queue whatever the policy, and is not
+// dropped to make room for a newer one: drop-oldest then drops the job being
+// pushed while kept jobs are queued.
+gboolean rerun_log_worker_push(RerunLogWorker* worker, const RerunLogJob* job);
+
+// Blocks until every queued job has been processed
+void rerun_log_worker_drain(RerunLogWorker* worker);
+
+// While flushing, queued jobs are discarded, pushes are rejected and a
+// producer blocked on a full queue returns right away
+void rerun_log_worker_set_flushing(RerunLogWorker* worker, gboolean flushing);
+
+// Wakes a producer blocked on a full queue and rejects pushes until
+// unblocked again, without discarding what is already queued
+void rerun_log_worker_set_unblocked(RerunLogWorker* worker, gboolean unblocked);
+
+guint64 rerun_log_worker_get_dropped(RerunLogWorker* worker);
+
+// Jobs queued or being processed. Called from the worker thread it tells
+// how far logging has fallen behind the producer.
+guint rerun_log_worker_get_pending(RerunLogWorker* worker);
+
+// Drains the queue, then stops and joins the thread
+void rerun_log_worker_free(RerunLogWorker* worker);
+
+G_END_DECLS
+
+#endif // __RERUN_LOG_WORKER_H__
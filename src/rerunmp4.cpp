@@ -0,0 +1,522 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include "rerunmp4.hpp"
+#include "rerunh264.hpp"
+
+// Media timescale, the usual 90 kHz video clock
+#define TIMESCALE 90000
+
+// Used for the last sample when nothing else tells its duration
+#define FALLBACK_DURATION (GST_SECOND / 30)
+
+static const guint32 identity_matrix[9] = {
+    0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000
+};
+
+static void put_u8(std::vector<std::uint8_t>* out, guint value) {
+    out->push_back((std::uint8_t)value);
+}
+
+static void put_u16(std::vector<std::uint8_t>* out, guint value) {
+    put_u8(out, value >> 8);
+    put_u8(out, value);
+}
+
+static void put_u32(std::vector<std::uint8_t>* out, guint32 value) {
+    put_u16(out, value >> 16);
+    put_u16(out, value & 0xffff);
+}
+
+static void put_bytes(std::vector<std::uint8_t>* out, const std::vector<std::uint8_t>& bytes) {
+    out->insert(out->end(), bytes.begin(), bytes.end());
+}
+
+static void put_zeros(std::vector<std::uint8_t>* out, gsize count) {
+    out->insert(out->end(), count, 0);
+}
+
+static void set_u32(std::vector<std::uint8_t>* out, gsize offset, guint32 value) {
+    (*out)[offset] = value >> 24;
+    (*out)[offset + 1] = value >> 16;
+    (*out)[offset + 2] = value >> 8;
+    (*out)[offset + 3] = value;
+}
+
+// Starts a box and returns where it begins, for end_box() to fill in its size
+static gsize begin_box(std::vector<std::uint8_t>* out, const char* type) {
+    gsize start = out->size();
+    put_u32(out, 0);
+    out->insert(out->end(), type, type + 4);
+    return start;
+}
+
+static gsize begin_full_box(std::vector<std::uint8_t>* out, const char* type, guint version, guint32 flags) {
+    gsize start = begin_box(out, type);
+    put_u32(out, (version << 24) | flags);
+    return start;
+}
+
+static void end_box(std::vector<std::uint8_t>* out, gsize start) {
+    set_u32(out, start, out->size() - start);
+}
+
+static guint32 to_media_time(GstClockTime time) {
+    return (guint32)gst_util_uint64_scale(time, TIMESCALE, GST_SECOND);
+}
+
+// Minimal RBSP bit reader, enough for the start of an H.265 SPS
+typedef struct {
+    std::vector<std::uint8_t> rbsp;
+    gsize bit;
+} BitReader;
+
+static void bit_reader_init(BitReader* reader, const std::vector<std::uint8_t>& nal, gsize header_size) {
+    reader->rbsp.clear();
+    reader->bit = 0;
+
+    // Drops emulation prevention bytes (00 00 03)
+    guint zeros = 0;
+    for (gsize i = header_size; i < nal.size(); i++) {
+        if (zeros >= 2 && nal[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = nal[i] == 0 ? zeros + 1 : 0;
+        reader->rbsp.push_back(nal[i]);
+    }
+}
+
+static guint32 read_bits(BitReader* reader, guint count) {
+    guint32 value = 0;
+
+    for (guint i = 0; i < count; i++, reader->bit++) {
+        gsize byte = reader->bit / 8;
+        guint bit = byte < reader->rbsp.size() ? (reader->rbsp[byte] >> (7 - reader->bit % 8)) & 1 : 0;
+        value = (value << 1) | bit;
+    }
+
+    return value;
+}
+
+static guint32 read_ue(BitReader* reader) {
+    guint zeros = 0;
+    while (read_bits(reader, 1) == 0 && zeros < 32) {
+        zeros++;
+    }
+    return ((1u << zeros) - 1) + read_bits(reader, zeros);
+}
+
+static void write_avcc(std::vector<std::uint8_t>* out, const RerunMp4Segment* segment) {
+    gsize box = begin_box(out, "avcC");
+
+    put_u8(out, 1);
+    put_u8(out, segment->sps[1]);   // profile_idc
+    put_u8(out, segment->sps[2]);   // constraint flags
+    put_u8(out, segment->sps[3]);   // level_idc
+    put_u8(out, 0xfc | 3);          // 4-byte lengths
+    put_u8(out, 0xe0 | 1);
+    put_u16(out, segment->sps.size());
+    put_bytes(out, segment->sps);
+    put_u8(out, 1);
+    put_u16(out, segment->pps.size());
+    put_bytes(out, segment->pps);
+
+    end_box(out, box);
+}
+
+static void write_hvcc_array(std::vector<std::uint8_t>* out, guint type, const std::vector<std::uint8_t>& nal) {
+    put_u8(out, 0x80 | type);       // array_completeness
+    put_u16(out, 1);
+    put_u16(out, nal.size());
+    put_bytes(out, nal);
+}
+
+// The profile, tier and level fields are copied from the SPS, which has
+// them at fixed positions; chroma format and bit depth need a short parse
+static void write_hvcc(std::vector<std::uint8_t>* out, const RerunMp4Segment* segment) {
+    BitReader reader;
+    bit_reader_init(&reader, segment->sps, 2);
+
+    read_bits(&reader, 4);                          // sps_video_parameter_set_id
+    guint max_sub_layers_minus1 = read_bits(&reader, 3);
+    guint temporal_id_nesting = read_bits(&reader, 1);
+
+    guint8 ptl[12];
+    for (guint i = 0; i < 12; i++) {
+        ptl[i] = read_bits(&reader, 8);
+    }
+
+    guint sub_layer_flags[8];
+    for (guint i = 0; i < max_sub_layers_minus1; i++) {
+        sub_layer_flags[i] = read_bits(&reader, 2);
+    }
+    if (max_sub_layers_minus1 > 0) {
+        read_bits(&reader, 2 * (8 - max_sub_layers_minus1));
+    }
+    for (guint i = 0; i < max_sub_layers_minus1; i++) {
+        read_bits(&reader, (sub_layer_flags[i] & 2) ? 88 : 0);
+        read_bits(&reader, (sub_layer_flags[i] & 1) ? 8 : 0);
+    }
+
+    read_ue(&reader);                               // sps_seq_parameter_set_id
+    guint chroma_format_idc = read_ue(&reader);
+    if (chroma_format_idc == 3) {
+        read_bits(&reader, 1);                      // separate_colour_plane_flag
+    }
+    read_ue(&reader);                               // pic_width_in_luma_samples
+    read_ue(&reader);                               // pic_height_in_luma_samples
+    if (read_bits(&reader, 1)) {                    // conformance_window_flag
+        for (guint i = 0; i < 4; i++) {
+            read_ue(&reader);
+        }
+    }
+    guint bit_depth_luma_minus8 = read_ue(&reader);
+    guint bit_depth_chroma_minus8 = read_ue(&reader);
+
+    gsize box = begin_box(out, "hvcC");
+
+    put_u8(out, 1);
+    out->insert(out->end(), ptl, ptl + sizeof(ptl));
+    put_u16(out, 0xf000);                           // min_spatial_segmentation_idc
+    put_u8(out, 0xfc);                              // parallelismType
+    put_u8(out, 0xfc | (chroma_format_idc & 3));
+    put_u8(out, 0xf8 | (bit_depth_luma_minus8 & 7));
+    put_u8(out, 0xf8 | (bit_depth_chroma_minus8 & 7));
+    put_u16(out, 0);                                // avgFrameRate
+    put_u8(out, ((max_sub_layers_minus1 + 1) << 3) | (temporal_id_nesting << 2) | 3);
+    put_u8(out, 3);
+    write_hvcc_array(out, RERUN_H265_NAL_VPS, segment->vps);
+    write_hvcc_array(out, RERUN_H265_NAL_SPS, segment->sps);
+    write_hvcc_array(out, RERUN_H265_NAL_PPS, segment->pps);
+
+    end_box(out, box);
+}
+
+static void write_sample_entry(std::vector<std::uint8_t>* out, const RerunMp4Segment* segment) {
+    gboolean h265 = segment->codec == RERUN_MP4_CODEC_H265;
+    gsize box = begin_box(out, h265 ? "hvc1" : "avc1");
+
+    put_zeros(out, 6);
+    put_u16(out, 1);                                // data_reference_index
+    put_zeros(out, 16);
+    put_u16(out, segment->width);
+    put_u16(out, segment->height);
+    put_u32(out, 0x00480000);                       // 72 dpi
+    put_u32(out, 0x00480000);
+    put_u32(out, 0);
+    put_u16(out, 1);                                // frame_count
+    put_zeros(out, 32);                             // compressorname
+    put_u16(out, 0x0018);
+    put_u16(out, 0xffff);
+
+    if (h265) {
+        write_hvcc(out, segment);
+    } else {
+        write_avcc(out, segment);
+    }
+
+    end_box(out, box);
+}
+
+// Writes stbl and returns where the chunk offset has to be patched
+static gsize write_sample_table(
+    std::vector<std::uint8_t>* out,
+    const RerunMp4Segment* segment,
+    const std::vector<guint32>& durations) {
+
+    const std::vector<RerunMp4Sample>& samples = segment->samples;
+    GstClockTime origin = samples.front().dts;
+    gsize stbl = begin_box(out, "stbl");
+
+    gsize box = begin_full_box(out, "stsd", 0, 0);
+    put_u32(out, 1);
+    write_sample_entry(out, segment);
+    end_box(out, box);
+
+    // Decode durations, run-length coded
+    box = begin_full_box(out, "stts", 0, 0);
+    gsize count_at = out->size();
+    guint32 entries = 0;
+    put_u32(out, 0);
+    for (gsize i = 0; i < durations.size();) {
+        gsize run = 1;
+        while (i + run < durations.size() && durations[i + run] == durations[i]) {
+            run++;
+        }
+        put_u32(out, run);
+        put_u32(out, durations[i]);
+        entries++;
+        i += run;
+    }
+    set_u32(out, count_at, entries);
+    end_box(out, box);
+
+    // Composition offsets, only needed with reordered frames
+    gboolean reordered = FALSE;
+    for (const RerunMp4Sample& sample : samples) {
+        reordered |= sample.pts != sample.dts;
+    }
+    if (reordered) {
+        box = begin_full_box(out, "ctts", 0, 0);
+        put_u32(out, samples.size());
+        for (const RerunMp4Sample& sample : samples) {
+            put_u32(out, 1);
+            put_u32(out, to_media_time(sample.pts - origin) - to_media_time(sample.dts - origin));
+        }
+        end_box(out, box);
+    }
+
+    box = begin_full_box(out, "stss", 0, 0);
+    count_at = out->size();
+    entries = 0;
+    put_u32(out, 0);
+    for (gsize i = 0; i < samples.size(); i++) {
+        if (samples[i].keyframe) {
+            put_u32(out, i + 1);
+            entries++;
+        }
+    }
+    set_u32(out, count_at, entries);
+    end_box(out, box);
+
+    // Every sample lives in a single chunk
+    box = begin_full_box(out, "stsc", 0, 0);
+    put_u32(out, 1);
+    put_u32(out, 1);
+    put_u32(out, samples.size());
+    put_u32(out, 1);
+    end_box(out, box);
+
+    box = begin_full_box(out, "stsz", 0, 0);
+    put_u32(out, 0);
+    put_u32(out, samples.size());
+    for (const RerunMp4Sample& sample : samples) {
+        put_u32(out, sample.size);
+    }
+    end_box(out, box);
+
+    box = begin_full_box(out, "stco", 0, 0);
+    put_u32(out, 1);
+    gsize chunk_offset_at = out->size();
+    put_u32(out, 0);
+    end_box(out, box);
+
+    end_box(out, stbl);
+
+    return chunk_offset_at;
+}
+
+void rerun_mp4_segment_clear(RerunMp4Segment* segment) {
+    segment->data.clear();
+    segment->samples.clear();
+}
+
+void rerun_mp4_segment_add(
+    RerunMp4Segment* segment,
+    const guint8* data,
+    gsize size,
+    GstClockTime pts,
+    GstClockTime dts,
+    gboolean keyframe) {
+
+    gboolean h265 = segment->codec == RERUN_MP4_CODEC_H265;
+    RerunMp4Sample sample;
+
+    sample.offset = segment->data.size();
+    sample.pts = pts;
+    sample.dts = dts;
+    sample.keyframe = keyframe;
+
+    if (!segment->samples.empty() && sample.dts <= segment->samples.back().dts) {
+        sample.dts = segment->samples.back().dts + 1;
+    }
+    if (sample.pts < sample.dts) {
+        sample.pts = sample.dts;
+    }
+
+    RerunNalUnit nal;
+    gsize offset = 0;
+
+    while (rerun_h264_next_nal(data, size, &offset, &nal)) {
+        guint type = h265 ? RERUN_H265_NAL_TYPE(&nal) : nal.type;
+        std::vector<std::uint8_t>* parameter_set = NULL;
+
+        if (h265) {
+            if (type == RERUN_H265_NAL_VPS) {
+                parameter_set = &segment->vps;
+            } else if (type == RERUN_H265_NAL_SPS) {
+                parameter_set = &segment->sps;
+            } else if (type == RERUN_H265_NAL_PPS) {
+                parameter_set = &segment->pps;
+            } else if (type == RERUN_H265_NAL_AUD) {
+                continue;
+            }
+        } else {
+            if (type == RERUN_H264_NAL_SPS) {
+                parameter_set = &segment->sps;
+            } else if (type == RERUN_H264_NAL_PPS) {
+                parameter_set = &segment->pps;
+            } else if (type == RERUN_H264_NAL_AUD) {
+                continue;
+            }
+        }
+
+        if (parameter_set) {
+            parameter_set->assign(nal.data, nal.data + nal.size);
+            continue;
+        }
+
+        put_u32(&segment->data, nal.size);
+        segment->data.insert(segment->data.end(), nal.data, nal.data + nal.size);
+    }
+
+    sample.size = segment->data.size() - sample.offset;
+    if (sample.size > 0) {
+        segment->samples.push_back(sample);
+    }
+}
+
+GstClockTime rerun_mp4_segment_span(const RerunMp4Segment* segment) {
+    if (segment->samples.empty()) {
+        return 0;
+    }
+
+    return segment->samples.back().dts - segment->samples.front().dts;
+}
+
+gboolean rerun_mp4_segment_write(RerunMp4Segment* segment, GstClockTime last_duration) {
+    const std::vector<RerunMp4Sample>& samples = segment->samples;
+    gboolean h265 = segment->codec == RERUN_MP4_CODEC_H265;
+
+    if (samples.empty() || segment->sps.size() < 4 || segment->pps.empty() ||
+        (h265 && segment->vps.empty())) {
+        return FALSE;
+    }
+
+    // Durations come from decode time differences, rounded once against the
+    // segment start so they never drift from the frame references
+    GstClockTime origin = samples.front().dts;
+    std::vector<guint32> durations;
+    for (gsize i = 1; i < samples.size(); i++) {
+        durations.push_back(to_media_time(samples[i].dts - origin) - to_media_time(samples[i - 1].dts - origin));
+    }
+    if (!GST_CLOCK_TIME_IS_VALID(last_duration) || last_duration == 0) {
+        last_duration = samples.size() > 1 ? samples.back().dts - samples[samples.size() - 2].dts
+                                           : FALLBACK_DURATION;
+    }
+    durations.push_back(MAX(to_media_time(last_duration), 1u));
+
+    guint32 duration = 0;
+    for (guint32 delta : durations) {
+        duration += delta;
+    }
+
+    std::vector<std::uint8_t>* out = &segment->file;
+    out->clear();
+    out->reserve(segment->data.size() + 1024 + samples.size() * 16);
+
+    gsize box = begin_box(out, "ftyp");
+    out->insert(out->end(), {'i', 's', 'o', 'm'});
+    put_u32(out, 0x200);
+    out->insert(out->end(), {'i', 's', 'o', 'm', 'i', 's', 'o', '2', 'm', 'p', '4', '1'});
+    end_box(out, box);
+
+    gsize moov = begin_box(out, "moov");
+
+    box = begin_full_box(out, "mvhd", 0, 0);
+    put_u32(out, 0);                                // creation_time
+    put_u32(out, 0);                                // modification_time
+    put_u32(out, TIMESCALE);
+    put_u32(out, duration);
+    put_u32(out, 0x00010000);                       // rate
+    put_u16(out, 0x0100);                           // volume
+    put_zeros(out, 10);
+    for (guint32 value : identity_matrix) {
+        put_u32(out, value);
+    }
+    put_zeros(out, 24);
+    put_u32(out, 2);                                // next_track_ID
+    end_box(out, box);
+
+    gsize trak = begin_box(out, "trak");
+
+    box = begin_full_box(out, "tkhd", 0, 0x000003); // enabled, in movie
+    put_u32(out, 0);
+    put_u32(out, 0);
+    put_u32(out, 1);                                // track_ID
+    put_u32(out, 0);
+    put_u32(out, duration);
+    put_zeros(out, 16);                             // reserved, layer, group, volume
+    for (guint32 value : identity_matrix) {
+        put_u32(out, value);
+    }
+    put_u32(out, segment->width << 16);
+    put_u32(out, segment->height << 16);
+    end_box(out, box);
+
+    gsize mdia = begin_box(out, "mdia");
+
+    box = begin_full_box(out, "mdhd", 0, 0);
+    put_u32(out, 0);
+    put_u32(out, 0);
+    put_u32(out, TIMESCALE);
+    put_u32(out, duration);
+    put_u16(out, 0x55c4);                           // "und"
+    put_u16(out, 0);
+    end_box(out, box);
+
+    box = begin_full_box(out, "hdlr", 0, 0);
+    put_u32(out, 0);
+    out->insert(out->end(), {'v', 'i', 'd', 'e'});
+    put_zeros(out, 12);
+    out->insert(out->end(), {'V', 'i', 'd', 'e', 'o', 'H', 'a', 'n', 'd', 'l', 'e', 'r', 0});
+    end_box(out, box);
+
+    gsize minf = begin_box(out, "minf");
+
+    box = begin_full_box(out, "vmhd", 0, 1);
+    put_zeros(out, 8);
+    end_box(out, box);
+
+    gsize dinf = begin_box(out, "dinf");
+    box = begin_full_box(out, "dref", 0, 0);
+    put_u32(out, 1);
+    gsize url = begin_full_box(out, "url ", 0, 1);  // Media is in this file
+    end_box(out, url);
+    end_box(out, box);
+    end_box(out, dinf);
+
+    gsize chunk_offset_at = write_sample_table(out, segment, durations);
+
+    end_box(out, minf);
+    end_box(out, mdia);
+    end_box(out, trak);
+    end_box(out, moov);
+
+    box = begin_box(out, "mdat");
+    set_u32(out, chunk_offset_at, out->size());
+    put_bytes(out, segment->data);
+    end_box(out, box);
+
+    return TRUE;
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef __RERUN_MP4_H__
+#define __RERUN_MP4_H__
+
+#include <gst/gst.h>
+
+#include <cstdint>
+#include <vector>
+
+typedef enum {
+  RERUN_MP4_CODEC_H264,
+  RERUN_MP4_CODEC_H265,
+} RerunMp4Codec;
+
+typedef struct {
+  gsize offset;               // First length prefix of the sample in data
+  gsize size;
+  GstClockTime pts;
+  GstClockTime dts;
+  gboolean keyframe;
+} RerunMp4Sample;
+
+// Access units starting at a keyframe, written out as a small standalone
+// MP4 file (ftyp, moov, mdat) that Rerun can log as an AssetVideo. Samples
+// are stored with 4-byte length prefixes and without parameter sets or
+// delimiters; the parameter sets go to the avcC/hvcC record instead.
+typedef struct {
+  RerunMp4Codec codec;
+  guint width;
+  guint height;
+
+  std::vector<std::uint8_t> vps;   // H.265 only
+  std::vector<std::uint8_t> sps;
+  std::vector<std::uint8_t> pps;
+
+  std::vector<std::uint8_t> data;
+  std::vector<RerunMp4Sample> samples;
+
+  std::vector<std::uint8_t> file;  // Output of the last write, reused
+} RerunMp4Segment;
+
+// Drops the samples, keeping parameter sets and allocated memory
+void rerun_mp4_segment_clear(RerunMp4Segment* segment);
+
+// Appends an Annex-B access unit. Parameter sets found in it replace the
+// segment's. Timestamps must be valid, and decode timestamps increasing;
+// a DTS that goes back is nudged forward.
+void rerun_mp4_segment_add(
+    RerunMp4Segment* segment,
+    const guint8* data,
+    gsize size,
+    GstClockTime pts,
+    GstClockTime dts,
+    gboolean keyframe);
+
+// Decode time covered so far, not counting the last sample's duration
+GstClockTime rerun_mp4_segment_span(const RerunMp4Segment* segment);
+
+// Writes the segment to segment->file. @last_duration is how long the
+// final sample lasts, GST_CLOCK_TIME_NONE repeats the previous one.
+// Returns FALSE if there are no samples or parameter sets are missing.
+gboolean rerun_mp4_segment_write(RerunMp4Segment* segment, GstClockTime last_duration);
+
+#endif // __RERUN_MP4_H__
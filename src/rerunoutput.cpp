@@ -0,0 +1,987 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "rerunoutput.hpp"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <deque>
+#include <map>
+#include <string>
+
+GST_DEBUG_CATEGORY_STATIC(rerun_output_debug);
+#define GST_CAT_DEFAULT rerun_output_debug
+
+// Sinks a single stream can be given, bounded because set_sinks() takes
+// them as template arguments
+#define MAX_SINKS_PER_STREAM 4
+
+// How often the size of a rotating file is looked at, and how long to wait
+// before trying again when a new file could not be opened
+#define SIZE_CHECK_INTERVAL (G_USEC_PER_SEC / 2)
+#define ROTATE_RETRY_INTERVAL (5 * G_USEC_PER_SEC)
+
+// A file written by a rotating output
+typedef struct {
+  gchar* path;
+  GstClockTime start;         // Running time of the first and last frame in the file
+  GstClockTime end;
+  GDateTime* opened;
+  GDateTime* closed;          // NULL while being written
+  guint64 size;
+} RerunOutputFile;
+
+typedef struct {
+  gchar* location;            // strftime template
+  guint64 max_size;
+  GstClockTime max_duration;
+  guint max_files;
+  gchar* index;
+  RerunDiskWriterOptions writer;
+  std::deque<RerunOutputFile> files;  // Oldest first, the last one is being written
+  gint64 next_check;          // Monotonic time of the next size check or retry
+  gboolean due;               // Waiting for a boundary to move on to a new file
+} RerunOutputRotation;
+
+// Outputs that share a rate, and the stream feeding them
+typedef struct {
+  gdouble max_fps;
+  guint keep_every;
+  gboolean block;                 // One of the outputs has policy=block
+  std::vector<const RerunOutput*> outputs;
+  rerun::RecordingStream* stream;
+  RerunOutputRotation* rotation;  // Rotating file, always alone in its group
+  std::vector<RerunPipe*> pipes;  // Byte stream outputs, written to as files
+  std::vector<RerunDiskWriter*> writers;  // Draining the pipes of files with a disk writer
+  guint rotations;                // Files the rotating file moved on to so far
+} RerunOutputGroup;
+
+struct _RerunOutputSet {
+  std::vector<RerunOutputGroup> groups;
+
+  // Rotation state is shared by every sink using the set
+  gboolean rotating;
+  GMutex rotate_lock;
+
+  std::string key;            // Empty when the set is not shared
+  guint refcount;             // Protected by registry_lock
+};
+
+// Sets that sinks may share, by key
+static GMutex registry_lock;
+static std::map<std::string, RerunOutputSet*>* registry = nullptr;
+
+static void rerun_output_init_debug(void) {
+    static gsize initialized = 0;
+
+    if (g_once_init_enter(&initialized)) {
+        GST_DEBUG_CATEGORY_INIT(rerun_output_debug, "rerunoutput", 0, "Rerun sink outputs");
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
+// "max-fps=5" parses as an int and "max-fps=7.5" as a double
+static gboolean get_number(const GstStructure* structure, const gchar* field, gdouble* value) {
+    gint integer;
+
+    if (gst_structure_get_double(structure, field, value)) {
+        return TRUE;
+    }
+    if (gst_structure_get_int(structure, field, &integer)) {
+        *value = integer;
+        return TRUE;
+    }
+    return !gst_structure_has_field(structure, field);
+}
+
+static gboolean parse_output(const gchar* text, RerunOutput* output, GError** error) {
+    GstStructure* structure = gst_structure_from_string(text, NULL);
+    if (!structure) {
+        g_set_error(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS, "Invalid output \"%s\"", text);
+        return FALSE;
+    }
+
+    gboolean ret = TRUE;
+    gdouble keep_every = 0.0;
+    gdouble rotate_size = 0.0;
+    gdouble rotate_duration = 0.0;
+    gdouble max_files = 0.0;
+    gdouble write_size = 0.0;
+    gdouble preallocate = 0.0;
+    gdouble sync_interval = 0.0;
+
+    output->target = NULL;
+    output->fd = -1;
+    output->max_fps = 0.0;
+    output->keep_every = 0;
+    output->block = FALSE;
+    output->rotate_size = 0;
+    output->rotate_duration = 0;
+    output->max_files = 0;
+    output->index = NULL;
+    output->writer = { 0, 0, FALSE, 0 };
+
+    if (gst_structure_has_name(structure, "file")) {
+        output->kind = RERUN_OUTPUT_FILE;
+        output->target = g_strdup(gst_structure_get_string(structure, "location"));
+        ret = output->target != NULL;
+    } else if (gst_structure_has_name(structure, "grpc")) {
+        output->kind = RERUN_OUTPUT_GRPC;
+        const gchar* url = gst_structure_get_string(structure, "url");
+        output->target = g_strdup(url ? url : rerun::GrpcSink().url.c_str());
+    } else if (gst_structure_has_name(structure, "spawn")) {
+        output->kind = RERUN_OUTPUT_SPAWN;
+    } else if (gst_structure_has_name(structure, "stdout")) {
+        output->kind = RERUN_OUTPUT_STDOUT;
+        output->fd = STDOUT_FILENO;
+    } else if (gst_structure_has_name(structure, "fd")) {
+        output->kind = RERUN_OUTPUT_FD;
+        ret = gst_structure_get_int(structure, "fd", &output->fd) && output->fd >= 0;
+    } else if (gst_structure_has_name(structure, "callback")) {
+        output->kind = RERUN_OUTPUT_CALLBACK;
+    } else {
+        ret = FALSE;
+    }
+
+    // keep-every counts frames, so a fraction of one is refused rather than cut
+    ret = ret && get_number(structure, "max-fps", &output->max_fps) && output->max_fps >= 0.0 &&
+          get_number(structure, "keep-every", &keep_every) && keep_every >= 0.0 &&
+          keep_every <= G_MAXUINT && keep_every == (guint)keep_every;
+    output->keep_every = ret ? (guint)keep_every : 0;
+
+    const gchar* policy = gst_structure_get_string(structure, "policy");
+    if (ret && gst_structure_has_field(structure, "policy")) {
+        ret = g_strcmp0(policy, "block") == 0 || g_strcmp0(policy, "drop") == 0;
+        output->block = g_strcmp0(policy, "block") == 0;
+    }
+
+    if (ret && output->kind == RERUN_OUTPUT_FILE) {
+        ret = get_number(structure, "rotate-size", &rotate_size) && rotate_size >= 0.0 &&
+              get_number(structure, "rotate-duration", &rotate_duration) && rotate_duration >= 0.0 &&
+              get_number(structure, "max-files", &max_files) && max_files >= 0.0;
+        output->rotate_size = (guint64)(rotate_size * 1024 * 1024);
+        output->rotate_duration = (GstClockTime)(rotate_duration * GST_SECOND);
+        output->max_files = (guint)max_files;
+        output->index = g_strdup(gst_structure_get_string(structure, "index"));
+
+        ret = ret && get_number(structure, "write-size", &write_size) && write_size >= 0.0 &&
+              get_number(structure, "preallocate", &preallocate) && preallocate >= 0.0 &&
+              get_number(structure, "sync-interval", &sync_interval) && sync_interval >= 0.0;
+        output->writer.write_size = (gsize)(write_size * 1024);
+        output->writer.preallocate = (guint64)(preallocate * 1024 * 1024);
+        output->writer.sync_interval = (GstClockTime)(sync_interval * GST_SECOND);
+
+        if (gst_structure_has_field(structure, "direct-io")) {
+            ret = ret && gst_structure_get_boolean(structure, "direct-io", &output->writer.direct);
+        }
+    } else if (ret) {
+        ret = !gst_structure_has_field(structure, "rotate-size") &&
+              !gst_structure_has_field(structure, "rotate-duration") &&
+              !gst_structure_has_field(structure, "max-files") &&
+              !gst_structure_has_field(structure, "index") &&
+              !gst_structure_has_field(structure, "write-size") &&
+              !gst_structure_has_field(structure, "preallocate") &&
+              !gst_structure_has_field(structure, "direct-io") &&
+              !gst_structure_has_field(structure, "sync-interval");
+    }
+
+    if (!ret) {
+        g_set_error(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS, "Invalid output \"%s\"", text);
+        g_free(output->target);
+        output->target = NULL;
+        g_free(output->index);
+        output->index = NULL;
+    }
+
+    gst_structure_free(structure);
+    return ret;
+}
+
+gboolean rerun_output_parse(const gchar* description, std::vector<RerunOutput>* outputs, GError** error) {
+    gchar** entries = g_strsplit(description, ";", -1);
+    gboolean ret = TRUE;
+
+    for (gchar** entry = entries; ret && *entry; entry++) {
+        const gchar* text = g_strstrip(*entry);
+        RerunOutput output;
+
+        if (*text == '\0') {
+            continue;
+        }
+
+        ret = parse_output(text, &output, error);
+        if (ret) {
+            outputs->push_back(output);
+        }
+    }
+
+    g_strfreev(entries);
+    return ret;
+}
+
+void rerun_output_clear(std::vector<RerunOutput>* outputs) {
+    for (RerunOutput& output : *outputs) {
+        g_free(output.target);
+        g_free(output.index);
+    }
+    outputs->clear();
+}
+
+static void rerun_output_file_clear(RerunOutputFile* file) {
+    g_free(file->path);
+    g_date_time_unref(file->opened);
+    if (file->closed) {
+        g_date_time_unref(file->closed);
+    }
+}
+
+// Expands the template for a file starting now. Files never overwrite one
+// another, since several may start within the same second.
+static gchar* rerun_output_rotation_next_path(const RerunOutputRotation* rotation) {
+    GDateTime* now = g_date_time_new_now_local();
+    gchar* path = g_date_time_format(now, rotation->location);
+    g_date_time_unref(now);
+
+    if (!path) {
+        GST_WARNING("Invalid file name template %s", rotation->location);
+        path = g_strdup(rotation->location);
+    }
+
+    if (!g_file_test(path, G_FILE_TEST_EXISTS)) {
+        return path;
+    }
+
+    // Numbered before the extension, if there is one in the file name
+    const gchar* extension = strrchr(path, '.');
+    if (!extension || strchr(extension, G_DIR_SEPARATOR)) {
+        extension = path + strlen(path);
+    }
+
+    gchar* numbered = NULL;
+    for (guint n = 1; !numbered || g_file_test(numbered, G_FILE_TEST_EXISTS); n++) {
+        g_free(numbered);
+        numbered = g_strdup_printf("%.*s-%u%s", (gint)(extension - path), path, n, extension);
+    }
+
+    g_free(path);
+    return numbered;
+}
+
+static guint64 get_file_size(const gchar* path) {
+    GStatBuf st;
+
+    return g_stat(path, &st) == 0 ? (guint64)st.st_size : 0;
+}
+
+static void append_json_string(GString* json, const gchar* text) {
+    g_string_append_c(json, '"');
+    for (const gchar* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            g_string_append_printf(json, "\\%c", *c);
+        } else if ((guchar)*c < 0x20) {
+            g_string_append_printf(json, "\\u%04x", (guchar)*c);
+        } else {
+            g_string_append_c(json, *c);
+        }
+    }
+    g_string_append_c(json, '"');
+}
+
+static void append_json_time(GString* json, GstClockTime time) {
+    if (GST_CLOCK_TIME_IS_VALID(time)) {
+        g_string_append_printf(json, "%" G_GUINT64_FORMAT, time);
+    } else {
+        g_string_append(json, "null");
+    }
+}
+
+static void append_json_date(GString* json, GDateTime* date) {
+    if (date) {
+        gchar* text = g_date_time_format_iso8601(date);
+        append_json_string(json, text);
+        g_free(text);
+    } else {
+        g_string_append(json, "null");
+    }
+}
+
+// Rewrites the manifest, through a rename so readers never see half of it.
+// Times are running times in nanoseconds, the running_time timeline of the
+// recording.
+static void rerun_output_rotation_write_index(const RerunOutputRotation* rotation) {
+    if (!rotation->index) {
+        return;
+    }
+
+    GString* json = g_string_new("{\n  \"files\": [");
+
+    for (gsize i = 0; i < rotation->files.size(); i++) {
+        const RerunOutputFile* file = &rotation->files[i];
+
+        g_string_append(json, i ? ",\n    { \"path\": " : "\n    { \"path\": ");
+        append_json_string(json, file->path);
+        g_string_append(json, ", \"start\": ");
+        append_json_time(json, file->start);
+        g_string_append(json, ", \"end\": ");
+        append_json_time(json, file->end);
+        g_string_append(json, ", \"opened\": ");
+        append_json_date(json, file->opened);
+        g_string_append(json, ", \"closed\": ");
+        append_json_date(json, file->closed);
+        g_string_append_printf(json, ", \"size\": %" G_GUINT64_FORMAT " }", file->size);
+    }
+    g_string_append(json, "\n  ]\n}\n");
+
+    GError* error = NULL;
+    if (!g_file_set_contents(rotation->index, json->str, json->len, &error)) {
+        GST_WARNING("Failed to write index %s: %s", rotation->index, error->message);
+        g_error_free(error);
+    }
+
+    g_string_free(json, TRUE);
+}
+
+static void rerun_output_rotation_push(RerunOutputRotation* rotation, gchar* path) {
+    rotation->files.push_back({ path, GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE,
+                                g_date_time_new_now_local(), NULL, 0 });
+}
+
+// Called once the stream no longer writes to the current file
+static void rerun_output_rotation_close(RerunOutputRotation* rotation) {
+    RerunOutputFile* file = &rotation->files.back();
+
+    file->closed = g_date_time_new_now_local();
+    file->size = get_file_size(file->path);
+}
+
+// Deletes the oldest files until at most max_files are left
+static void rerun_output_rotation_expire(RerunOutputRotation* rotation) {
+    while (rotation->max_files && rotation->files.size() > rotation->max_files) {
+        RerunOutputFile* file = &rotation->files.front();
+
+        GST_INFO("Deleting %s, keeping %u files", file->path, rotation->max_files);
+        if (g_unlink(file->path) != 0) {
+            GST_WARNING("Failed to delete %s: %s", file->path, g_strerror(errno));
+        }
+
+        rerun_output_file_clear(file);
+        rotation->files.pop_front();
+    }
+}
+
+static RerunOutputRotation* rerun_output_rotation_new(const RerunOutput* output) {
+    RerunOutputRotation* rotation = new RerunOutputRotation();
+
+    rotation->location = g_strdup(output->target);
+    rotation->max_size = output->rotate_size;
+    rotation->max_duration = output->rotate_duration;
+    rotation->max_files = output->max_files;
+    rotation->index = g_strdup(output->index);
+    rotation->writer = output->writer;
+    rotation->next_check = 0;
+    rotation->due = FALSE;
+    rerun_output_rotation_push(rotation, rerun_output_rotation_next_path(rotation));
+
+    return rotation;
+}
+
+static void rerun_output_rotation_free(RerunOutputRotation* rotation) {
+    for (RerunOutputFile& file : rotation->files) {
+        rerun_output_file_clear(&file);
+    }
+    g_free(rotation->location);
+    g_free(rotation->index);
+    delete rotation;
+}
+
+static gboolean rerun_output_rotation_due(RerunOutputRotation* rotation, GstClockTime running_time) {
+    const RerunOutputFile* file = &rotation->files.back();
+    gint64 now = g_get_monotonic_time();
+
+    if (now < rotation->next_check) {
+        return FALSE;
+    }
+
+    if (rotation->max_duration && GST_CLOCK_TIME_IS_VALID(file->start) && GST_CLOCK_TIME_IS_VALID(running_time) &&
+        running_time >= file->start + rotation->max_duration) {
+        return TRUE;
+    }
+
+    // The writer runs behind the stream, so a file ends up slightly larger
+    if (rotation->max_size) {
+        rotation->next_check = now + SIZE_CHECK_INTERVAL;
+        return get_file_size(file->path) >= rotation->max_size;
+    }
+
+    return FALSE;
+}
+
+// Files with a disk writer are written by Rerun to a pipe the writer
+// drains, so the file only sees large aligned writes and Rerun's writer
+// only waits on the disk once every batch of the writer does
+static RerunPipe* rerun_output_open_disk_writer(
+    const gchar* path,
+    const RerunDiskWriterOptions* options,
+    RerunDiskWriter** writer,
+    GError** error) {
+
+    *writer = rerun_disk_writer_new(path, options, error);
+    if (!*writer) {
+        return NULL;
+    }
+
+    RerunPipe* pipe = rerun_pipe_new("rerunsink-file", rerun_disk_writer_write, *writer, error);
+    if (!pipe) {
+        rerun_disk_writer_free(*writer);
+        *writer = NULL;
+    }
+
+    return pipe;
+}
+
+// Points the stream at a new file. Swapping the stream's sink flushes the
+// old file first, so no data falls between the two.
+static gboolean rerun_output_group_rotate(RerunOutputGroup* group) {
+    RerunOutputRotation* rotation = group->rotation;
+    gchar* path = rerun_output_rotation_next_path(rotation);
+    RerunDiskWriter* writer = NULL;
+    RerunPipe* pipe = NULL;
+    gchar* reason = NULL;
+
+    if (group->writers[0]) {
+        GError* error = NULL;
+
+        pipe = rerun_output_open_disk_writer(path, &rotation->writer, &writer, &error);
+        if (pipe) {
+            rerun::Error err = group->stream->save(rerun_pipe_get_path(pipe));
+            rerun_pipe_close_writer(pipe);
+            reason = err.is_err() ? g_strdup(err.description.c_str()) : NULL;
+        } else {
+            reason = g_strdup(error->message);
+            g_error_free(error);
+        }
+    } else {
+        rerun::Error err = group->stream->save(path);
+        reason = err.is_err() ? g_strdup(err.description.c_str()) : NULL;
+    }
+
+    if (reason) {
+        GST_WARNING("Failed to start %s, still writing %s: %s", path, rotation->files.back().path, reason);
+        rotation->next_check = g_get_monotonic_time() + ROTATE_RETRY_INTERVAL;
+
+        // The writer already created the file
+        if (pipe) {
+            rerun_pipe_free(pipe);
+            rerun_disk_writer_free(writer);
+            g_unlink(path);
+        }
+
+        g_free(reason);
+        g_free(path);
+        return FALSE;
+    }
+
+    // The old file is complete once its pipe was drained to disk
+    if (pipe) {
+        rerun_pipe_free(group->pipes[0]);
+        rerun_disk_writer_free(group->writers[0]);
+        group->pipes[0] = pipe;
+        group->writers[0] = writer;
+    }
+
+    rerun_output_rotation_close(rotation);
+    GST_INFO("Rotated %s (%" G_GUINT64_FORMAT " bytes) to %s", rotation->files.back().path,
+             rotation->files.back().size, path);
+
+    rerun_output_rotation_push(rotation, path);
+    rerun_output_rotation_expire(rotation);
+    rerun_output_rotation_write_index(rotation);
+
+    return TRUE;
+}
+
+// Turns the group's outputs into set_sinks() arguments one at a time
+template <typename... Sinks>
+static rerun::Error set_sinks(const RerunOutputGroup* group, gsize next, const Sinks&... sinks) {
+    if (next == group->outputs.size()) {
+        return group->stream->set_sinks(sinks...);
+    }
+
+    if constexpr (sizeof...(Sinks) < MAX_SINKS_PER_STREAM) {
+        const RerunOutput* output = group->outputs[next];
+
+        // A spawned viewer listens on the default gRPC address
+        if (group->pipes[next]) {
+            return set_sinks(group, next + 1, sinks..., rerun::FileSink{rerun_pipe_get_path(group->pipes[next])});
+        } else if (output->kind == RERUN_OUTPUT_FILE) {
+            const gchar* path = group->rotation ? group->rotation->files.back().path : output->target;
+            return set_sinks(group, next + 1, sinks..., rerun::FileSink{path});
+        } else if (output->kind == RERUN_OUTPUT_GRPC) {
+            return set_sinks(group, next + 1, sinks..., rerun::GrpcSink{output->target});
+        } else {
+            return set_sinks(group, next + 1, sinks..., rerun::GrpcSink());
+        }
+    } else {
+        // Groups are limited to MAX_SINKS_PER_STREAM when they are built
+        return rerun::Error();
+    }
+}
+
+static gchar* rerun_output_describe(const RerunOutput* output, const RerunOutputGroup* group) {
+    switch (output->kind) {
+        case RERUN_OUTPUT_FILE:
+            return g_strdup(group->rotation ? group->rotation->files.back().path : output->target);
+        case RERUN_OUTPUT_GRPC:
+            return g_strdup(output->target);
+        case RERUN_OUTPUT_SPAWN:
+            return g_strdup("spawned viewer");
+        case RERUN_OUTPUT_STDOUT:
+            return g_strdup("standard output");
+        case RERUN_OUTPUT_FD:
+            return g_strdup_printf("descriptor %d", output->fd);
+        default:
+            return g_strdup("callback");
+    }
+}
+
+// The FileSink writing an output's byte stream goes through a pipe, since
+// Rerun can only write it to paths. Descriptors are written to from the
+// pipe's thread, so sockets work too and a slow consumer only holds up
+// Rerun's own writer.
+static RerunPipe* rerun_output_open_pipe(
+    const RerunOutput* output,
+    RerunPipeFunc callback,
+    gpointer user_data,
+    GError** error) {
+
+    switch (output->kind) {
+        case RERUN_OUTPUT_STDOUT:
+        case RERUN_OUTPUT_FD:
+            return rerun_pipe_new_for_fd("rerunsink-fd", output->fd, error);
+
+        case RERUN_OUTPUT_CALLBACK:
+            if (!callback) {
+                g_set_error(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS, "No callback for callback output");
+                return NULL;
+            }
+            return rerun_pipe_new("rerunsink-callback", callback, user_data, error);
+
+        default:
+            return NULL;
+    }
+}
+
+RerunOutputSet* rerun_output_set_new(
+    const gchar* recording_id,
+    const std::vector<RerunOutput>& outputs,
+    RerunPipeFunc callback,
+    gpointer user_data,
+    GError** error) {
+
+    rerun_output_init_debug();
+
+    RerunOutputSet* set = new RerunOutputSet();
+    gboolean spawn = FALSE;
+
+    set->rotating = FALSE;
+    g_mutex_init(&set->rotate_lock);
+    set->refcount = 1;
+
+    for (const RerunOutput& output : outputs) {
+        RerunOutputGroup* group = NULL;
+        guint keep_every = MAX(output.keep_every, 1u);
+        gboolean rotating = output.kind == RERUN_OUTPUT_FILE && (output.rotate_size || output.rotate_duration);
+
+        // A rotating file swaps the sink of its stream, which must not take
+        // other outputs along
+        for (RerunOutputGroup& candidate : set->groups) {
+            if (!rotating && !candidate.rotation &&
+                candidate.max_fps == output.max_fps && candidate.keep_every == keep_every) {
+                group = &candidate;
+            }
+        }
+
+        if (!group) {
+            if (set->groups.size() == RERUN_OUTPUT_MAX_STREAMS) {
+                g_set_error(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS, "Too many output streams");
+                rerun_output_set_free(set);
+                return NULL;
+            }
+            set->groups.push_back({ output.max_fps, keep_every, FALSE, {}, nullptr,
+                                    rotating ? rerun_output_rotation_new(&output) : nullptr, {}, {}, 0 });
+            group = &set->groups.back();
+            set->rotating = set->rotating || rotating;
+        }
+
+        if (group->outputs.size() == MAX_SINKS_PER_STREAM) {
+            g_set_error(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS,
+                        "More than %d outputs at the same rate", MAX_SINKS_PER_STREAM);
+            rerun_output_set_free(set);
+            return NULL;
+        }
+
+        gboolean piped = output.kind == RERUN_OUTPUT_STDOUT || output.kind == RERUN_OUTPUT_FD ||
+                         output.kind == RERUN_OUTPUT_CALLBACK;
+        gboolean buffered = output.kind == RERUN_OUTPUT_FILE && rerun_disk_writer_options_enabled(&output.writer);
+        RerunPipe* pipe = NULL;
+        RerunDiskWriter* writer = NULL;
+
+        if (piped) {
+            pipe = rerun_output_open_pipe(&output, callback, user_data, error);
+        } else if (buffered) {
+            const gchar* path = group->rotation ? group->rotation->files.back().path : output.target;
+            pipe = rerun_output_open_disk_writer(path, &output.writer, &writer, error);
+        }
+
+        if ((piped || buffered) && !pipe) {
+            rerun_output_set_free(set);
+            return NULL;
+        }
+
+        group->block = group->block || output.block;
+        group->outputs.push_back(&output);
+        group->pipes.push_back(pipe);
+        group->writers.push_back(writer);
+        spawn = spawn || output.kind == RERUN_OUTPUT_SPAWN;
+    }
+
+    if (spawn) {
+        rerun::Error err = rerun::spawn();
+        if (err.is_err()) {
+            g_set_error(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_FAILED, "Failed to spawn the viewer: %s",
+                        err.description.c_str());
+            rerun_output_set_free(set);
+            return NULL;
+        }
+    }
+
+    // Streams at different rates still make up a single recording
+    gchar* shared_id = set->groups.size() > 1 ? g_uuid_string_random() : NULL;
+
+    for (RerunOutputGroup& group : set->groups) {
+        group.stream = shared_id ? new rerun::RecordingStream(recording_id, shared_id) :
+                                   new rerun::RecordingStream(recording_id);
+
+        rerun::Error err = set_sinks(&group, 0);
+
+        // Rerun holds the write ends of the pipes now, or never will
+        for (RerunPipe* pipe : group.pipes) {
+            if (pipe) {
+                rerun_pipe_close_writer(pipe);
+            }
+        }
+
+        if (err.is_err()) {
+            g_set_error(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_OPEN_WRITE, "Failed to open outputs: %s",
+                        err.description.c_str());
+            g_free(shared_id);
+            rerun_output_set_free(set);
+            return NULL;
+        }
+
+        for (const RerunOutput* output : group.outputs) {
+            gchar* description = rerun_output_describe(output, &group);
+            GST_INFO("Output %s at %.2f fps, keeping 1 of %u frames, %s when behind", description, group.max_fps,
+                     group.keep_every, output->block ? "blocking" : "dropping");
+            g_free(description);
+        }
+
+        if (group.rotation) {
+            rerun_output_rotation_write_index(group.rotation);
+        }
+
+        // Only needed to open the sinks, @outputs may go away after this
+        group.outputs.clear();
+    }
+
+    g_free(shared_id);
+
+    return set;
+}
+
+// Everything that makes two sets write the same data to the same places
+static gboolean rerun_output_set_key(const gchar* recording_id, const std::vector<RerunOutput>& outputs,
+                                     std::string* key) {
+    GString* text = g_string_new(recording_id);
+
+    for (const RerunOutput& output : outputs) {
+        if (output.kind == RERUN_OUTPUT_CALLBACK) {
+            g_string_free(text, TRUE);
+            return FALSE;
+        }
+
+        g_string_append_printf(text, "\n%d %s %d %g %u %d %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %u %s",
+                               output.kind, output.target ? output.target : "", output.fd, output.max_fps,
+                               output.keep_every, output.block, output.rotate_size, output.rotate_duration, output.max_files,
+                               output.index ? output.index : "");
+        g_string_append_printf(text, " %" G_GSIZE_FORMAT " %" G_GUINT64_FORMAT " %d %" G_GUINT64_FORMAT,
+                               output.writer.write_size, output.writer.preallocate, output.writer.direct,
+                               output.writer.sync_interval);
+    }
+
+    *key = text->str;
+    g_string_free(text, TRUE);
+    return TRUE;
+}
+
+RerunOutputSet* rerun_output_set_acquire(
+    const gchar* recording_id,
+    const std::vector<RerunOutput>& outputs,
+    RerunPipeFunc callback,
+    gpointer user_data,
+    GError** error) {
+
+    rerun_output_init_debug();
+
+    std::string key;
+    gboolean shared = rerun_output_set_key(recording_id, outputs, &key);
+    RerunOutputSet* set = NULL;
+
+    // Held while opening, so sinks starting together still end up sharing
+    g_mutex_lock(&registry_lock);
+
+    if (shared && registry) {
+        auto it = registry->find(key);
+        if (it != registry->end()) {
+            set = it->second;
+            set->refcount++;
+            GST_INFO("Sharing the outputs of recording %s with %u other sinks", recording_id, set->refcount - 1);
+        }
+    }
+
+    if (!set) {
+        set = rerun_output_set_new(recording_id, outputs, callback, user_data, error);
+
+        if (set && shared) {
+            if (!registry) {
+                registry = new std::map<std::string, RerunOutputSet*>();
+            }
+            set->key = key;
+            (*registry)[key] = set;
+        }
+    }
+
+    g_mutex_unlock(&registry_lock);
+
+    return set;
+}
+
+void rerun_output_set_release(RerunOutputSet* set) {
+    g_mutex_lock(&registry_lock);
+
+    if (--set->refcount > 0) {
+        g_mutex_unlock(&registry_lock);
+        return;
+    }
+    if (!set->key.empty()) {
+        registry->erase(set->key);
+    }
+
+    g_mutex_unlock(&registry_lock);
+
+    rerun_output_set_free(set);
+}
+
+guint rerun_output_set_get_n_streams(const RerunOutputSet* set) {
+    return set->groups.size();
+}
+
+const rerun::RecordingStream* rerun_output_set_get_stream(const RerunOutputSet* set, guint index) {
+    return set->groups[index].stream;
+}
+
+guint rerun_output_set_all(const RerunOutputSet* set) {
+    return set->groups.size() == RERUN_OUTPUT_MAX_STREAMS ? G_MAXUINT : (1u << set->groups.size()) - 1;
+}
+
+guint rerun_output_set_get_blocking(const RerunOutputSet* set) {
+    guint mask = 0;
+
+    for (gsize i = 0; i < set->groups.size(); i++) {
+        if (set->groups[i].block) {
+            mask |= 1u << i;
+        }
+    }
+
+    return mask;
+}
+
+void rerun_output_pacing_reset(RerunOutputPacing* pacing) {
+    for (guint i = 0; i < RERUN_OUTPUT_MAX_STREAMS; i++) {
+        pacing->next_log_time[i] = GST_CLOCK_TIME_NONE;
+    }
+}
+
+void rerun_output_cursor_reset(RerunOutputCursor* cursor) {
+    for (guint i = 0; i < RERUN_OUTPUT_MAX_STREAMS; i++) {
+        cursor->rotations[i] = 0;
+    }
+}
+
+// Same deadline scheme as the sink's own max-fps: deadlines advance by whole
+// intervals, with half an interval of slack for timestamp jitter, and
+// restart from the current frame after a gap
+static gboolean rerun_output_group_admit(
+    const RerunOutputGroup* group,
+    GstClockTime* next_log_time,
+    guint64 index,
+    GstClockTime running_time) {
+
+    if (group->keep_every > 1 && index % group->keep_every != 0) {
+        return FALSE;
+    }
+
+    if (group->max_fps <= 0.0 || !GST_CLOCK_TIME_IS_VALID(running_time)) {
+        return TRUE;
+    }
+
+    GstClockTime interval = (GstClockTime)(GST_SECOND / group->max_fps);
+
+    if (GST_CLOCK_TIME_IS_VALID(*next_log_time) && running_time + interval / 2 < *next_log_time) {
+        return FALSE;
+    }
+
+    if (!GST_CLOCK_TIME_IS_VALID(*next_log_time) || running_time >= *next_log_time + interval) {
+        *next_log_time = running_time + interval;
+    } else {
+        *next_log_time += interval;
+    }
+
+    return TRUE;
+}
+
+guint rerun_output_set_admit(
+    const RerunOutputSet* set,
+    RerunOutputPacing* pacing,
+    guint64 index,
+    GstClockTime running_time) {
+
+    guint mask = 0;
+
+    for (gsize i = 0; i < set->groups.size(); i++) {
+        if (rerun_output_group_admit(&set->groups[i], &pacing->next_log_time[i], index, running_time)) {
+            mask |= 1u << i;
+        }
+    }
+
+    return mask;
+}
+
+guint rerun_output_set_rotate(
+    RerunOutputSet* set,
+    RerunOutputCursor* cursor,
+    GstClockTime running_time,
+    gboolean boundary,
+    gboolean* due) {
+
+    guint rotated = 0;
+
+    if (due) {
+        *due = FALSE;
+    }
+
+    if (!set->rotating) {
+        return 0;
+    }
+
+    g_mutex_lock(&set->rotate_lock);
+
+    for (gsize i = 0; i < set->groups.size(); i++) {
+        RerunOutputGroup* group = &set->groups[i];
+        RerunOutputRotation* rotation = group->rotation;
+        if (!rotation) {
+            continue;
+        }
+
+        // Due is remembered until a boundary comes, which may be a GOP away.
+        // The frame that triggers a rotation is the first of the new file; a
+        // failed one is retried once the next check says so.
+        if (!rotation->due) {
+            rotation->due = rerun_output_rotation_due(rotation, running_time);
+        }
+        if (rotation->due && boundary) {
+            rotation->due = FALSE;
+            if (rerun_output_group_rotate(group)) {
+                group->rotations++;
+            }
+        }
+        if (rotation->due && due) {
+            *due = TRUE;
+        }
+
+        if (cursor->rotations[i] != group->rotations) {
+            cursor->rotations[i] = group->rotations;
+            rotated |= 1u << i;
+        }
+
+        // Sinks sharing the set log their frames interleaved
+        RerunOutputFile* file = &rotation->files.back();
+        if (GST_CLOCK_TIME_IS_VALID(running_time)) {
+            if (!GST_CLOCK_TIME_IS_VALID(file->start) || running_time < file->start) {
+                file->start = running_time;
+            }
+            if (!GST_CLOCK_TIME_IS_VALID(file->end) || running_time > file->end) {
+                file->end = running_time;
+            }
+        }
+    }
+
+    g_mutex_unlock(&set->rotate_lock);
+
+    return rotated;
+}
+
+void rerun_output_set_free(RerunOutputSet* set) {
+    for (RerunOutputGroup& group : set->groups) {
+        // Without a stream nothing was written to the rotation's first file
+        gboolean opened = group.stream != nullptr;
+        delete group.stream;
+        group.stream = nullptr;
+
+        // Returns once the closed stream's last bytes were delivered, and
+        // written out by the disk writers
+        for (RerunPipe* pipe : group.pipes) {
+            if (pipe) {
+                rerun_pipe_free(pipe);
+            }
+        }
+        for (RerunDiskWriter* writer : group.writers) {
+            if (writer) {
+                rerun_disk_writer_free(writer);
+            }
+        }
+
+        // The last file is complete now
+        if (group.rotation) {
+            if (opened) {
+                rerun_output_rotation_close(group.rotation);
+                rerun_output_rotation_write_index(group.rotation);
+            }
+            rerun_output_rotation_free(group.rotation);
+        }
+    }
+
+    g_mutex_clear(&set->rotate_lock);
+    delete set;
+}
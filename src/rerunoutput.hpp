@@ -0,0 +1,159 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef __RERUN_OUTPUT_H__
+#define __RERUN_OUTPUT_H__
+
+#include "rerundiskwriter.hpp"
+#include "rerunpipe.hpp"
+
+#include <gst/gst.h>
+#include <rerun.hpp>
+
+#include <vector>
+
+typedef enum {
+  RERUN_OUTPUT_FILE,          // .rrd file at target
+  RERUN_OUTPUT_GRPC,          // Viewer or server at the target URL
+  RERUN_OUTPUT_SPAWN,         // Local viewer started for the recording
+  RERUN_OUTPUT_STDOUT,        // .rrd byte stream written to standard output
+  RERUN_OUTPUT_FD,            // .rrd byte stream written to an inherited descriptor
+  RERUN_OUTPUT_CALLBACK,      // .rrd byte stream handed to the set's callback
+} RerunOutputKind;
+
+typedef struct {
+  RerunOutputKind kind;
+  gchar* target;              // Path or URL, NULL for the other kinds
+  gint fd;                    // Descriptor for stdout and fd
+  gdouble max_fps;            // Frame rate cap for this output, 0 = no cap
+  guint keep_every;           // Keep one frame out of N, 0 or 1 = all
+  gboolean block;             // Frames for it are never dropped for a full logging queue
+
+  // File rotation, with target taken as a strftime template. Only for files.
+  guint64 rotate_size;        // Bytes after which a new file is started, 0 = never
+  GstClockTime rotate_duration; // Running time after which a new file is started, 0 = never
+  guint max_files;            // Files kept, the oldest are deleted first, 0 = all
+  gchar* index;               // JSON manifest of the files written, NULL for none
+
+  // Files written by the sink's own disk writer instead of Rerun, all zero
+  // for none. Only for files.
+  RerunDiskWriterOptions writer;
+} RerunOutput;
+
+typedef struct _RerunOutputSet RerunOutputSet;
+
+// Most outputs a set can feed, one bit per stream in an output mask
+#define RERUN_OUTPUT_MAX_STREAMS 32
+
+// Rate deadlines of every stream. Kept by whoever admits frames, so frames
+// and GOPs can be paced independently.
+typedef struct {
+  GstClockTime next_log_time[RERUN_OUTPUT_MAX_STREAMS];
+} RerunOutputPacing;
+
+// Files of every stream as last seen by one user of the set, so files that
+// other sinks sharing the set moved on to are reported as well
+typedef struct {
+  guint rotations[RERUN_OUTPUT_MAX_STREAMS];
+} RerunOutputCursor;
+
+// Parses a list of outputs separated by ';', each one a GstStructure:
+//   file, location=out.rrd; grpc, url=rerun+http://host:9876/proxy, max-fps=5; spawn
+//   stdout; fd, fd=5; callback
+// Any of them takes max-fps, keep-every and policy: "drop" (the default)
+// lets the sink's queue-policy drop frames for the output when logging falls
+// behind, "block" makes the sink wait instead. Files also take rotate-size
+// (MiB), rotate-duration (seconds), max-files and index, and write-size
+// (KiB), preallocate (MiB), direct-io and sync-interval (seconds) for the
+// disk writer. Parsed outputs are appended.
+gboolean rerun_output_parse(const gchar* description, std::vector<RerunOutput>* outputs, GError** error);
+
+void rerun_output_clear(std::vector<RerunOutput>* outputs);
+
+// Opens every output. Outputs with the same rate share one RecordingStream
+// with several sinks, so what they log is encoded and sent once. Each
+// distinct rate gets its own stream, and so does every rotating file: a frame
+// logged to several streams is converted to Arrow once, but every stream
+// encodes and sends its own copy of it. Callback
+// outputs pass the byte stream to @callback, from a thread of their own.
+RerunOutputSet* rerun_output_set_new(
+    const gchar* recording_id,
+    const std::vector<RerunOutput>& outputs,
+    RerunPipeFunc callback,
+    gpointer user_data,
+    GError** error);
+
+// Same as rerun_output_set_new(), unless a set for the same recording id and
+// outputs is open in the process already: that one is shared instead, so
+// sinks feed the same streams, connections and batchers and make up a single
+// recording, kept apart by their entity paths. Sets with a callback output
+// belong to one sink and are never shared.
+RerunOutputSet* rerun_output_set_acquire(
+    const gchar* recording_id,
+    const std::vector<RerunOutput>& outputs,
+    RerunPipeFunc callback,
+    gpointer user_data,
+    GError** error);
+
+// Drops a reference taken by rerun_output_set_acquire(), closing the outputs
+// with the last one
+void rerun_output_set_release(RerunOutputSet* set);
+
+guint rerun_output_set_get_n_streams(const RerunOutputSet* set);
+
+const rerun::RecordingStream* rerun_output_set_get_stream(const RerunOutputSet* set, guint index);
+
+// Mask with a bit set for every stream
+guint rerun_output_set_all(const RerunOutputSet* set);
+
+// Mask of the streams feeding an output with policy=block
+guint rerun_output_set_get_blocking(const RerunOutputSet* set);
+
+void rerun_output_pacing_reset(RerunOutputPacing* pacing);
+
+void rerun_output_cursor_reset(RerunOutputCursor* cursor);
+
+// Mask of the streams whose rate lets the frame with @index and
+// @running_time through. Called in order for every frame paced by @pacing.
+guint rerun_output_set_admit(
+    const RerunOutputSet* set,
+    RerunOutputPacing* pacing,
+    guint64 index,
+    GstClockTime running_time);
+
+// Records that a frame at @running_time is about to be logged. At a
+// @boundary, a frame the next file can start with, rotating files that
+// reached their size or duration move on to a new file. Returns a mask of
+// the streams on a new file since @cursor last looked, which have to be
+// sent their static data again. @due, if not NULL, tells whether a file is
+// still waiting for a boundary. Called from the thread that logs.
+guint rerun_output_set_rotate(
+    RerunOutputSet* set,
+    RerunOutputCursor* cursor,
+    GstClockTime running_time,
+    gboolean boundary,
+    gboolean* due);
+
+// Flushes and closes every output
+void rerun_output_set_free(RerunOutputSet* set);
+
+#endif // __RERUN_OUTPUT_H__
@@ -0,0 +1,171 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include "rerunpipe.hpp"
+
+#include <errno.h>
+#include <glib-unix.h>
+#include <signal.h>
+#include <unistd.h>
+
+GST_DEBUG_CATEGORY_STATIC(rerun_pipe_debug);
+#define GST_CAT_DEFAULT rerun_pipe_debug
+
+// Large enough that a busy writer is drained in few reads
+#define READ_SIZE (256 * 1024)
+
+struct _RerunPipe {
+  gint read_fd;
+  gint write_fd;
+  gchar* path;
+
+  RerunPipeFunc func;
+  gpointer user_data;
+
+  // Descriptor a pipe from rerun_pipe_new_for_fd() copies the stream to,
+  // only touched by the pipe's thread
+  gint out_fd;
+  gboolean out_failed;
+
+  GThread* thread;
+};
+
+static void rerun_pipe_init_debug(void) {
+    static gsize initialized = 0;
+
+    if (g_once_init_enter(&initialized)) {
+        GST_DEBUG_CATEGORY_INIT(rerun_pipe_debug, "rerunpipe", 0, "Rerun sink byte stream pipes");
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
+static gpointer rerun_pipe_loop(gpointer data) {
+    RerunPipe* pipe = (RerunPipe*)data;
+    guint8* buffer = (guint8*)g_malloc(READ_SIZE);
+
+    // A consumer that went away shows up as EPIPE on this thread instead of
+    // a SIGPIPE taking the whole process down
+    sigset_t sigpipe;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, NULL);
+
+    for (;;) {
+        gssize size = read(pipe->read_fd, buffer, READ_SIZE);
+
+        if (size > 0) {
+            pipe->func(buffer, size, pipe->user_data);
+        } else if (size == 0) {
+            break;
+        } else if (errno != EINTR) {
+            GST_WARNING("Failed to read from %s: %s", pipe->path, g_strerror(errno));
+            break;
+        }
+    }
+
+    g_free(buffer);
+    return NULL;
+}
+
+static void rerun_pipe_write_fd(const guint8* data, gsize size, gpointer user_data) {
+    RerunPipe* pipe = (RerunPipe*)user_data;
+
+    while (size > 0 && !pipe->out_failed) {
+        gssize written = write(pipe->out_fd, data, size);
+
+        if (written >= 0) {
+            data += written;
+            size -= written;
+        } else if (errno != EINTR) {
+            GST_WARNING("Failed to write to descriptor %d, dropping the rest of the stream: %s",
+                        pipe->out_fd, g_strerror(errno));
+            pipe->out_failed = TRUE;
+        }
+    }
+}
+
+// Leaves starting the thread to rerun_pipe_start(), so the pipe itself can
+// be what it hands its function
+static RerunPipe* rerun_pipe_open(GError** error) {
+    rerun_pipe_init_debug();
+
+    gint fds[2];
+    if (!g_unix_open_pipe(fds, FD_CLOEXEC, error)) {
+        return NULL;
+    }
+
+    RerunPipe* pipe = new RerunPipe();
+    pipe->read_fd = fds[0];
+    pipe->write_fd = fds[1];
+    pipe->path = g_strdup_printf("/dev/fd/%d", pipe->write_fd);
+    pipe->out_fd = -1;
+    pipe->out_failed = FALSE;
+
+    return pipe;
+}
+
+static void rerun_pipe_start(RerunPipe* pipe, const gchar* name, RerunPipeFunc func, gpointer user_data) {
+    pipe->func = func;
+    pipe->user_data = user_data;
+    pipe->thread = g_thread_new(name, rerun_pipe_loop, pipe);
+}
+
+RerunPipe* rerun_pipe_new(const gchar* name, RerunPipeFunc func, gpointer user_data, GError** error) {
+    RerunPipe* pipe = rerun_pipe_open(error);
+
+    if (pipe) {
+        rerun_pipe_start(pipe, name, func, user_data);
+    }
+
+    return pipe;
+}
+
+RerunPipe* rerun_pipe_new_for_fd(const gchar* name, gint fd, GError** error) {
+    RerunPipe* pipe = rerun_pipe_open(error);
+
+    if (pipe) {
+        pipe->out_fd = fd;
+        rerun_pipe_start(pipe, name, rerun_pipe_write_fd, pipe);
+    }
+
+    return pipe;
+}
+
+const gchar* rerun_pipe_get_path(const RerunPipe* pipe) {
+    return pipe->path;
+}
+
+void rerun_pipe_close_writer(RerunPipe* pipe) {
+    if (pipe->write_fd >= 0) {
+        close(pipe->write_fd);
+        pipe->write_fd = -1;
+    }
+}
+
+void rerun_pipe_free(RerunPipe* pipe) {
+    rerun_pipe_close_writer(pipe);
+    g_thread_join(pipe->thread);
+
+    close(pipe->read_fd);
+    g_free(pipe->path);
+    delete pipe;
+}
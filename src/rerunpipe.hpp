@@ -0,0 +1,56 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+
+#ifndef __RERUN_PIPE_H__
+#define __RERUN_PIPE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef void (*RerunPipeFunc)(const guint8* data, gsize size, gpointer user_data);
+
+typedef struct _RerunPipe RerunPipe;
+
+// A pipe that something in this process writes to by path, with a thread
+// handing whatever arrives on the other end to @func. Lets a writer that
+// only opens files feed sockets, inherited descriptors or callbacks.
+RerunPipe* rerun_pipe_new(const gchar* name, RerunPipeFunc func, gpointer user_data, GError** error);
+
+// Path the writer opens, only valid until rerun_pipe_close_writer()
+const gchar* rerun_pipe_get_path(const RerunPipe* pipe);
+
+// Drops the pipe's own write end, once the writer opened its own, so the
+// reader sees end of file as soon as the writer is done
+void rerun_pipe_close_writer(RerunPipe* pipe);
+
+// Waits until the writer closed the pipe and every byte was handed over
+void rerun_pipe_free(RerunPipe* pipe);
+
+// A pipe whose thread writes everything to @fd, which stays open. Stops
+// writing, with a warning, once writing @fd fails.
+RerunPipe* rerun_pipe_new_for_fd(const gchar* name, gint fd, GError** error);
+
+G_END_DECLS
+
+#endif // __RERUN_PIPE_H__
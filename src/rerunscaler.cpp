@@ -0,0 +1,160 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "rerunscaler.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+gboolean rerun_scaler_supports(GstVideoFormat format, guint factor) {
+    if (factor != 2 && factor != 4) {
+        return FALSE;
+    }
+
+    switch (format) {
+        case GST_VIDEO_FORMAT_RGB:
+        case GST_VIDEO_FORMAT_RGBA:
+        case GST_VIDEO_FORMAT_GRAY8:
+        case GST_VIDEO_FORMAT_NV12:
+        case GST_VIDEO_FORMAT_I420:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+// Generic kernel: C interleaved channels, F x F blocks. Both are compile-time
+// constants so the inner loops unroll and the compiler can vectorize across
+// output pixels.
+template <guint C, guint F>
+static void downscale_row(const guint8* src, gsize src_stride, guint8* dest, guint width) {
+    for (guint x = 0; x < width; ++x) {
+        const guint8* block = src + (gsize)x * F * C;
+        for (guint c = 0; c < C; ++c) {
+            guint sum = 0;
+            for (guint dy = 0; dy < F; ++dy) {
+                const guint8* row = block + dy * src_stride + c;
+                for (guint dx = 0; dx < F; ++dx) {
+                    sum += row[dx * C];
+                }
+            }
+            dest[x * C + c] = (guint8)((sum + F * F / 2) / (F * F));
+        }
+    }
+}
+
+// Single channel 2x2, the bulk of the work for luma and grayscale planes
+template <>
+void downscale_row<1, 2>(const guint8* src, gsize src_stride, guint8* dest, guint width) {
+    const guint8* row0 = src;
+    const guint8* row1 = src + src_stride;
+    guint x = 0;
+
+#if defined(__SSE2__)
+    const __m128i low_mask = _mm_set1_epi16(0x00ff);
+    const __m128i rounding = _mm_set1_epi16(2);
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + 2 * x));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(row0 + 2 * x + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + 2 * x));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + 2 * x + 16));
+
+        // Horizontal pairs summed into 16-bit lanes, then the two rows added
+        __m128i s0 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, low_mask), _mm_srli_epi16(a0, 8)),
+                                   _mm_add_epi16(_mm_and_si128(b0, low_mask), _mm_srli_epi16(b0, 8)));
+        __m128i s1 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a1, low_mask), _mm_srli_epi16(a1, 8)),
+                                   _mm_add_epi16(_mm_and_si128(b1, low_mask), _mm_srli_epi16(b1, 8)));
+
+        s0 = _mm_srli_epi16(_mm_add_epi16(s0, rounding), 2);
+        s1 = _mm_srli_epi16(_mm_add_epi16(s1, rounding), 2);
+
+        _mm_storeu_si128((__m128i*)(dest + x), _mm_packus_epi16(s0, s1));
+    }
+#elif defined(__ARM_NEON)
+    for (; x + 16 <= width; x += 16) {
+        // Pairwise widening adds sum horizontal neighbours into 16-bit lanes
+        uint16x8_t s0 = vaddq_u16(vpaddlq_u8(vld1q_u8(row0 + 2 * x)),
+                                  vpaddlq_u8(vld1q_u8(row1 + 2 * x)));
+        uint16x8_t s1 = vaddq_u16(vpaddlq_u8(vld1q_u8(row0 + 2 * x + 16)),
+                                  vpaddlq_u8(vld1q_u8(row1 + 2 * x + 16)));
+
+        vst1q_u8(dest + x, vcombine_u8(vrshrn_n_u16(s0, 2), vrshrn_n_u16(s1, 2)));
+    }
+#endif
+
+    for (; x < width; ++x) {
+        guint sum = row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1];
+        dest[x] = (guint8)((sum + 2) >> 2);
+    }
+}
+
+typedef void (*DownscaleRowFunc)(const guint8* src, gsize src_stride, guint8* dest, guint width);
+
+static DownscaleRowFunc select_row_func(guint channels, guint factor) {
+    switch (channels * 8 + factor) {
+        case 1 * 8 + 2: return downscale_row<1, 2>;
+        case 1 * 8 + 4: return downscale_row<1, 4>;
+        case 2 * 8 + 2: return downscale_row<2, 2>;
+        case 2 * 8 + 4: return downscale_row<2, 4>;
+        case 3 * 8 + 2: return downscale_row<3, 2>;
+        case 3 * 8 + 4: return downscale_row<3, 4>;
+        case 4 * 8 + 2: return downscale_row<4, 2>;
+        case 4 * 8 + 4: return downscale_row<4, 4>;
+        default: return NULL;
+    }
+}
+
+void rerun_frame_downscale(
+    const GstVideoFrame* frame,
+    const RerunPlaneLayout* layout,
+    guint factor,
+    guint8* dest) {
+
+    const GstVideoInfo* info = &frame->info;
+
+    for (guint plane = 0; plane < layout->n_planes; ++plane) {
+        // Bytes per pixel of the plane, e.g. 2 for the interleaved NV12 chroma
+        guint channels = 1;
+        for (guint comp = 0; comp < GST_VIDEO_INFO_N_COMPONENTS(info); ++comp) {
+            if (GST_VIDEO_INFO_COMP_PLANE(info, comp) == (gint)plane) {
+                channels = GST_VIDEO_INFO_COMP_PSTRIDE(info, comp);
+                break;
+            }
+        }
+
+        DownscaleRowFunc row_func = select_row_func(channels, factor);
+        g_return_if_fail(row_func != NULL);
+
+        const guint8* src = (const guint8*)GST_VIDEO_FRAME_PLANE_DATA(frame, plane);
+        gsize src_stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, plane);
+        guint8* out = dest + layout->offset[plane];
+        guint width = layout->row_bytes[plane] / channels;
+
+        for (guint row = 0; row < layout->rows[plane]; ++row) {
+            row_func(src + (gsize)row * factor * src_stride, src_stride, out, width);
+            out += layout->row_bytes[plane];
+        }
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __RERUN_SCALER_H__
+#define __RERUN_SCALER_H__
+
+#include "rerunframepacker.hpp"
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+// Largest downscale factor supported by rerun_frame_downscale()
+#define RERUN_SCALER_MAX_FACTOR 4
+
+// TRUE for the formats and factors rerun_frame_downscale() handles
+gboolean rerun_scaler_supports(GstVideoFormat format, guint factor);
+
+// Box-filter decimation of every plane of @frame by @factor (2 or 4) into
+// @dest, laid out as @layout, which describes the scaled frame (see
+// rerun_plane_layout_init()). Each output byte is the rounded mean of the
+// factor x factor source bytes of the same channel; source pixels beyond the
+// last whole block are ignored.
+void rerun_frame_downscale(
+    const GstVideoFrame* frame,
+    const RerunPlaneLayout* layout,
+    guint factor,
+    guint8* dest);
+
+G_END_DECLS
+
+#endif // __RERUN_SCALER_H__
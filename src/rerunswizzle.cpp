@@ -0,0 +1,181 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "rerunswizzle.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RERUN_SWIZZLE_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+typedef void (*SwizzleRowFunc)(guint8* dest, const guint8* src, gsize pixels,
+                               const guint8 order[4], guint out_channels);
+
+static inline void swizzle_tail(guint8* dest, const guint8* src, gsize pixels,
+                                const guint8 order[4], guint out_channels) {
+    for (gsize x = 0; x < pixels; ++x) {
+        for (guint c = 0; c < out_channels; ++c) {
+            dest[x * out_channels + c] = src[x * 4 + order[c]];
+        }
+    }
+}
+
+static void swizzle_row_c(guint8* dest, const guint8* src, gsize pixels,
+                          const guint8 order[4], guint out_channels) {
+    swizzle_tail(dest, src, pixels, order, out_channels);
+}
+
+#ifdef RERUN_SWIZZLE_X86
+
+// Byte shuffle control for four pixels; unused output bytes are zeroed
+static inline void build_shuffle_mask(guint8 mask[16], const guint8 order[4], guint out_channels) {
+    for (guint i = 0; i < 16; ++i) {
+        mask[i] = 0x80;
+    }
+    for (guint p = 0; p < 4; ++p) {
+        for (guint c = 0; c < out_channels; ++c) {
+            mask[p * out_channels + c] = (guint8)(p * 4 + order[c]);
+        }
+    }
+}
+
+__attribute__((target("ssse3")))
+static void swizzle_row_ssse3(guint8* dest, const guint8* src, gsize pixels,
+                              const guint8 order[4], guint out_channels) {
+    guint8 mask_bytes[16];
+    build_shuffle_mask(mask_bytes, order, out_channels);
+    const __m128i mask = _mm_loadu_si128((const __m128i*)mask_bytes);
+    gsize x = 0;
+
+    if (out_channels == 4) {
+        for (; x + 4 <= pixels; x += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+            _mm_storeu_si128((__m128i*)(dest + x * 4), _mm_shuffle_epi8(v, mask));
+        }
+    } else {
+        // Each store writes 16 bytes of which 12 are valid; the next store
+        // overwrites the rest, so stop while a full store still fits
+        for (; x + 6 <= pixels; x += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+            _mm_storeu_si128((__m128i*)(dest + x * 3), _mm_shuffle_epi8(v, mask));
+        }
+    }
+
+    swizzle_tail(dest + x * out_channels, src + x * 4, pixels - x, order, out_channels);
+}
+
+__attribute__((target("avx2")))
+static void swizzle_row_avx2(guint8* dest, const guint8* src, gsize pixels,
+                             const guint8 order[4], guint out_channels) {
+    guint8 mask_bytes[16];
+    build_shuffle_mask(mask_bytes, order, out_channels);
+    // vpshufb works within 128-bit lanes, so both lanes get the same control
+    const __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_bytes));
+    gsize x = 0;
+
+    if (out_channels == 4) {
+        for (; x + 8 <= pixels; x += 8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(src + x * 4));
+            _mm256_storeu_si256((__m256i*)(dest + x * 4), _mm256_shuffle_epi8(v, mask));
+        }
+    } else {
+        // Move the 12 valid bytes of the upper lane next to those of the lower
+        const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+        for (; x + 11 <= pixels; x += 8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(src + x * 4));
+            v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, mask), compact);
+            _mm256_storeu_si256((__m256i*)(dest + x * 3), v);
+        }
+    }
+
+    swizzle_tail(dest + x * out_channels, src + x * 4, pixels - x, order, out_channels);
+}
+
+#elif defined(__ARM_NEON)
+
+static void swizzle_row_neon(guint8* dest, const guint8* src, gsize pixels,
+                             const guint8 order[4], guint out_channels) {
+    gsize x = 0;
+
+    // Structured loads split the channels into separate registers, which
+    // are then stored back interleaved in the requested order
+    if (out_channels == 4) {
+        for (; x + 16 <= pixels; x += 16) {
+            uint8x16x4_t in = vld4q_u8(src + x * 4);
+            uint8x16x4_t out = { { in.val[order[0]], in.val[order[1]], in.val[order[2]], in.val[order[3]] } };
+            vst4q_u8(dest + x * 4, out);
+        }
+    } else {
+        for (; x + 16 <= pixels; x += 16) {
+            uint8x16x4_t in = vld4q_u8(src + x * 4);
+            uint8x16x3_t out = { { in.val[order[0]], in.val[order[1]], in.val[order[2]] } };
+            vst3q_u8(dest + x * 3, out);
+        }
+    }
+
+    swizzle_tail(dest + x * out_channels, src + x * 4, pixels - x, order, out_channels);
+}
+
+#endif
+
+struct SwizzleImpl {
+    SwizzleRowFunc row;
+    const gchar* name;
+};
+
+static SwizzleImpl select_impl(void) {
+#ifdef RERUN_SWIZZLE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return { swizzle_row_avx2, "avx2" };
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return { swizzle_row_ssse3, "ssse3" };
+    }
+#elif defined(__ARM_NEON)
+    return { swizzle_row_neon, "neon" };
+#endif
+    return { swizzle_row_c, "c" };
+}
+
+static const SwizzleImpl& get_impl(void) {
+    static const SwizzleImpl impl = select_impl();
+    return impl;
+}
+
+void rerun_swizzle_rows(guint8* dest, gsize dest_stride,
+                        const guint8* src, gsize src_stride,
+                        gsize pixels, guint rows,
+                        const guint8 order[4], guint out_channels) {
+    SwizzleRowFunc row_func = get_impl().row;
+
+    for (guint row = 0; row < rows; ++row) {
+        row_func(dest, src, pixels, order, out_channels);
+        dest += dest_stride;
+        src += src_stride;
+    }
+}
+
+const gchar* rerun_swizzle_get_impl(void) {
+    return get_impl().name;
+}
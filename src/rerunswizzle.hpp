@@ -0,0 +1,43 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __RERUN_SWIZZLE_H__
+#define __RERUN_SWIZZLE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// Reorders rows of 4-byte pixels (BGRx, xRGB, ARGB...) into @out_channels
+// (3 or 4) bytes per pixel, where output byte i of a pixel is source byte
+// order[i]. Runs the widest kernel the CPU supports (AVX2, SSSE3 or NEON),
+// selected once at runtime.
+void rerun_swizzle_rows(guint8* dest, gsize dest_stride,
+                        const guint8* src, gsize src_stride,
+                        gsize pixels, guint rows,
+                        const guint8 order[4], guint out_channels);
+
+// Name of the kernel rerun_swizzle_rows() runs on this CPU
+const gchar* rerun_swizzle_get_impl(void);
+
+G_END_DECLS
+
+#endif // __RERUN_SWIZZLE_H__
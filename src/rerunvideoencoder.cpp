@@ -0,0 +1,230 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include "rerunvideoencoder.hpp"
+
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+GST_DEBUG_CATEGORY_STATIC(rerun_video_encoder_debug);
+#define GST_CAT_DEFAULT rerun_video_encoder_debug
+
+// How long a drain waits for the encoder to flush its lookahead
+#define DRAIN_TIMEOUT (10 * GST_SECOND)
+
+// Annex-B access units, which the VideoStream path logs as they are
+#define OUTPUT_CAPS "video/x-h264, stream-format=(string)byte-stream, alignment=(string)au"
+
+struct _RerunVideoEncoder {
+  GstElement* pipeline;
+  GstElement* appsrc;
+  GstElement* encoder;
+  GstBus* bus;
+
+  GstVideoInfo info;            // Input format, caps are only set when it changes
+  gboolean has_info;
+  gboolean drained;             // EOS was sent, restart before the next push
+  guint key_units;
+
+  RerunVideoEncoderFunc output;
+  gpointer user_data;
+};
+
+static void rerun_video_encoder_init_debug(void) {
+    static gsize initialized = 0;
+
+    if (g_once_init_enter(&initialized)) {
+        GST_DEBUG_CATEGORY_INIT(rerun_video_encoder_debug, "rerunvideoencoder", 0, "Rerun sink video encoder");
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
+static void set_if_present(GstElement* element, const gchar* name, const gchar* value) {
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(element), name)) {
+        gst_util_set_object_arg(G_OBJECT(element), name, value);
+    } else {
+        GST_DEBUG_OBJECT(element, "No %s property, keeping the default", name);
+    }
+}
+
+static GstFlowReturn rerun_video_encoder_new_sample(GstAppSink* appsink, gpointer user_data) {
+    RerunVideoEncoder* encoder = (RerunVideoEncoder*)user_data;
+
+    GstSample* sample = gst_app_sink_pull_sample(appsink);
+    if (!sample) {
+        return GST_FLOW_EOS;
+    }
+
+    encoder->output(gst_sample_get_caps(sample), gst_sample_get_buffer(sample), encoder->user_data);
+    gst_sample_unref(sample);
+
+    return GST_FLOW_OK;
+}
+
+// Reports an error the pipeline posted, if any, without waiting
+static gboolean rerun_video_encoder_check_error(RerunVideoEncoder* encoder) {
+    GstMessage* message = gst_bus_pop_filtered(encoder->bus, GST_MESSAGE_ERROR);
+    if (!message) {
+        return FALSE;
+    }
+
+    GError* error = NULL;
+    gchar* debug = NULL;
+    gst_message_parse_error(message, &error, &debug);
+    GST_ERROR_OBJECT(encoder->pipeline, "Encoder failed: %s (%s)", error->message, debug ? debug : "");
+    g_error_free(error);
+    g_free(debug);
+    gst_message_unref(message);
+
+    return TRUE;
+}
+
+RerunVideoEncoder* rerun_video_encoder_new(
+    const RerunVideoEncoderConfig* config,
+    RerunVideoEncoderFunc output,
+    gpointer user_data,
+    GError** error) {
+
+    rerun_video_encoder_init_debug();
+
+    gchar* description = g_strdup_printf(
+        "appsrc name=src format=time block=true ! videoconvert ! %s name=enc ! " OUTPUT_CAPS " ! "
+        "appsink name=sink sync=false async=false",
+        config->encoder);
+    GstElement* pipeline = gst_parse_launch(description, error);
+    g_free(description);
+
+    if (!pipeline) {
+        return NULL;
+    }
+
+    RerunVideoEncoder* encoder = g_new0(RerunVideoEncoder, 1);
+    encoder->pipeline = pipeline;
+    encoder->appsrc = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+    encoder->encoder = gst_bin_get_by_name(GST_BIN(pipeline), "enc");
+    encoder->bus = gst_element_get_bus(pipeline);
+    encoder->output = output;
+    encoder->user_data = user_data;
+
+    // A couple of frames in flight keep the encoder busy without buffering
+    set_if_present(encoder->appsrc, "max-buffers", "2");
+
+    gchar* value = g_strdup_printf("%u", config->bitrate);
+    set_if_present(encoder->encoder, "bitrate", value);
+    g_free(value);
+
+    if (config->keyframe_interval) {
+        value = g_strdup_printf("%u", config->keyframe_interval);
+        set_if_present(encoder->encoder, "key-int-max", value);
+        g_free(value);
+    }
+
+    if (config->speed_preset) {
+        set_if_present(encoder->encoder, "speed-preset", config->speed_preset);
+    }
+    // No lookahead, and no B-frames since Rerun decodes without reordering
+    set_if_present(encoder->encoder, "tune", "zerolatency");
+    set_if_present(encoder->encoder, "bframes", "0");
+
+    GstElement* appsink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+    GstAppSinkCallbacks callbacks = {};
+    callbacks.new_sample = rerun_video_encoder_new_sample;
+    gst_app_sink_set_callbacks(GST_APP_SINK(appsink), &callbacks, encoder, NULL);
+    gst_object_unref(appsink);
+
+    if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        g_set_error(error, GST_CORE_ERROR, GST_CORE_ERROR_STATE_CHANGE, "Failed to start %s", config->encoder);
+        rerun_video_encoder_free(encoder);
+        return NULL;
+    }
+
+    GST_INFO_OBJECT(pipeline, "Encoding with %s at %u kbit/s", config->encoder, config->bitrate);
+
+    return encoder;
+}
+
+GstFlowReturn rerun_video_encoder_push(
+    RerunVideoEncoder* encoder,
+    const GstVideoInfo* info,
+    GstBuffer* buffer) {
+
+    if (rerun_video_encoder_check_error(encoder)) {
+        gst_buffer_unref(buffer);
+        return GST_FLOW_ERROR;
+    }
+
+    if (encoder->drained) {
+        gst_element_set_state(encoder->pipeline, GST_STATE_READY);
+        gst_element_set_state(encoder->pipeline, GST_STATE_PLAYING);
+        encoder->drained = FALSE;
+    }
+
+    if (!encoder->has_info || !gst_video_info_is_equal(&encoder->info, info)) {
+        GstCaps* caps = gst_video_info_to_caps(info);
+        gst_app_src_set_caps(GST_APP_SRC(encoder->appsrc), caps);
+        gst_caps_unref(caps);
+
+        encoder->info = *info;
+        encoder->has_info = TRUE;
+    }
+
+    return gst_app_src_push_buffer(GST_APP_SRC(encoder->appsrc), buffer);
+}
+
+void rerun_video_encoder_force_key_unit(RerunVideoEncoder* encoder) {
+    GstPad* pad = gst_element_get_static_pad(encoder->encoder, "src");
+
+    gst_pad_send_event(pad, gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE,
+                                                                        ++encoder->key_units));
+    gst_object_unref(pad);
+}
+
+void rerun_video_encoder_drain(RerunVideoEncoder* encoder) {
+    if (encoder->drained || !encoder->has_info) {
+        return;
+    }
+
+    gst_app_src_end_of_stream(GST_APP_SRC(encoder->appsrc));
+    encoder->drained = TRUE;
+
+    GstMessage* message = gst_bus_timed_pop_filtered(encoder->bus, DRAIN_TIMEOUT,
+                                                     (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    if (!message) {
+        GST_WARNING_OBJECT(encoder->pipeline, "Timed out draining the encoder");
+        return;
+    }
+
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR) {
+        GST_WARNING_OBJECT(encoder->pipeline, "Encoder failed while draining");
+    }
+    gst_message_unref(message);
+}
+
+void rerun_video_encoder_free(RerunVideoEncoder* encoder) {
+    gst_element_set_state(encoder->pipeline, GST_STATE_NULL);
+
+    gst_object_unref(encoder->bus);
+    gst_object_unref(encoder->encoder);
+    gst_object_unref(encoder->appsrc);
+    gst_object_unref(encoder->pipeline);
+    g_free(encoder);
+}
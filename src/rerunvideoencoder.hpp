@@ -0,0 +1,77 @@
+/*
+ * This file is part of GstRerunSink
+ * Copyright 2025 Ridgerun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef __RERUN_VIDEO_ENCODER_H__
+#define __RERUN_VIDEO_ENCODER_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  RERUN_VIDEO_ENCODING_NONE,
+  RERUN_VIDEO_ENCODING_H264,
+} RerunVideoEncoding;
+
+typedef struct {
+  const gchar* encoder;         // Element factory producing H.264, e.g. x264enc
+  guint bitrate;                // kbit/s
+  guint keyframe_interval;      // Frames between keyframes, 0 keeps the encoder default
+  const gchar* speed_preset;    // NULL keeps the encoder default
+} RerunVideoEncoderConfig;
+
+// Receives every encoded access unit on the encoder's streaming thread,
+// together with the caps it was produced with
+typedef void (*RerunVideoEncoderFunc)(GstCaps* caps, GstBuffer* buffer, gpointer user_data);
+
+typedef struct _RerunVideoEncoder RerunVideoEncoder;
+
+// Runs raw frames through a private "appsrc ! videoconvert ! encoder !
+// appsink" pipeline that outputs H.264 byte-stream access units. Settings
+// are applied to the encoder under x264enc's property names, and only when
+// the element has them, so other H.264 encoders can be dropped in.
+RerunVideoEncoder* rerun_video_encoder_new(
+    const RerunVideoEncoderConfig* config,
+    RerunVideoEncoderFunc output,
+    gpointer user_data,
+    GError** error);
+
+// Encodes @buffer, taking ownership of it. Blocks while the encoder is
+// busy, so the caller is paced by the encoder instead of queueing frames.
+GstFlowReturn rerun_video_encoder_push(
+    RerunVideoEncoder* encoder,
+    const GstVideoInfo* info,
+    GstBuffer* buffer);
+
+// Asks the encoder to make the next frame a keyframe with SPS/PPS
+void rerun_video_encoder_force_key_unit(RerunVideoEncoder* encoder);
+
+// Sends EOS and waits until every pushed frame came out of the encoder.
+// The next push starts a new stream.
+void rerun_video_encoder_drain(RerunVideoEncoder* encoder);
+
+void rerun_video_encoder_free(RerunVideoEncoder* encoder);
+
+G_END_DECLS
+
+#endif // __RERUN_VIDEO_ENCODER_H__
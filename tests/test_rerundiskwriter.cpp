@@ -0,0 +1,188 @@
+#include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include "rerundiskwriter.hpp"
+
+#include <sys/stat.h>
+
+#include <cstring>
+#include <vector>
+
+#define KIB 1024
+
+// Not a whole number of 4 KiB blocks, so the last batch is always short
+#define STREAM_SIZE (300 * KIB + 123)
+
+static gchar *tmp_dir = NULL;
+static gchar *path = NULL;
+
+static void setup(void)
+{
+  // In the build tree rather than the system's temporary directory, which
+  // is often a tmpfs that refuses O_DIRECT
+  tmp_dir = g_strdup("rerundiskwriter-XXXXXX");
+  fail_unless(g_mkdtemp(tmp_dir) != NULL);
+  path = g_build_filename(tmp_dir, "out.rrd", NULL);
+}
+
+static void teardown(void)
+{
+  g_unlink(path);
+  g_rmdir(tmp_dir);
+  g_free(path);
+  g_free(tmp_dir);
+  path = NULL;
+  tmp_dir = NULL;
+}
+
+static std::vector<guint8> make_stream(gsize size)
+{
+  std::vector<guint8> stream(size);
+
+  for (gsize i = 0; i < size; i++) {
+    stream[i] = (guint8) (i * 7 + i / 4096 + 3);
+  }
+
+  return stream;
+}
+
+// Hands @stream over in pieces of every size, from single bytes to several
+// batches at once, the way Rerun's file writer calls a pipe's reader
+static void write_stream(const RerunDiskWriterOptions *options, const std::vector<guint8> &stream)
+{
+  static const gsize pieces[] = { 1, 17, 4096, 100, 3 * 4096 + 5, 64 * KIB, 2000 };
+  GError *error = NULL;
+
+  RerunDiskWriter *writer = rerun_disk_writer_new(path, options, &error);
+  fail_unless(writer != NULL, "%s", error ? error->message : "");
+
+  gsize offset = 0;
+  for (guint i = 0; offset < stream.size(); i++) {
+    gsize size = MIN(pieces[i % G_N_ELEMENTS(pieces)], stream.size() - offset);
+    rerun_disk_writer_write(&stream[offset], size, writer);
+    offset += size;
+  }
+
+  rerun_disk_writer_free(writer);
+}
+
+// The file holds exactly the stream: no O_DIRECT padding, no zeros left by
+// preallocation
+static void check_file(const std::vector<guint8> &stream)
+{
+  gchar *contents = NULL;
+  gsize length = 0;
+  GStatBuf st;
+
+  fail_unless(g_stat(path, &st) == 0);
+  fail_unless_equals_uint64(st.st_size, stream.size());
+
+  fail_unless(g_file_get_contents(path, &contents, &length, NULL));
+  fail_unless_equals_uint64(length, stream.size());
+
+  gsize i = 0;
+  while (i < length && (guint8) contents[i] == stream[i]) {
+    i++;
+  }
+  fail_unless(i == length, "byte %" G_GSIZE_FORMAT " differs", i);
+
+  g_free(contents);
+}
+
+GST_START_TEST(test_options_enabled)
+{
+  RerunDiskWriterOptions options = { 0, 0, FALSE, 0 };
+
+  fail_if(rerun_disk_writer_options_enabled(&options));
+  options.preallocate = 1;
+  fail_unless(rerun_disk_writer_options_enabled(&options));
+  options = { 0, 0, TRUE, 0 };
+  fail_unless(rerun_disk_writer_options_enabled(&options));
+}
+GST_END_TEST
+
+GST_START_TEST(test_write)
+{
+  // 4 KiB batches: the stream goes through the 8 buffers many times over,
+  // so the producer has to wait for the disk to hand them back
+  RerunDiskWriterOptions options = { 4 * KIB, 0, FALSE, 0 };
+  std::vector<guint8> stream = make_stream(STREAM_SIZE);
+
+  write_stream(&options, stream);
+  check_file(stream);
+
+  // A write size that is not a whole number of blocks is rounded up
+  options.write_size = 5000;
+  write_stream(&options, stream);
+  check_file(stream);
+
+  // Default batches, larger than the whole stream
+  options.write_size = 0;
+  options.sync_interval = GST_MSECOND;
+  write_stream(&options, stream);
+  check_file(stream);
+}
+GST_END_TEST
+
+GST_START_TEST(test_write_empty)
+{
+  RerunDiskWriterOptions options = { 4 * KIB, 64 * KIB, TRUE, 0 };
+  std::vector<guint8> stream;
+
+  write_stream(&options, stream);
+  check_file(stream);
+}
+GST_END_TEST
+
+GST_START_TEST(test_preallocate)
+{
+  RerunDiskWriterOptions options = { 16 * KIB, 4 * KIB * KIB, FALSE, 0 };
+  std::vector<guint8> stream = make_stream(STREAM_SIZE);
+  GStatBuf st;
+
+  write_stream(&options, stream);
+  check_file(stream);
+
+  // Space reserved past the end was given back when the writer closed
+  fail_unless(g_stat(path, &st) == 0);
+  fail_unless((guint64) st.st_blocks * 512 < options.preallocate,
+      "%" G_GUINT64_FORMAT " bytes still allocated", (guint64) st.st_blocks * 512);
+}
+GST_END_TEST
+
+GST_START_TEST(test_direct)
+{
+  // The last batch is padded to a whole block for O_DIRECT, then cut back
+  RerunDiskWriterOptions options = { 8 * KIB, 0, TRUE, 0 };
+  std::vector<guint8> stream = make_stream(STREAM_SIZE);
+
+  write_stream(&options, stream);
+  check_file(stream);
+
+  options.preallocate = 64 * KIB;
+  write_stream(&options, stream);
+  check_file(stream);
+
+  // Shorter than a single block
+  stream = make_stream(100);
+  write_stream(&options, stream);
+  check_file(stream);
+}
+GST_END_TEST
+
+static Suite* rerundiskwriter_suite(void)
+{
+  Suite *s = suite_create("rerundiskwriter");
+  TCase *tc = tcase_create("write");
+
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_options_enabled);
+  tcase_add_test(tc, test_write);
+  tcase_add_test(tc, test_write_empty);
+  tcase_add_test(tc, test_preallocate);
+  tcase_add_test(tc, test_direct);
+
+  suite_add_tcase(s, tc);
+  return s;
+}
+
+GST_CHECK_MAIN(rerundiskwriter);
@@ -0,0 +1,236 @@
+#include <gst/check/gstcheck.h>
+#include "rerunframepacker.hpp"
+
+#include <cstring>
+#include <vector>
+
+#define GUARD 0xcd
+
+// Maps a frame whose plane rows are @padding bytes longer than their data
+// and whose planes start @gap bytes after the previous one ends, as
+// allocators that align planes do
+static GstBuffer *map_frame(GstVideoFrame *frame, GstVideoFormat format, gint width, gint height,
+    gsize padding, gsize gap)
+{
+  GstVideoInfo info;
+  RerunPlaneLayout layout;
+  gsize offset = 0;
+
+  gst_video_info_set_format(&info, format, width, height);
+  rerun_plane_layout_init(&layout, &info);
+
+  if (padding || gap) {
+    for (guint plane = 0; plane < layout.n_planes; plane++) {
+      GST_VIDEO_INFO_PLANE_STRIDE(&info, plane) = layout.row_bytes[plane] + padding;
+      GST_VIDEO_INFO_PLANE_OFFSET(&info, plane) = offset;
+      offset += (layout.row_bytes[plane] + padding) * layout.rows[plane] + gap;
+    }
+    GST_VIDEO_INFO_SIZE(&info) = offset;
+  }
+
+  GstBuffer *buffer = gst_buffer_new_allocate(NULL, GST_VIDEO_INFO_SIZE(&info), NULL);
+  GstMapInfo map;
+
+  fail_unless(gst_buffer_map(buffer, &map, GST_MAP_WRITE));
+  for (gsize i = 0; i < map.size; i++) {
+    map.data[i] = (guint8) (i * 7 + 3);
+  }
+  gst_buffer_unmap(buffer, &map);
+
+  fail_unless(gst_video_frame_map(frame, &info, buffer, GST_MAP_READ));
+  return buffer;
+}
+
+// Packs @frame and checks every row of every plane ended up back to back,
+// and nothing was written past the layout's size
+static void check_pack(const GstVideoFrame *frame, const RerunPlaneLayout *layout)
+{
+  std::vector<guint8> dest(layout->size + 64, GUARD);
+
+  rerun_frame_pack(frame, layout, dest.data());
+
+  for (guint plane = 0; plane < layout->n_planes; plane++) {
+    const guint8 *src = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, plane);
+    gsize stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, plane);
+
+    for (guint row = 0; row < layout->rows[plane]; row++) {
+      const guint8 *s = src + row * stride;
+      const guint8 *d = &dest[layout->offset[plane] + row * layout->row_bytes[plane]];
+
+      fail_unless(memcmp(d, s, layout->row_bytes[plane]) == 0, "%s plane %u row %u differs",
+          gst_video_format_to_string(GST_VIDEO_FRAME_FORMAT(frame)), plane, row);
+    }
+  }
+
+  for (gsize i = layout->size; i < dest.size(); i++) {
+    fail_unless_equals_int(dest[i], GUARD);
+  }
+}
+
+GST_START_TEST(test_layout)
+{
+  GstVideoInfo info;
+  RerunPlaneLayout layout;
+
+  // 1366 RGB pixels take 4098 bytes, which GStreamer pads to 4100
+  gst_video_info_set_format(&info, GST_VIDEO_FORMAT_RGB, 1366, 4);
+  rerun_plane_layout_init(&layout, &info);
+  fail_unless_equals_int(GST_VIDEO_INFO_PLANE_STRIDE(&info, 0), 4100);
+  fail_unless_equals_int(layout.n_planes, 1);
+  fail_unless_equals_int(layout.row_bytes[0], 4098);
+  fail_unless_equals_int(layout.rows[0], 4);
+  fail_unless_equals_int(layout.size, 4098 * 4);
+
+  gst_video_info_set_format(&info, GST_VIDEO_FORMAT_NV12, 1366, 10);
+  rerun_plane_layout_init(&layout, &info);
+  fail_unless_equals_int(layout.n_planes, 2);
+  fail_unless_equals_int(layout.row_bytes[1], 1366);
+  fail_unless_equals_int(layout.rows[1], 5);
+  fail_unless_equals_int(layout.offset[1], 1366 * 10);
+  fail_unless_equals_int(layout.size, 1366 * 15);
+
+  // Odd sizes round the chroma planes up
+  gst_video_info_set_format(&info, GST_VIDEO_FORMAT_I420, 37, 11);
+  rerun_plane_layout_init(&layout, &info);
+  fail_unless_equals_int(layout.n_planes, 3);
+  fail_unless_equals_int(layout.row_bytes[1], 19);
+  fail_unless_equals_int(layout.rows[2], 6);
+  fail_unless_equals_int(layout.offset[2], 37 * 11 + 19 * 6);
+  fail_unless_equals_int(layout.size, 37 * 11 + 2 * 19 * 6);
+}
+GST_END_TEST
+
+GST_START_TEST(test_pack_padded_rgb)
+{
+  GstVideoFrame frame;
+  RerunPlaneLayout layout;
+
+  GstBuffer *buffer = map_frame(&frame, GST_VIDEO_FORMAT_RGB, 1366, 5, 0, 0);
+  rerun_plane_layout_init(&layout, &frame.info);
+
+  fail_if(rerun_frame_is_packed(&frame, &layout));
+  check_pack(&frame, &layout);
+
+  gst_video_frame_unmap(&frame);
+  gst_buffer_unref(buffer);
+
+  // Wider padding than GStreamer's own
+  buffer = map_frame(&frame, GST_VIDEO_FORMAT_RGB, 1366, 5, 60, 0);
+  rerun_plane_layout_init(&layout, &frame.info);
+
+  fail_if(rerun_frame_is_packed(&frame, &layout));
+  check_pack(&frame, &layout);
+
+  gst_video_frame_unmap(&frame);
+  gst_buffer_unref(buffer);
+}
+GST_END_TEST
+
+GST_START_TEST(test_pack_offset_planes)
+{
+  static const GstVideoFormat formats[] = { GST_VIDEO_FORMAT_NV12, GST_VIDEO_FORMAT_I420 };
+
+  for (GstVideoFormat format : formats) {
+    GstVideoFrame frame;
+    RerunPlaneLayout layout;
+
+    // Padded rows and a gap before each plane
+    GstBuffer *buffer = map_frame(&frame, format, 1366, 10, 34, 4096);
+    rerun_plane_layout_init(&layout, &frame.info);
+    fail_if(rerun_frame_is_packed(&frame, &layout));
+    check_pack(&frame, &layout);
+    gst_video_frame_unmap(&frame);
+    gst_buffer_unref(buffer);
+
+    // Rows without padding, only the planes are apart
+    buffer = map_frame(&frame, format, 64, 48, 0, 100);
+    rerun_plane_layout_init(&layout, &frame.info);
+    fail_if(rerun_frame_is_packed(&frame, &layout));
+    check_pack(&frame, &layout);
+    gst_video_frame_unmap(&frame);
+    gst_buffer_unref(buffer);
+  }
+}
+GST_END_TEST
+
+GST_START_TEST(test_packed_passthrough)
+{
+  static const GstVideoFormat formats[] = {
+    GST_VIDEO_FORMAT_RGB, GST_VIDEO_FORMAT_RGBA, GST_VIDEO_FORMAT_GRAY8,
+    GST_VIDEO_FORMAT_NV12, GST_VIDEO_FORMAT_I420,
+  };
+
+  // Widths GStreamer does not need to pad are already what Rerun takes,
+  // and packing them changes nothing
+  for (GstVideoFormat format : formats) {
+    GstVideoFrame frame;
+    RerunPlaneLayout layout;
+
+    GstBuffer *buffer = map_frame(&frame, format, 64, 48, 0, 0);
+    rerun_plane_layout_init(&layout, &frame.info);
+    fail_unless(rerun_frame_is_packed(&frame, &layout), "%s is not packed",
+        gst_video_format_to_string(format));
+    fail_unless_equals_int(layout.size, GST_VIDEO_INFO_SIZE(&frame.info));
+    check_pack(&frame, &layout);
+
+    // A plane that needs its bytes reordered is never handed over as-is
+    layout.row_op[layout.n_planes - 1] = RERUN_ROW_SWAP_PAIRS;
+    fail_if(rerun_frame_is_packed(&frame, &layout));
+
+    gst_video_frame_unmap(&frame);
+    gst_buffer_unref(buffer);
+  }
+
+  // A single row has no padding to drop, whatever its stride
+  GstVideoFrame frame;
+  RerunPlaneLayout layout;
+  GstBuffer *buffer = map_frame(&frame, GST_VIDEO_FORMAT_RGB, 1366, 1, 0, 0);
+  rerun_plane_layout_init(&layout, &frame.info);
+  fail_unless(rerun_frame_is_packed(&frame, &layout));
+  gst_video_frame_unmap(&frame);
+  gst_buffer_unref(buffer);
+}
+GST_END_TEST
+
+GST_START_TEST(test_pack_swap_pairs)
+{
+  GstVideoFrame frame;
+  RerunPlaneLayout layout;
+  std::vector<guint8> dest;
+
+  GstBuffer *buffer = map_frame(&frame, GST_VIDEO_FORMAT_UYVY, 70, 3, 12, 0);
+  rerun_plane_layout_init(&layout, &frame.info);
+  layout.row_op[0] = RERUN_ROW_SWAP_PAIRS;
+  dest.resize(layout.size);
+
+  rerun_frame_pack(&frame, &layout, dest.data());
+
+  const guint8 *src = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA(&frame, 0);
+  gsize stride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0);
+  for (guint row = 0; row < layout.rows[0]; row++) {
+    for (gsize i = 0; i < layout.row_bytes[0]; i++) {
+      fail_unless_equals_int(dest[row * layout.row_bytes[0] + i], src[row * stride + (i ^ 1)]);
+    }
+  }
+
+  gst_video_frame_unmap(&frame);
+  gst_buffer_unref(buffer);
+}
+GST_END_TEST
+
+static Suite* rerunframepacker_suite(void)
+{
+  Suite *s = suite_create("rerunframepacker");
+  TCase *tc = tcase_create("pack");
+
+  tcase_add_test(tc, test_layout);
+  tcase_add_test(tc, test_pack_padded_rgb);
+  tcase_add_test(tc, test_pack_offset_planes);
+  tcase_add_test(tc, test_packed_passthrough);
+  tcase_add_test(tc, test_pack_swap_pairs);
+
+  suite_add_tcase(s, tc);
+  return s;
+}
+
+GST_CHECK_MAIN(rerunframepacker);
@@ -0,0 +1,290 @@
+#include <gst/check/gstcheck.h>
+#include "rerunh264.hpp"
+
+#include <cstring>
+
+// Splits an Annex-B stream into access units the way the sink does, and
+// returns the number of NAL units in each
+static std::vector<guint> split_access_units(const guint8 *data, gsize size)
+{
+  std::vector<guint> units;
+  RerunNalUnit nal;
+  gsize offset = 0;
+  gboolean have_slice = FALSE;
+
+  while (rerun_h264_next_nal(data, size, &offset, &nal)) {
+    if (units.empty() || rerun_h264_starts_access_unit(&nal, have_slice)) {
+      units.push_back(0);
+      have_slice = FALSE;
+    }
+    units.back()++;
+    have_slice |= nal.type == RERUN_H264_NAL_SLICE || nal.type == RERUN_H264_NAL_IDR;
+  }
+
+  return units;
+}
+
+GST_START_TEST(test_next_nal_start_codes)
+{
+  // Leading garbage, a 4-byte and a 3-byte start code, an empty unit and
+  // trailing zeros that belong to the next 4-byte start code
+  static const guint8 stream[] = {
+    0xff, 0xee,
+    0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x1e,
+    0x00, 0x00, 0x01, 0x68, 0xce,
+    0x00, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84,
+  };
+  RerunNalUnit nal;
+  gsize offset = 0;
+
+  fail_unless(rerun_h264_next_nal(stream, sizeof(stream), &offset, &nal));
+  fail_unless_equals_int(nal.type, RERUN_H264_NAL_SPS);
+  fail_unless_equals_int(nal.size, 3);
+  fail_unless(nal.data == stream + 6);
+
+  fail_unless(rerun_h264_next_nal(stream, sizeof(stream), &offset, &nal));
+  fail_unless_equals_int(nal.type, RERUN_H264_NAL_PPS);
+  fail_unless_equals_int(nal.size, 2);
+
+  fail_unless(rerun_h264_next_nal(stream, sizeof(stream), &offset, &nal));
+  fail_unless_equals_int(nal.type, RERUN_H264_NAL_IDR);
+  fail_unless_equals_int(nal.size, 3);
+  fail_unless(nal.data + nal.size == stream + sizeof(stream));
+
+  fail_if(rerun_h264_next_nal(stream, sizeof(stream), &offset, &nal));
+  fail_unless_equals_int(offset, sizeof(stream));
+}
+GST_END_TEST
+
+GST_START_TEST(test_next_nal_without_start_code)
+{
+  static const guint8 stream[] = { 0x00, 0x00, 0x02, 0x65, 0x00, 0x01 };
+  RerunNalUnit nal;
+  gsize offset = 0;
+
+  fail_if(rerun_h264_next_nal(stream, sizeof(stream), &offset, &nal));
+  fail_unless_equals_int(offset, sizeof(stream));
+
+  offset = 0;
+  fail_if(rerun_h264_next_nal(stream, 2, &offset, &nal));
+}
+GST_END_TEST
+
+GST_START_TEST(test_starts_access_unit)
+{
+  // 0x80 in the second byte codes first_mb_in_slice == 0
+  static const guint8 first_slice[] = { 0x41, 0x9a };
+  static const guint8 next_slice[] = { 0x41, 0x40 };
+  static const guint8 aud[] = { 0x09, 0xf0 };
+  static const guint8 filler[] = { 0x0c, 0xff };
+  RerunNalUnit nal = { first_slice, sizeof(first_slice), RERUN_H264_NAL_SLICE };
+
+  fail_if(rerun_h264_starts_access_unit(&nal, FALSE));
+  fail_unless(rerun_h264_starts_access_unit(&nal, TRUE));
+
+  nal = { next_slice, sizeof(next_slice), RERUN_H264_NAL_SLICE };
+  fail_if(rerun_h264_starts_access_unit(&nal, TRUE));
+
+  nal = { aud, sizeof(aud), RERUN_H264_NAL_AUD };
+  fail_if(rerun_h264_starts_access_unit(&nal, FALSE));
+  fail_unless(rerun_h264_starts_access_unit(&nal, TRUE));
+
+  nal = { filler, sizeof(filler), 12 };
+  fail_if(rerun_h264_starts_access_unit(&nal, TRUE));
+}
+GST_END_TEST
+
+GST_START_TEST(test_split_access_units)
+{
+  // SPS PPS IDR | slice, second slice of the same picture | SEI slice
+  static const guint8 stream[] = {
+    0x00, 0x00, 0x00, 0x01, 0x67, 0x42,
+    0x00, 0x00, 0x00, 0x01, 0x68, 0xce,
+    0x00, 0x00, 0x00, 0x01, 0x65, 0x88,
+    0x00, 0x00, 0x00, 0x01, 0x41, 0x9a,
+    0x00, 0x00, 0x00, 0x01, 0x41, 0x40,
+    0x00, 0x00, 0x00, 0x01, 0x06, 0x05,
+    0x00, 0x00, 0x00, 0x01, 0x41, 0x9a,
+  };
+  std::vector<guint> units = split_access_units(stream, sizeof(stream));
+
+  fail_unless_equals_int(units.size(), 3);
+  fail_unless_equals_int(units[0], 3);
+  fail_unless_equals_int(units[1], 2);
+  fail_unless_equals_int(units[2], 2);
+}
+GST_END_TEST
+
+GST_START_TEST(test_append_nal)
+{
+  static const guint8 idr[] = { 0x65, 0x88, 0x84 };
+  static const guint8 expected[] = { 0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84 };
+  std::vector<std::uint8_t> out;
+  RerunNalUnit nal;
+  gsize offset = 0;
+
+  rerun_h264_append_nal(&out, idr, sizeof(idr));
+  fail_unless_equals_int(out.size(), sizeof(expected));
+  fail_unless(memcmp(out.data(), expected, sizeof(expected)) == 0);
+
+  fail_unless(rerun_h264_next_nal(out.data(), out.size(), &offset, &nal));
+  fail_unless_equals_int(nal.type, RERUN_H264_NAL_IDR);
+  fail_unless_equals_int(nal.size, sizeof(idr));
+}
+GST_END_TEST
+
+GST_START_TEST(test_parse_avcc)
+{
+  // 4-byte lengths, one SPS and one PPS
+  static const guint8 avcc[] = {
+    0x01, 0x42, 0x00, 0x1e, 0xff, 0xe1,
+    0x00, 0x03, 0x67, 0x42, 0x1e,
+    0x01, 0x00, 0x02, 0x68, 0xce,
+  };
+  std::vector<std::uint8_t> sps;
+  std::vector<std::uint8_t> pps;
+
+  fail_unless_equals_int(rerun_h264_parse_avcc(avcc, sizeof(avcc), &sps, &pps), 4);
+  fail_unless(sps == std::vector<std::uint8_t>({ 0x67, 0x42, 0x1e }));
+  fail_unless(pps == std::vector<std::uint8_t>({ 0x68, 0xce }));
+}
+GST_END_TEST
+
+GST_START_TEST(test_parse_avcc_malformed)
+{
+  static const guint8 version[] = { 0x00, 0x42, 0x00, 0x1e, 0xff, 0xe0, 0x00 };
+  static const guint8 three_byte[] = { 0x01, 0x42, 0x00, 0x1e, 0xfe, 0xe0, 0x00 };
+  static const guint8 short_sps[] = { 0x01, 0x42, 0x00, 0x1e, 0xff, 0xe1, 0x00, 0x04, 0x67, 0x42 };
+  static const guint8 no_pps[] = { 0x01, 0x42, 0x00, 0x1e, 0xff, 0xe1, 0x00, 0x01, 0x67 };
+  std::vector<std::uint8_t> sps;
+  std::vector<std::uint8_t> pps;
+
+  fail_unless_equals_int(rerun_h264_parse_avcc(version, sizeof(version), &sps, &pps), 0);
+  fail_unless_equals_int(rerun_h264_parse_avcc(three_byte, sizeof(three_byte), &sps, &pps), 0);
+  fail_unless_equals_int(rerun_h264_parse_avcc(short_sps, sizeof(short_sps), &sps, &pps), 0);
+  fail_unless_equals_int(rerun_h264_parse_avcc(no_pps, sizeof(no_pps), &sps, &pps), 0);
+  fail_unless_equals_int(rerun_h264_parse_avcc(version, 4, &sps, &pps), 0);
+}
+GST_END_TEST
+
+GST_START_TEST(test_avc_to_annexb)
+{
+  // An empty unit between the two is dropped
+  static const guint8 avc[] = {
+    0x00, 0x00, 0x00, 0x02, 0x09, 0xf0,
+    0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x03, 0x65, 0x88, 0x84,
+  };
+  static const guint8 expected[] = {
+    0xaa,
+    0x00, 0x00, 0x00, 0x01, 0x09, 0xf0,
+    0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84,
+  };
+  std::vector<std::uint8_t> out = { 0xaa };
+
+  fail_unless(rerun_h264_avc_to_annexb(avc, sizeof(avc), 4, &out));
+  fail_unless_equals_int(out.size(), sizeof(expected));
+  fail_unless(memcmp(out.data(), expected, sizeof(expected)) == 0);
+}
+GST_END_TEST
+
+GST_START_TEST(test_avc_to_annexb_length_sizes)
+{
+  static const guint8 two_byte[] = { 0x00, 0x02, 0x41, 0x9a, 0x00, 0x01, 0x41 };
+  static const guint8 one_byte[] = { 0x02, 0x41, 0x9a };
+  std::vector<std::uint8_t> out;
+  RerunNalUnit nal;
+  gsize offset = 0;
+
+  fail_unless(rerun_h264_avc_to_annexb(two_byte, sizeof(two_byte), 2, &out));
+  fail_unless_equals_int(out.size(), 4 + 2 + 4 + 1);
+
+  fail_unless(rerun_h264_next_nal(out.data(), out.size(), &offset, &nal));
+  fail_unless_equals_int(nal.size, 2);
+  fail_unless(rerun_h264_next_nal(out.data(), out.size(), &offset, &nal));
+  fail_unless_equals_int(nal.size, 1);
+
+  out.clear();
+  fail_unless(rerun_h264_avc_to_annexb(one_byte, sizeof(one_byte), 1, &out));
+  fail_unless_equals_int(out.size(), 4 + 2);
+}
+GST_END_TEST
+
+GST_START_TEST(test_avc_to_annexb_truncated)
+{
+  // The second unit claims more bytes than are left, then a partial prefix
+  static const guint8 overrun[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0x00, 0x00, 0x00, 0x05, 0x65 };
+  static const guint8 partial[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0x00, 0x00 };
+  std::vector<std::uint8_t> out;
+
+  fail_if(rerun_h264_avc_to_annexb(overrun, sizeof(overrun), 4, &out));
+
+  out.clear();
+  fail_if(rerun_h264_avc_to_annexb(partial, sizeof(partial), 4, &out));
+}
+GST_END_TEST
+
+GST_START_TEST(test_parse_hvcc)
+{
+  // 22 bytes of profile and format fields with 4-byte lengths, then VPS,
+  // SPS, an SEI array that is skipped and PPS, the SPS array holding two
+  static guint8 hvcc[] = {
+    0x01, 0x01, 0x60, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x5d, 0xf0, 0x00, 0xfc, 0xfd, 0xf8, 0xf8, 0x00, 0x00, 0x0f,
+    0x04,
+    0xa0, 0x00, 0x01, 0x00, 0x02, 0x40, 0x01,
+    0xa1, 0x00, 0x02, 0x00, 0x02, 0x42, 0x01, 0x00, 0x03, 0x42, 0x01, 0x01,
+    0x27, 0x00, 0x01, 0x00, 0x02, 0x4e, 0x01,
+    0xa2, 0x00, 0x01, 0x00, 0x03, 0x44, 0x01, 0xc1,
+  };
+  std::vector<std::uint8_t> vps;
+  std::vector<std::uint8_t> sps;
+  std::vector<std::uint8_t> pps;
+
+  fail_unless_equals_int(rerun_h265_parse_hvcc(hvcc, sizeof(hvcc), &vps, &sps, &pps), 4);
+  fail_unless(vps == std::vector<std::uint8_t>({ 0x40, 0x01 }));
+  fail_unless(sps == std::vector<std::uint8_t>({ 0x42, 0x01, 0x01 }));
+  fail_unless(pps == std::vector<std::uint8_t>({ 0x44, 0x01, 0xc1 }));
+
+  // 2-byte lengths
+  hvcc[21] = 0x0d;
+  fail_unless_equals_int(rerun_h265_parse_hvcc(hvcc, sizeof(hvcc), &vps, &sps, &pps), 2);
+
+  // 3-byte lengths do not exist, and every array must fit
+  hvcc[21] = 0x0e;
+  fail_unless_equals_int(rerun_h265_parse_hvcc(hvcc, sizeof(hvcc), &vps, &sps, &pps), 0);
+  hvcc[21] = 0x0f;
+  fail_unless_equals_int(rerun_h265_parse_hvcc(hvcc, sizeof(hvcc) - 1, &vps, &sps, &pps), 0);
+  fail_unless_equals_int(rerun_h265_parse_hvcc(hvcc, 22, &vps, &sps, &pps), 0);
+}
+GST_END_TEST
+
+static Suite* rerunh264_suite(void)
+{
+  Suite *s = suite_create("rerunh264");
+  TCase *tc = tcase_create("annexb");
+
+  tcase_add_test(tc, test_next_nal_start_codes);
+  tcase_add_test(tc, test_next_nal_without_start_code);
+  tcase_add_test(tc, test_starts_access_unit);
+  tcase_add_test(tc, test_split_access_units);
+  tcase_add_test(tc, test_append_nal);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("avc");
+  tcase_add_test(tc, test_parse_avcc);
+  tcase_add_test(tc, test_parse_avcc_malformed);
+  tcase_add_test(tc, test_avc_to_annexb);
+  tcase_add_test(tc, test_avc_to_annexb_length_sizes);
+  tcase_add_test(tc, test_avc_to_annexb_truncated);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("hevc");
+  tcase_add_test(tc, test_parse_hvcc);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+GST_CHECK_MAIN(rerunh264);
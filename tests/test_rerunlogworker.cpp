@@ -0,0 +1,339 @@
+#include <gst/check/gstcheck.h>
+#include "rerunlogworker.hpp"
+
+#include <vector>
+
+#define DEPTH 2
+
+// Long enough for a producer that was going to block to have done so
+#define SETTLE_TIME (50 * G_TIME_SPAN_MILLISECOND)
+
+// The worker stops in process() until the gate is opened, so the tests can
+// fill the queue behind the job it is holding
+typedef struct {
+  GMutex lock;
+  GCond cond;
+  gboolean open;
+  guint entered;
+  std::vector<guint> processed;
+  std::vector<gboolean> after_drop;
+  guint released;
+} Gate;
+
+typedef struct {
+  RerunLogWorker *worker;
+  RerunLogJob job;
+  gboolean queued;
+  gint done;
+} Producer;
+
+static Gate gate;
+
+static void setup(void)
+{
+  g_mutex_init(&gate.lock);
+  g_cond_init(&gate.cond);
+  gate.open = FALSE;
+  gate.entered = 0;
+  gate.processed.clear();
+  gate.after_drop.clear();
+  gate.released = 0;
+}
+
+static void teardown(void)
+{
+  g_mutex_clear(&gate.lock);
+  g_cond_clear(&gate.cond);
+}
+
+static void process(RerunLogJob *job, gpointer user_data)
+{
+  g_mutex_lock(&gate.lock);
+  gate.entered++;
+  g_cond_broadcast(&gate.cond);
+  while (!gate.open) {
+    g_cond_wait(&gate.cond, &gate.lock);
+  }
+  gate.processed.push_back(GPOINTER_TO_UINT(job->data));
+  gate.after_drop.push_back(job->after_drop);
+  g_mutex_unlock(&gate.lock);
+}
+
+static void release(RerunLogJob *job, gpointer user_data)
+{
+  g_mutex_lock(&gate.lock);
+  gate.released++;
+  g_mutex_unlock(&gate.lock);
+}
+
+static void open_gate(void)
+{
+  g_mutex_lock(&gate.lock);
+  gate.open = TRUE;
+  g_cond_broadcast(&gate.cond);
+  g_mutex_unlock(&gate.lock);
+}
+
+static RerunLogJob make_job(guint id, gboolean keep)
+{
+  RerunLogJob job = { NULL, GUINT_TO_POINTER(id) };
+  job.keep = keep;
+  return job;
+}
+
+static gboolean push(RerunLogWorker *worker, guint id)
+{
+  RerunLogJob job = make_job(id, FALSE);
+  return rerun_log_worker_push(worker, &job);
+}
+
+// Pushes job 1 and waits for the worker to hold it, then queues 2 and 3,
+// which leaves the queue full
+static RerunLogWorker *new_full_worker(RerunQueuePolicy policy, gboolean keep_first_queued)
+{
+  RerunLogWorker *worker = rerun_log_worker_new("test-worker", DEPTH, policy, process, release, NULL);
+
+  fail_unless(push(worker, 1));
+  g_mutex_lock(&gate.lock);
+  while (gate.entered < 1) {
+    g_cond_wait(&gate.cond, &gate.lock);
+  }
+  g_mutex_unlock(&gate.lock);
+
+  RerunLogJob job = make_job(2, keep_first_queued);
+  fail_unless(rerun_log_worker_push(worker, &job));
+  fail_unless(push(worker, 3));
+  fail_unless_equals_int(rerun_log_worker_get_pending(worker), 3);
+
+  return worker;
+}
+
+static gpointer push_thread(gpointer data)
+{
+  Producer *producer = (Producer *) data;
+
+  producer->queued = rerun_log_worker_push(producer->worker, &producer->job);
+  g_atomic_int_set(&producer->done, TRUE);
+  return NULL;
+}
+
+// Pushes from a thread of its own and checks that the push is still
+// waiting for room once it had time to return
+static GThread *push_blocked(Producer *producer, RerunLogWorker *worker, guint id, gboolean keep)
+{
+  producer->worker = worker;
+  producer->job = make_job(id, keep);
+  producer->queued = FALSE;
+  producer->done = FALSE;
+
+  GThread *thread = g_thread_new("test-producer", push_thread, producer);
+  g_usleep(SETTLE_TIME);
+  fail_if(g_atomic_int_get(&producer->done), "push of job %u did not block", id);
+
+  return thread;
+}
+
+static void check_processed(const std::vector<guint> &ids, const std::vector<gboolean> &after_drop)
+{
+  fail_unless_equals_int(gate.processed.size(), ids.size());
+  for (gsize i = 0; i < ids.size(); i++) {
+    fail_unless_equals_int(gate.processed[i], ids[i]);
+    fail_unless_equals_int(gate.after_drop[i], after_drop[i]);
+  }
+}
+
+GST_START_TEST(test_drop_newest)
+{
+  RerunLogWorker *worker = new_full_worker(RERUN_QUEUE_POLICY_DROP_NEWEST, FALSE);
+
+  fail_if(push(worker, 4));
+  fail_unless_equals_uint64(rerun_log_worker_get_dropped(worker), 1);
+  fail_unless_equals_int(gate.released, 1);
+
+  open_gate();
+  rerun_log_worker_drain(worker);
+  fail_unless(push(worker, 5));
+  rerun_log_worker_drain(worker);
+
+  // The job after the dropped one knows something is missing before it
+  check_processed({ 1, 2, 3, 5 }, { FALSE, FALSE, FALSE, TRUE });
+  fail_unless_equals_int(gate.released, 5);
+  fail_unless_equals_int(rerun_log_worker_get_pending(worker), 0);
+
+  rerun_log_worker_free(worker);
+}
+GST_END_TEST
+
+GST_START_TEST(test_drop_oldest)
+{
+  RerunLogWorker *worker = new_full_worker(RERUN_QUEUE_POLICY_DROP_OLDEST, FALSE);
+
+  fail_unless(push(worker, 4));
+  fail_unless_equals_uint64(rerun_log_worker_get_dropped(worker), 1);
+  fail_unless_equals_int(gate.released, 1);
+
+  open_gate();
+  rerun_log_worker_drain(worker);
+
+  check_processed({ 1, 3, 4 }, { FALSE, TRUE, FALSE });
+  fail_unless_equals_int(gate.released, 4);
+
+  rerun_log_worker_free(worker);
+}
+GST_END_TEST
+
+GST_START_TEST(test_block)
+{
+  RerunLogWorker *worker = new_full_worker(RERUN_QUEUE_POLICY_BLOCK, FALSE);
+  Producer producer;
+
+  GThread *thread = push_blocked(&producer, worker, 4, FALSE);
+  fail_unless_equals_int(rerun_log_worker_get_pending(worker), 4);
+
+  open_gate();
+  g_thread_join(thread);
+  fail_unless(producer.queued);
+  rerun_log_worker_drain(worker);
+
+  check_processed({ 1, 2, 3, 4 }, { FALSE, FALSE, FALSE, FALSE });
+  fail_unless_equals_uint64(rerun_log_worker_get_dropped(worker), 0);
+
+  rerun_log_worker_free(worker);
+}
+GST_END_TEST
+
+GST_START_TEST(test_keep_blocks)
+{
+  RerunLogWorker *worker = new_full_worker(RERUN_QUEUE_POLICY_DROP_NEWEST, FALSE);
+  Producer producer;
+
+  // A kept job waits for room whatever the policy
+  GThread *thread = push_blocked(&producer, worker, 4, TRUE);
+
+  open_gate();
+  g_thread_join(thread);
+  fail_unless(producer.queued);
+  rerun_log_worker_drain(worker);
+
+  check_processed({ 1, 2, 3, 4 }, { FALSE, FALSE, FALSE, FALSE });
+  fail_unless_equals_uint64(rerun_log_worker_get_dropped(worker), 0);
+
+  rerun_log_worker_free(worker);
+}
+GST_END_TEST
+
+GST_START_TEST(test_keep_not_evicted)
+{
+  // Job 2 is kept, so drop-oldest drops the job being pushed instead
+  RerunLogWorker *worker = new_full_worker(RERUN_QUEUE_POLICY_DROP_OLDEST, TRUE);
+
+  fail_if(push(worker, 4));
+  fail_unless_equals_uint64(rerun_log_worker_get_dropped(worker), 1);
+
+  open_gate();
+  rerun_log_worker_drain(worker);
+
+  // Once it is out of the queue, the oldest job can be dropped again
+  g_mutex_lock(&gate.lock);
+  gate.open = FALSE;
+  gate.entered = 0;
+  g_mutex_unlock(&gate.lock);
+  fail_unless(push(worker, 5));
+  g_mutex_lock(&gate.lock);
+  while (gate.entered < 1) {
+    g_cond_wait(&gate.cond, &gate.lock);
+  }
+  g_mutex_unlock(&gate.lock);
+  fail_unless(push(worker, 6));
+  fail_unless(push(worker, 7));
+  fail_unless(push(worker, 8));
+  fail_unless_equals_uint64(rerun_log_worker_get_dropped(worker), 2);
+
+  open_gate();
+  rerun_log_worker_drain(worker);
+
+  check_processed({ 1, 2, 3, 5, 7, 8 }, { FALSE, FALSE, FALSE, TRUE, TRUE, FALSE });
+
+  rerun_log_worker_free(worker);
+}
+GST_END_TEST
+
+GST_START_TEST(test_flush_blocked_push)
+{
+  RerunLogWorker *worker = new_full_worker(RERUN_QUEUE_POLICY_BLOCK, FALSE);
+  Producer producer;
+
+  GThread *thread = push_blocked(&producer, worker, 4, FALSE);
+
+  // The blocked push gives up and what was queued is discarded, none of
+  // it counted as dropped by the policy
+  rerun_log_worker_set_flushing(worker, TRUE);
+  g_thread_join(thread);
+  fail_if(producer.queued);
+  fail_unless_equals_int(gate.released, 3);
+  fail_unless_equals_uint64(rerun_log_worker_get_dropped(worker), 0);
+
+  fail_if(push(worker, 5));
+
+  open_gate();
+  rerun_log_worker_drain(worker);
+  check_processed({ 1 }, { FALSE });
+
+  rerun_log_worker_set_flushing(worker, FALSE);
+  fail_unless(push(worker, 6));
+  rerun_log_worker_drain(worker);
+
+  check_processed({ 1, 6 }, { FALSE, TRUE });
+  fail_unless_equals_int(gate.released, 6);
+
+  rerun_log_worker_free(worker);
+}
+GST_END_TEST
+
+GST_START_TEST(test_unblock_blocked_push)
+{
+  RerunLogWorker *worker = new_full_worker(RERUN_QUEUE_POLICY_BLOCK, FALSE);
+  Producer producer;
+
+  GThread *thread = push_blocked(&producer, worker, 4, FALSE);
+
+  // Unlike a flush, what is already queued still gets processed
+  rerun_log_worker_set_unblocked(worker, TRUE);
+  g_thread_join(thread);
+  fail_if(producer.queued);
+  fail_if(push(worker, 5));
+
+  open_gate();
+  rerun_log_worker_drain(worker);
+  check_processed({ 1, 2, 3 }, { FALSE, FALSE, FALSE });
+
+  rerun_log_worker_set_unblocked(worker, FALSE);
+  fail_unless(push(worker, 6));
+  rerun_log_worker_drain(worker);
+
+  check_processed({ 1, 2, 3, 6 }, { FALSE, FALSE, FALSE, TRUE });
+  fail_unless_equals_uint64(rerun_log_worker_get_dropped(worker), 0);
+
+  rerun_log_worker_free(worker);
+}
+GST_END_TEST
+
+static Suite* rerunlogworker_suite(void)
+{
+  Suite *s = suite_create("rerunlogworker");
+  TCase *tc = tcase_create("queue");
+
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_drop_newest);
+  tcase_add_test(tc, test_drop_oldest);
+  tcase_add_test(tc, test_block);
+  tcase_add_test(tc, test_keep_blocks);
+  tcase_add_test(tc, test_keep_not_evicted);
+  tcase_add_test(tc, test_flush_blocked_push);
+  tcase_add_test(tc, test_unblock_blocked_push);
+
+  suite_add_tcase(s, tc);
+  return s;
+}
+
+GST_CHECK_MAIN(rerunlogworker);
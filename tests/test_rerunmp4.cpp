@@ -0,0 +1,336 @@
+#include <gst/check/gstcheck.h>
+#include "rerunh264.hpp"
+#include "rerunmp4.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#define FRAME (40 * GST_MSECOND)
+
+static const guint8 h264_sps[] = { 0x67, 0x42, 0x00, 0x1e, 0x95 };
+static const guint8 h264_pps[] = { 0x68, 0xce, 0x38, 0x80 };
+
+static guint32 read_u32(const std::vector<std::uint8_t>& file, gsize offset)
+{
+  return ((guint32) file[offset] << 24) | (file[offset + 1] << 16) |
+      (file[offset + 2] << 8) | file[offset + 3];
+}
+
+// Offset of the box at @path ("moov/trak/mdia") within @file, or -1. Only
+// plain container boxes can appear before the last path element.
+static gssize find_box(const std::vector<std::uint8_t>& file, const std::string& path)
+{
+  gsize start = 0;
+  gsize end = file.size();
+  gsize from = 0;
+
+  while (from <= path.size()) {
+    gsize slash = std::min(path.find('/', from), path.size());
+    std::string type = path.substr(from, slash - from);
+    gssize found = -1;
+
+    for (gsize box = start; box + 8 <= end; box += read_u32(file, box)) {
+      if (read_u32(file, box) < 8) {
+        return -1;
+      }
+      if (memcmp(&file[box + 4], type.data(), 4) == 0) {
+        found = box;
+        break;
+      }
+    }
+
+    if (found < 0 || slash == path.size()) {
+      return found;
+    }
+
+    start = found + 8;
+    end = found + read_u32(file, found);
+    from = slash + 1;
+  }
+
+  return -1;
+}
+
+// Offset of the first box of @type anywhere in @file, for the boxes inside
+// sample entries that find_box() does not descend into
+static gssize find_fourcc(const std::vector<std::uint8_t>& file, const char *type)
+{
+  auto it = std::search(file.begin(), file.end(), type, type + 4);
+  return it == file.end() ? -1 : (it - file.begin()) - 4;
+}
+
+// Annex-B access unit made of @nals, each given as a byte list
+static std::vector<std::uint8_t> access_unit(std::initializer_list<std::vector<std::uint8_t>> nals)
+{
+  std::vector<std::uint8_t> unit;
+  for (const std::vector<std::uint8_t>& nal : nals) {
+    rerun_h264_append_nal(&unit, nal.data(), nal.size());
+  }
+  return unit;
+}
+
+static void add_unit(RerunMp4Segment *segment, const std::vector<std::uint8_t>& unit,
+    GstClockTime pts, GstClockTime dts, gboolean keyframe)
+{
+  rerun_mp4_segment_add(segment, unit.data(), unit.size(), pts, dts, keyframe);
+}
+
+// I P B B in decode order, parameter sets and a delimiter in front of the I
+static void add_h264_gop(RerunMp4Segment *segment)
+{
+  std::vector<std::uint8_t> sps(h264_sps, h264_sps + sizeof(h264_sps));
+  std::vector<std::uint8_t> pps(h264_pps, h264_pps + sizeof(h264_pps));
+
+  add_unit(segment, access_unit({ { 0x09, 0xf0 }, sps, pps, { 0x65, 0x88, 0x84 } }),
+      FRAME, 0, TRUE);
+  add_unit(segment, access_unit({ { 0x41, 0x9a, 0x01 } }), 4 * FRAME, FRAME, FALSE);
+  add_unit(segment, access_unit({ { 0x01, 0x9e, 0x02, 0x03 } }), 2 * FRAME, 2 * FRAME, FALSE);
+  add_unit(segment, access_unit({ { 0x01, 0x9e, 0x04 } }), 3 * FRAME, 3 * FRAME, FALSE);
+}
+
+GST_START_TEST(test_segment_add)
+{
+  RerunMp4Segment segment = { RERUN_MP4_CODEC_H264, 320, 240 };
+
+  add_h264_gop(&segment);
+
+  fail_unless(segment.sps == std::vector<std::uint8_t>(h264_sps, h264_sps + sizeof(h264_sps)));
+  fail_unless(segment.pps == std::vector<std::uint8_t>(h264_pps, h264_pps + sizeof(h264_pps)));
+  fail_unless_equals_int(segment.samples.size(), 4);
+
+  // Only the IDR slice is left of the first access unit, length-prefixed
+  fail_unless_equals_int(segment.samples[0].offset, 0);
+  fail_unless_equals_int(segment.samples[0].size, 4 + 3);
+  fail_unless_equals_int(read_u32(segment.data, 0), 3);
+  fail_unless_equals_int(segment.data[4], 0x65);
+  fail_unless_equals_int(segment.samples[1].offset, 7);
+  fail_unless_equals_int(segment.samples[2].size, 4 + 4);
+  fail_unless(segment.samples[0].keyframe);
+  fail_if(segment.samples[1].keyframe);
+
+  fail_unless_equals_uint64(rerun_mp4_segment_span(&segment), 3 * FRAME);
+
+  rerun_mp4_segment_clear(&segment);
+  fail_unless(segment.samples.empty());
+  fail_unless(segment.data.empty());
+  fail_unless_equals_uint64(rerun_mp4_segment_span(&segment), 0);
+  fail_if(segment.sps.empty());
+}
+GST_END_TEST
+
+GST_START_TEST(test_segment_add_fixes_timestamps)
+{
+  RerunMp4Segment segment = { RERUN_MP4_CODEC_H264, 320, 240 };
+  std::vector<std::uint8_t> sps(h264_sps, h264_sps + sizeof(h264_sps));
+  std::vector<std::uint8_t> slice = access_unit({ { 0x41, 0x9a } });
+
+  add_unit(&segment, slice, FRAME, FRAME, TRUE);
+  add_unit(&segment, slice, 0, FRAME, FALSE);
+
+  // A repeated DTS moves one nanosecond on, and PTS never precedes it
+  fail_unless_equals_uint64(segment.samples[1].dts, FRAME + 1);
+  fail_unless_equals_uint64(segment.samples[1].pts, FRAME + 1);
+
+  // Nothing but parameter sets is not a sample
+  add_unit(&segment, access_unit({ sps }), 2 * FRAME, 2 * FRAME, FALSE);
+  fail_unless_equals_int(segment.samples.size(), 2);
+}
+GST_END_TEST
+
+GST_START_TEST(test_segment_write_layout)
+{
+  RerunMp4Segment segment = { RERUN_MP4_CODEC_H264, 320, 240 };
+
+  add_h264_gop(&segment);
+  fail_unless(rerun_mp4_segment_write(&segment, GST_CLOCK_TIME_NONE));
+
+  const std::vector<std::uint8_t>& file = segment.file;
+  gssize ftyp = find_box(file, "ftyp");
+  gssize moov = find_box(file, "moov");
+  gssize mdat = find_box(file, "mdat");
+
+  // ftyp, moov and mdat back to back, covering the whole file
+  fail_unless_equals_int(ftyp, 0);
+  fail_unless_equals_int(moov, read_u32(file, 0));
+  fail_unless_equals_int(mdat, moov + read_u32(file, moov));
+  fail_unless_equals_int(mdat + read_u32(file, mdat), file.size());
+  fail_unless_equals_int(read_u32(file, mdat), 8 + segment.data.size());
+
+  // The single chunk starts right after the mdat header
+  gssize stco = find_box(file, "moov/trak/mdia/minf/stbl/stco");
+  fail_unless(stco > 0);
+  fail_unless_equals_int(read_u32(file, stco + 12), 1);
+  fail_unless_equals_int(read_u32(file, stco + 16), mdat + 8);
+  fail_unless(memcmp(&file[mdat + 8], segment.data.data(), segment.data.size()) == 0);
+
+  gssize stsz = find_box(file, "moov/trak/mdia/minf/stbl/stsz");
+  fail_unless(stsz > 0);
+  fail_unless_equals_int(read_u32(file, stsz + 16), 4);
+  for (guint i = 0; i < 4; i++) {
+    fail_unless_equals_int(read_u32(file, stsz + 20 + 4 * i), segment.samples[i].size);
+  }
+
+  gssize stss = find_box(file, "moov/trak/mdia/minf/stbl/stss");
+  fail_unless(stss > 0);
+  fail_unless_equals_int(read_u32(file, stss + 12), 1);
+  fail_unless_equals_int(read_u32(file, stss + 16), 1);
+
+  // The avcC record takes the profile and level from the SPS
+  gssize avcc = find_fourcc(file, "avcC");
+  fail_unless(find_fourcc(file, "avc1") > 0);
+  fail_unless(avcc > 0);
+  fail_unless_equals_int(file[avcc + 9], h264_sps[1]);
+  fail_unless_equals_int(file[avcc + 11], h264_sps[3]);
+
+  std::vector<std::uint8_t> sps;
+  std::vector<std::uint8_t> pps;
+  fail_unless_equals_int(rerun_h264_parse_avcc(&file[avcc + 8], read_u32(file, avcc) - 8, &sps, &pps), 4);
+  fail_unless(sps == segment.sps);
+  fail_unless(pps == segment.pps);
+}
+GST_END_TEST
+
+GST_START_TEST(test_segment_write_timing)
+{
+  RerunMp4Segment segment = { RERUN_MP4_CODEC_H264, 320, 240 };
+
+  add_h264_gop(&segment);
+
+  // Without a last duration the previous one repeats: 4 x 3600 ticks
+  fail_unless(rerun_mp4_segment_write(&segment, GST_CLOCK_TIME_NONE));
+  gssize stts = find_box(segment.file, "moov/trak/mdia/minf/stbl/stts");
+  fail_unless(stts > 0);
+  fail_unless_equals_int(read_u32(segment.file, stts + 12), 1);
+  fail_unless_equals_int(read_u32(segment.file, stts + 16), 4);
+  fail_unless_equals_int(read_u32(segment.file, stts + 20), 3600);
+
+  gssize mdhd = find_box(segment.file, "moov/trak/mdia/mdhd");
+  fail_unless(mdhd > 0);
+  fail_unless_equals_int(read_u32(segment.file, mdhd + 20), 90000);
+  fail_unless_equals_int(read_u32(segment.file, mdhd + 24), 4 * 3600);
+
+  // Composition offsets follow the reordering: I+1, P+3, B+0, B+0 frames
+  static const guint32 offsets[] = { 3600, 3 * 3600, 0, 0 };
+  gssize ctts = find_box(segment.file, "moov/trak/mdia/minf/stbl/ctts");
+  fail_unless(ctts > 0);
+  fail_unless_equals_int(read_u32(segment.file, ctts + 12), 4);
+  for (guint i = 0; i < 4; i++) {
+    fail_unless_equals_int(read_u32(segment.file, ctts + 16 + 8 * i), 1);
+    fail_unless_equals_int(read_u32(segment.file, ctts + 20 + 8 * i), offsets[i]);
+  }
+
+  // An explicit last duration gets its own run
+  fail_unless(rerun_mp4_segment_write(&segment, FRAME / 2));
+  stts = find_box(segment.file, "moov/trak/mdia/minf/stbl/stts");
+  fail_unless_equals_int(read_u32(segment.file, stts + 12), 2);
+  fail_unless_equals_int(read_u32(segment.file, stts + 16), 3);
+  fail_unless_equals_int(read_u32(segment.file, stts + 20), 3600);
+  fail_unless_equals_int(read_u32(segment.file, stts + 24), 1);
+  fail_unless_equals_int(read_u32(segment.file, stts + 28), 1800);
+}
+GST_END_TEST
+
+GST_START_TEST(test_segment_write_without_reordering)
+{
+  RerunMp4Segment segment = { RERUN_MP4_CODEC_H264, 320, 240 };
+  std::vector<std::uint8_t> sps(h264_sps, h264_sps + sizeof(h264_sps));
+  std::vector<std::uint8_t> pps(h264_pps, h264_pps + sizeof(h264_pps));
+
+  add_unit(&segment, access_unit({ sps, pps, { 0x65, 0x88 } }), 0, 0, TRUE);
+  add_unit(&segment, access_unit({ { 0x41, 0x9a } }), FRAME, FRAME, FALSE);
+
+  fail_unless(rerun_mp4_segment_write(&segment, GST_CLOCK_TIME_NONE));
+  fail_unless_equals_int(find_box(segment.file, "moov/trak/mdia/minf/stbl/ctts"), -1);
+}
+GST_END_TEST
+
+GST_START_TEST(test_segment_write_incomplete)
+{
+  RerunMp4Segment segment = { RERUN_MP4_CODEC_H264, 320, 240 };
+
+  fail_if(rerun_mp4_segment_write(&segment, GST_CLOCK_TIME_NONE));
+
+  // Samples without parameter sets cannot be described
+  add_unit(&segment, access_unit({ { 0x65, 0x88 } }), 0, 0, TRUE);
+  fail_if(rerun_mp4_segment_write(&segment, GST_CLOCK_TIME_NONE));
+
+  segment.sps.assign(h264_sps, h264_sps + sizeof(h264_sps));
+  fail_if(rerun_mp4_segment_write(&segment, GST_CLOCK_TIME_NONE));
+
+  segment.pps.assign(h264_pps, h264_pps + sizeof(h264_pps));
+  fail_unless(rerun_mp4_segment_write(&segment, GST_CLOCK_TIME_NONE));
+}
+GST_END_TEST
+
+GST_START_TEST(test_segment_write_h265)
+{
+  // One sub-layer, 4:2:0, 8 bits. The profile, tier and level bytes carry
+  // emulation prevention bytes that the hvcC record must not keep.
+  static const guint8 ptl[] = {
+    0x01, 0x60, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5d,
+  };
+  std::vector<std::uint8_t> vps = { 0x40, 0x01, 0x0c, 0x01 };
+  std::vector<std::uint8_t> sps = {
+    0x42, 0x01, 0x01,
+    0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5d,
+    0xa4, 0x9c,
+  };
+  std::vector<std::uint8_t> pps = { 0x44, 0x01, 0xc1, 0x72 };
+  RerunMp4Segment segment = { RERUN_MP4_CODEC_H265, 320, 240 };
+
+  add_unit(&segment, access_unit({ { 0x46, 0x01, 0x10 }, vps, sps, pps, { 0x26, 0x01, 0xaf } }),
+      0, 0, TRUE);
+  add_unit(&segment, access_unit({ { 0x02, 0x01, 0xd0 } }), FRAME, FRAME, FALSE);
+
+  fail_unless(segment.vps == vps);
+  fail_unless(segment.sps == sps);
+  fail_unless(segment.pps == pps);
+  fail_unless_equals_int(segment.samples[0].size, 4 + 3);
+
+  fail_unless(rerun_mp4_segment_write(&segment, GST_CLOCK_TIME_NONE));
+  fail_unless(find_fourcc(segment.file, "hvc1") > 0);
+
+  gssize hvcc = find_fourcc(segment.file, "hvcC");
+  fail_unless(hvcc > 0);
+
+  const guint8 *record = &segment.file[hvcc + 8];
+  fail_unless_equals_int(record[0], 1);
+  fail_unless(memcmp(record + 1, ptl, sizeof(ptl)) == 0);
+  fail_unless_equals_int(record[16], 0xfc | 1);
+  fail_unless_equals_int(record[17], 0xf8);
+  fail_unless_equals_int(record[18], 0xf8);
+
+  std::vector<std::uint8_t> parsed_vps;
+  std::vector<std::uint8_t> parsed_sps;
+  std::vector<std::uint8_t> parsed_pps;
+  fail_unless_equals_int(rerun_h265_parse_hvcc(record, read_u32(segment.file, hvcc) - 8,
+      &parsed_vps, &parsed_sps, &parsed_pps), 4);
+  fail_unless(parsed_vps == vps);
+  fail_unless(parsed_sps == sps);
+  fail_unless(parsed_pps == pps);
+
+  // H.265 needs a VPS on top of the SPS and PPS
+  segment.vps.clear();
+  fail_if(rerun_mp4_segment_write(&segment, GST_CLOCK_TIME_NONE));
+}
+GST_END_TEST
+
+static Suite* rerunmp4_suite(void)
+{
+  Suite *s = suite_create("rerunmp4");
+  TCase *tc = tcase_create("segment");
+
+  tcase_add_test(tc, test_segment_add);
+  tcase_add_test(tc, test_segment_add_fixes_timestamps);
+  tcase_add_test(tc, test_segment_write_layout);
+  tcase_add_test(tc, test_segment_write_timing);
+  tcase_add_test(tc, test_segment_write_without_reordering);
+  tcase_add_test(tc, test_segment_write_incomplete);
+  tcase_add_test(tc, test_segment_write_h265);
+
+  suite_add_tcase(s, tc);
+  return s;
+}
+
+GST_CHECK_MAIN(rerunmp4);
@@ -0,0 +1,406 @@
+#include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include <glib-unix.h>
+#include "rerunoutput.hpp"
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#define FRAME (40 * GST_MSECOND)
+
+static gchar *tmp_dir = NULL;
+
+static void setup(void)
+{
+  tmp_dir = g_dir_make_tmp("rerunoutput-XXXXXX", NULL);
+  fail_unless(tmp_dir != NULL);
+}
+
+static void teardown(void)
+{
+  GDir *dir = g_dir_open(tmp_dir, 0, NULL);
+  const gchar *name;
+
+  while (dir && (name = g_dir_read_name(dir))) {
+    gchar *path = g_build_filename(tmp_dir, name, NULL);
+    g_unlink(path);
+    g_free(path);
+  }
+  if (dir) {
+    g_dir_close(dir);
+  }
+
+  g_rmdir(tmp_dir);
+  g_free(tmp_dir);
+  tmp_dir = NULL;
+}
+
+// Parses @description with every "%s" replaced by the test's directory
+static void parse_in_tmp(const gchar *description, std::vector<RerunOutput> *outputs)
+{
+  std::string text = description;
+  GError *error = NULL;
+
+  for (gsize at = text.find("%s"); at != std::string::npos; at = text.find("%s", at)) {
+    text.replace(at, 2, tmp_dir);
+    at += strlen(tmp_dir);
+  }
+
+  fail_unless(rerun_output_parse(text.c_str(), outputs, &error), "%s", error ? error->message : "");
+}
+
+static void count_bytes(const guint8 *data, gsize size, gpointer user_data)
+{
+  *(gsize *) user_data += size;
+}
+
+GST_START_TEST(test_parse_kinds)
+{
+  std::vector<RerunOutput> outputs;
+  GError *error = NULL;
+
+  fail_unless(rerun_output_parse(
+      " file, location=out.rrd ;grpc, url=rerun+http://host:9876/proxy; ; spawn; stdout; fd, fd=5; callback",
+      &outputs, &error));
+  fail_unless(error == NULL);
+  fail_unless_equals_int(outputs.size(), 6);
+
+  fail_unless_equals_int(outputs[0].kind, RERUN_OUTPUT_FILE);
+  fail_unless_equals_string(outputs[0].target, "out.rrd");
+  fail_unless_equals_int(outputs[1].kind, RERUN_OUTPUT_GRPC);
+  fail_unless_equals_string(outputs[1].target, "rerun+http://host:9876/proxy");
+  fail_unless_equals_int(outputs[2].kind, RERUN_OUTPUT_SPAWN);
+  fail_unless(outputs[2].target == NULL);
+  fail_unless_equals_int(outputs[3].kind, RERUN_OUTPUT_STDOUT);
+  fail_unless_equals_int(outputs[3].fd, 1);
+  fail_unless_equals_int(outputs[4].kind, RERUN_OUTPUT_FD);
+  fail_unless_equals_int(outputs[4].fd, 5);
+  fail_unless_equals_int(outputs[5].kind, RERUN_OUTPUT_CALLBACK);
+
+  for (const RerunOutput& output : outputs) {
+    fail_unless(output.max_fps == 0.0);
+    fail_unless_equals_int(output.keep_every, 0);
+    fail_unless_equals_uint64(output.rotate_size, 0);
+    fail_if(rerun_disk_writer_options_enabled(&output.writer));
+  }
+
+  // Without a URL, gRPC goes to the viewer's default address
+  fail_unless(rerun_output_parse("grpc", &outputs, &error));
+  fail_unless_equals_int(outputs.size(), 7);
+  fail_unless(outputs[6].target != NULL && outputs[6].target[0] != '\0');
+
+  rerun_output_clear(&outputs);
+  fail_unless(outputs.empty());
+}
+GST_END_TEST
+
+GST_START_TEST(test_parse_rates)
+{
+  std::vector<RerunOutput> outputs;
+
+  fail_unless(rerun_output_parse(
+      "grpc, max-fps=5; grpc, url=rerun+http://host:9876/proxy, max-fps=7.5, keep-every=3, policy=block; "
+      "spawn, policy=drop",
+      &outputs, NULL));
+  fail_unless_equals_int(outputs.size(), 3);
+  fail_unless(outputs[0].max_fps == 5.0);
+  fail_unless_equals_int(outputs[0].keep_every, 0);
+  fail_if(outputs[0].block);
+  fail_unless(outputs[1].max_fps == 7.5);
+  fail_unless_equals_int(outputs[1].keep_every, 3);
+  fail_unless(outputs[1].block);
+  fail_if(outputs[2].block);
+
+  rerun_output_clear(&outputs);
+}
+GST_END_TEST
+
+GST_START_TEST(test_parse_file_options)
+{
+  std::vector<RerunOutput> outputs;
+
+  fail_unless(rerun_output_parse(
+      "file, location=\"rec-%H%M%S.rrd\", rotate-size=2, rotate-duration=1.5, max-files=4, index=rec.json, "
+      "write-size=256, preallocate=8, direct-io=true, sync-interval=2",
+      &outputs, NULL));
+  fail_unless_equals_int(outputs.size(), 1);
+
+  const RerunOutput *output = &outputs[0];
+  fail_unless_equals_string(output->target, "rec-%H%M%S.rrd");
+  fail_unless_equals_uint64(output->rotate_size, 2 * 1024 * 1024);
+  fail_unless_equals_uint64(output->rotate_duration, 1500 * GST_MSECOND);
+  fail_unless_equals_int(output->max_files, 4);
+  fail_unless_equals_string(output->index, "rec.json");
+  fail_unless_equals_int(output->writer.write_size, 256 * 1024);
+  fail_unless_equals_uint64(output->writer.preallocate, 8 * 1024 * 1024);
+  fail_unless(output->writer.direct);
+  fail_unless_equals_uint64(output->writer.sync_interval, 2 * GST_SECOND);
+  fail_unless(rerun_disk_writer_options_enabled(&output->writer));
+
+  rerun_output_clear(&outputs);
+}
+GST_END_TEST
+
+GST_START_TEST(test_parse_invalid)
+{
+  static const gchar *invalid[] = {
+    "file",                                     // No location
+    "ftp, location=out.rrd",                    // Unknown kind
+    "fd",                                       // No descriptor
+    "fd, fd=-1",
+    "grpc, max-fps=-1",
+    "grpc, keep-every=-2",
+    "grpc, keep-every=1.5",                     // Not a whole number of frames
+    "grpc, policy=wait",
+    "grpc, max-fps=fast",
+    "grpc, rotate-size=1",                      // File options on other kinds
+    "stdout, write-size=64",
+    "file, location=out.rrd, direct-io=maybe",
+    "file, location=out.rrd, rotate-duration=-5",
+    "file location",                            // Not a structure
+  };
+
+  for (const gchar *description : invalid) {
+    std::vector<RerunOutput> outputs;
+    GError *error = NULL;
+
+    fail_if(rerun_output_parse(description, &outputs, &error), "%s was accepted", description);
+    fail_unless(error != NULL);
+    fail_unless(g_error_matches(error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS));
+    fail_unless(outputs.empty());
+    g_error_free(error);
+  }
+
+  // Outputs before the invalid one are kept, the ones after are not parsed
+  std::vector<RerunOutput> outputs;
+  fail_if(rerun_output_parse("spawn; ftp; stdout", &outputs, NULL));
+  fail_unless_equals_int(outputs.size(), 1);
+  fail_unless_equals_int(outputs[0].kind, RERUN_OUTPUT_SPAWN);
+  rerun_output_clear(&outputs);
+}
+GST_END_TEST
+
+GST_START_TEST(test_set_groups_by_rate)
+{
+  std::vector<RerunOutput> outputs;
+
+  // a and c share a stream, b has its own rate and rotating d its own file
+  parse_in_tmp(
+      "file, location=%s/a.rrd; file, location=%s/b.rrd, max-fps=5; file, location=%s/c.rrd; "
+      "file, location=%s/d.rrd, rotate-duration=60",
+      &outputs);
+
+  RerunOutputSet *set = rerun_output_set_new("test", outputs, NULL, NULL, NULL);
+  fail_unless(set != NULL);
+  fail_unless_equals_int(rerun_output_set_get_n_streams(set), 3);
+  fail_unless_equals_int(rerun_output_set_all(set), 0x7);
+  for (guint i = 0; i < 3; i++) {
+    fail_unless(rerun_output_set_get_stream(set, i) != NULL);
+  }
+  rerun_output_set_free(set);
+
+  for (const gchar *name : { "a.rrd", "b.rrd", "c.rrd", "d.rrd" }) {
+    gchar *path = g_build_filename(tmp_dir, name, NULL);
+    fail_unless(g_file_test(path, G_FILE_TEST_EXISTS), "%s was not written", name);
+    g_free(path);
+  }
+
+  rerun_output_clear(&outputs);
+}
+GST_END_TEST
+
+GST_START_TEST(test_set_admit)
+{
+  std::vector<RerunOutput> outputs;
+  RerunOutputPacing pacing;
+  guint admitted[3] = { 0, 0, 0 };
+
+  parse_in_tmp(
+      "file, location=%s/all.rrd, policy=block; file, location=%s/fps.rrd, max-fps=5; "
+      "file, location=%s/third.rrd, keep-every=3",
+      &outputs);
+
+  RerunOutputSet *set = rerun_output_set_new("test", outputs, NULL, NULL, NULL);
+  fail_unless(set != NULL);
+  fail_unless_equals_int(rerun_output_set_get_n_streams(set), 3);
+  fail_unless_equals_int(rerun_output_set_get_blocking(set), 0x1);
+
+  // Ten seconds at 25 fps
+  rerun_output_pacing_reset(&pacing);
+  for (guint64 index = 0; index < 250; index++) {
+    guint mask = rerun_output_set_admit(set, &pacing, index, index * FRAME);
+
+    if (index % 3 == 0) {
+      fail_unless(mask & 0x4, "frame %" G_GUINT64_FORMAT " skipped", index);
+    } else {
+      fail_if(mask & 0x4, "frame %" G_GUINT64_FORMAT " kept", index);
+    }
+
+    for (guint i = 0; i < 3; i++) {
+      admitted[i] += (mask >> i) & 1;
+    }
+  }
+
+  fail_unless_equals_int(admitted[0], 250);
+  fail_unless(admitted[1] >= 50 && admitted[1] <= 51, "%u frames at 5 fps", admitted[1]);
+  fail_unless_equals_int(admitted[2], 84);
+
+  // Frames without a running time only go through the frame count
+  fail_unless_equals_int(rerun_output_set_admit(set, &pacing, 1, GST_CLOCK_TIME_NONE), 0x3);
+
+  rerun_output_set_free(set);
+  rerun_output_clear(&outputs);
+}
+GST_END_TEST
+
+GST_START_TEST(test_set_acquire_shares)
+{
+  std::vector<RerunOutput> outputs;
+  std::vector<RerunOutput> other;
+
+  parse_in_tmp("file, location=%s/shared.rrd", &outputs);
+  parse_in_tmp("file, location=%s/other.rrd", &other);
+
+  RerunOutputSet *set = rerun_output_set_acquire("test", outputs, NULL, NULL, NULL);
+  fail_unless(set != NULL);
+
+  // Same recording and outputs: one set, released by both users
+  fail_unless(rerun_output_set_acquire("test", outputs, NULL, NULL, NULL) == set);
+
+  RerunOutputSet *by_id = rerun_output_set_acquire("another", outputs, NULL, NULL, NULL);
+  RerunOutputSet *by_output = rerun_output_set_acquire("test", other, NULL, NULL, NULL);
+  fail_unless(by_id != NULL && by_id != set);
+  fail_unless(by_output != NULL && by_output != set);
+
+  rerun_output_set_release(by_id);
+  rerun_output_set_release(by_output);
+  rerun_output_set_release(set);
+
+  // Still open for the second user
+  fail_unless(rerun_output_set_get_stream(set, 0) != NULL);
+  rerun_output_set_release(set);
+
+  // A new set once the last one is gone
+  set = rerun_output_set_acquire("test", outputs, NULL, NULL, NULL);
+  fail_unless(set != NULL);
+  rerun_output_set_release(set);
+
+  rerun_output_clear(&outputs);
+  rerun_output_clear(&other);
+}
+GST_END_TEST
+
+GST_START_TEST(test_set_callback_not_shared)
+{
+  std::vector<RerunOutput> outputs;
+  gsize first_bytes = 0;
+  gsize second_bytes = 0;
+
+  fail_unless(rerun_output_parse("callback", &outputs, NULL));
+
+  RerunOutputSet *first = rerun_output_set_acquire("test", outputs, count_bytes, &first_bytes, NULL);
+  RerunOutputSet *second = rerun_output_set_acquire("test", outputs, count_bytes, &second_bytes, NULL);
+  fail_unless(first != NULL && second != NULL);
+  fail_unless(first != second);
+
+  rerun_output_set_get_stream(first, 0)->log("log", rerun::archetypes::TextLog("first"));
+  rerun_output_set_get_stream(second, 0)->log("log", rerun::archetypes::TextLog("second"));
+
+  rerun_output_set_release(first);
+  rerun_output_set_release(second);
+
+  // Each callback got a byte stream of its own
+  fail_unless(first_bytes > 0);
+  fail_unless(second_bytes > 0);
+
+  rerun_output_clear(&outputs);
+}
+GST_END_TEST
+
+typedef struct {
+  gint fd;
+  GByteArray *data;
+} Reader;
+
+static gpointer read_all(gpointer user_data)
+{
+  Reader *reader = (Reader *) user_data;
+  guint8 chunk[4096];
+  gssize size;
+
+  while ((size = read(reader->fd, chunk, sizeof(chunk))) != 0) {
+    if (size > 0) {
+      g_byte_array_append(reader->data, chunk, size);
+    } else if (errno != EINTR) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+GST_START_TEST(test_set_fd)
+{
+  std::vector<RerunOutput> outputs;
+  gint broken[2];
+  gint working[2];
+  Reader reader;
+
+  fail_unless(g_unix_open_pipe(broken, FD_CLOEXEC, NULL));
+  fail_unless(g_unix_open_pipe(working, FD_CLOEXEC, NULL));
+
+  // Nobody reads the first descriptor, which must not stop the second one
+  close(broken[0]);
+  reader = { working[0], g_byte_array_new() };
+  GThread *thread = g_thread_new("test-reader", read_all, &reader);
+
+  gchar *description = g_strdup_printf("fd, fd=%d; fd, fd=%d", broken[1], working[1]);
+  fail_unless(rerun_output_parse(description, &outputs, NULL));
+  g_free(description);
+
+  RerunOutputSet *set = rerun_output_set_new("test", outputs, NULL, NULL, NULL);
+  fail_unless(set != NULL);
+  rerun_output_set_get_stream(set, 0)->log("log", rerun::archetypes::TextLog("through a descriptor"));
+  rerun_output_set_free(set);
+
+  // The descriptors stay open, the end of the stream is up to their owner
+  close(broken[1]);
+  close(working[1]);
+  g_thread_join(thread);
+  close(working[0]);
+
+  fail_unless(reader.data->len > 4, "%u bytes read", reader.data->len);
+  fail_unless(memcmp(reader.data->data, "RRF", 3) == 0);
+
+  g_byte_array_unref(reader.data);
+  rerun_output_clear(&outputs);
+}
+GST_END_TEST
+
+static Suite* rerunoutput_suite(void)
+{
+  Suite *s = suite_create("rerunoutput");
+  TCase *tc = tcase_create("parse");
+
+  tcase_add_test(tc, test_parse_kinds);
+  tcase_add_test(tc, test_parse_rates);
+  tcase_add_test(tc, test_parse_file_options);
+  tcase_add_test(tc, test_parse_invalid);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("set");
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_set_groups_by_rate);
+  tcase_add_test(tc, test_set_admit);
+  tcase_add_test(tc, test_set_acquire_shares);
+  tcase_add_test(tc, test_set_callback_not_shared);
+  tcase_add_test(tc, test_set_fd);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+GST_CHECK_MAIN(rerunoutput);
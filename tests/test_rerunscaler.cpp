@@ -0,0 +1,153 @@
+#include <gst/check/gstcheck.h>
+#include "rerunscaler.hpp"
+
+#include <vector>
+
+static const GstVideoFormat formats[] = {
+  GST_VIDEO_FORMAT_RGB,
+  GST_VIDEO_FORMAT_RGBA,
+  GST_VIDEO_FORMAT_GRAY8,
+  GST_VIDEO_FORMAT_NV12,
+  GST_VIDEO_FORMAT_I420,
+};
+
+// Bytes per pixel of @plane, 2 for the interleaved NV12 chroma
+static guint plane_channels(const GstVideoInfo *info, guint plane)
+{
+  for (guint comp = 0; comp < GST_VIDEO_INFO_N_COMPONENTS(info); comp++) {
+    if (GST_VIDEO_INFO_COMP_PLANE(info, comp) == (gint) plane) {
+      return GST_VIDEO_INFO_COMP_PSTRIDE(info, comp);
+    }
+  }
+  return 1;
+}
+
+// What rerun_frame_downscale() promises, one output byte at a time
+static void downscale_reference(const GstVideoFrame *frame, const RerunPlaneLayout *layout,
+    guint factor, guint8 *dest)
+{
+  for (guint plane = 0; plane < layout->n_planes; plane++) {
+    guint channels = plane_channels(&frame->info, plane);
+    const guint8 *src = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, plane);
+    gsize stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, plane);
+    guint8 *out = dest + layout->offset[plane];
+
+    for (guint row = 0; row < layout->rows[plane]; row++) {
+      for (gsize x = 0; x < layout->row_bytes[plane] / channels; x++) {
+        for (guint c = 0; c < channels; c++) {
+          guint sum = 0;
+          for (guint dy = 0; dy < factor; dy++) {
+            for (guint dx = 0; dx < factor; dx++) {
+              sum += src[(row * factor + dy) * stride + (x * factor + dx) * channels + c];
+            }
+          }
+          out[row * layout->row_bytes[plane] + x * channels + c] =
+              (sum + factor * factor / 2) / (factor * factor);
+        }
+      }
+    }
+  }
+}
+
+// Downscales a @width x @height frame of noise as the sink does, and
+// compares every byte with the reference
+static void check_downscale(GstVideoFormat format, guint factor, gint width, gint height)
+{
+  GstVideoInfo info;
+  GstVideoInfo scaled_info;
+  RerunPlaneLayout layout;
+  GstVideoFrame frame;
+  guint32 seed = 1;
+
+  gst_video_info_set_format(&info, format, width, height);
+  GstBuffer *buffer = gst_buffer_new_allocate(NULL, GST_VIDEO_INFO_SIZE(&info), NULL);
+  GstMapInfo map;
+
+  // Extremes included, so the rounding is checked where it could overflow
+  fail_unless(gst_buffer_map(buffer, &map, GST_MAP_WRITE));
+  for (gsize i = 0; i < map.size; i++) {
+    seed = seed * 1103515245 + 12345;
+    map.data[i] = (seed >> 16) % 5 == 0 ? 255 : seed >> 24;
+  }
+  gst_buffer_unmap(buffer, &map);
+
+  fail_unless(gst_video_frame_map(&frame, &info, buffer, GST_MAP_READ));
+
+  gint scaled_width = width / factor;
+  gint scaled_height = height / factor;
+  if (GST_VIDEO_INFO_N_PLANES(&info) > 1) {
+    scaled_width &= ~1;
+    scaled_height &= ~1;
+  }
+  gst_video_info_set_format(&scaled_info, format, scaled_width, scaled_height);
+  rerun_plane_layout_init(&layout, &scaled_info);
+
+  std::vector<guint8> expected(layout.size);
+  std::vector<guint8> scaled(layout.size);
+  downscale_reference(&frame, &layout, factor, expected.data());
+  rerun_frame_downscale(&frame, &layout, factor, scaled.data());
+
+  gsize i = 0;
+  while (i < layout.size && scaled[i] == expected[i]) {
+    i++;
+  }
+  fail_unless(i == layout.size, "%s %dx%d / %u: byte %" G_GSIZE_FORMAT " is %u, not %u",
+      gst_video_format_to_string(format), width, height, factor, i, scaled[i], expected[i]);
+
+  gst_video_frame_unmap(&frame);
+  gst_buffer_unref(buffer);
+}
+
+GST_START_TEST(test_supports)
+{
+  for (GstVideoFormat format : formats) {
+    fail_unless(rerun_scaler_supports(format, 2));
+    fail_unless(rerun_scaler_supports(format, 4));
+    fail_if(rerun_scaler_supports(format, 1));
+    fail_if(rerun_scaler_supports(format, 3));
+    fail_if(rerun_scaler_supports(format, 8));
+  }
+
+  fail_if(rerun_scaler_supports(GST_VIDEO_FORMAT_YUY2, 2));
+  fail_if(rerun_scaler_supports(GST_VIDEO_FORMAT_GRAY16_LE, 2));
+}
+GST_END_TEST
+
+GST_START_TEST(test_downscale_by_2)
+{
+  // 136 pixels take the vector path of the 2x2 luma kernel and its tail;
+  // odd sizes leave partial blocks that must be ignored
+  for (GstVideoFormat format : formats) {
+    check_downscale(format, 2, 64, 16);
+    check_downscale(format, 2, 136, 24);
+    check_downscale(format, 2, 70, 18);
+    check_downscale(format, 2, 37, 11);
+  }
+}
+GST_END_TEST
+
+GST_START_TEST(test_downscale_by_4)
+{
+  for (GstVideoFormat format : formats) {
+    check_downscale(format, 4, 64, 16);
+    check_downscale(format, 4, 136, 24);
+    check_downscale(format, 4, 70, 18);
+    check_downscale(format, 4, 37, 11);
+  }
+}
+GST_END_TEST
+
+static Suite* rerunscaler_suite(void)
+{
+  Suite *s = suite_create("rerunscaler");
+  TCase *tc = tcase_create("downscale");
+
+  tcase_add_test(tc, test_supports);
+  tcase_add_test(tc, test_downscale_by_2);
+  tcase_add_test(tc, test_downscale_by_4);
+
+  suite_add_tcase(s, tc);
+  return s;
+}
+
+GST_CHECK_MAIN(rerunscaler);
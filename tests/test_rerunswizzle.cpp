@@ -0,0 +1,93 @@
+#include <gst/check/gstcheck.h>
+#include "rerunswizzle.hpp"
+
+#include <vector>
+
+#define ROWS 3
+#define MAX_PIXELS 70
+
+// Stride padding on both sides; the destination padding must survive
+#define SRC_PADDING 12
+#define DEST_PADDING 5
+#define GUARD 0xcd
+
+// Runs the kernel on every width up to MAX_PIXELS, which covers the full
+// vectors of each implementation and every length of their scalar tails
+static void check_order(const guint8 order[4], guint out_channels)
+{
+  for (gsize pixels = 1; pixels <= MAX_PIXELS; pixels++) {
+    gsize src_stride = pixels * 4 + SRC_PADDING;
+    gsize dest_stride = pixels * out_channels + DEST_PADDING;
+    std::vector<guint8> src(src_stride * ROWS);
+    std::vector<guint8> dest(dest_stride * ROWS, GUARD);
+
+    for (gsize i = 0; i < src.size(); i++) {
+      src[i] = (guint8) (i * 7 + 3);
+    }
+
+    rerun_swizzle_rows(dest.data(), dest_stride, src.data(), src_stride, pixels, ROWS,
+        order, out_channels);
+
+    for (guint row = 0; row < ROWS; row++) {
+      const guint8 *s = &src[row * src_stride];
+      const guint8 *d = &dest[row * dest_stride];
+
+      for (gsize x = 0; x < pixels; x++) {
+        for (guint c = 0; c < out_channels; c++) {
+          fail_unless_equals_int(d[x * out_channels + c], s[x * 4 + order[c]]);
+        }
+      }
+      for (gsize i = pixels * out_channels; i < dest_stride; i++) {
+        fail_unless_equals_int(d[i], GUARD);
+      }
+    }
+  }
+}
+
+GST_START_TEST(test_swizzle_impl)
+{
+  const gchar *impl = rerun_swizzle_get_impl();
+
+  fail_unless(impl != NULL);
+  GST_INFO("Swizzle kernel: %s", impl);
+}
+GST_END_TEST
+
+GST_START_TEST(test_swizzle_rgb)
+{
+  static const guint8 bgrx[4] = { 2, 1, 0, 3 };
+  static const guint8 xrgb[4] = { 1, 2, 3, 0 };
+  static const guint8 xbgr[4] = { 3, 2, 1, 0 };
+
+  check_order(bgrx, 3);
+  check_order(xrgb, 3);
+  check_order(xbgr, 3);
+}
+GST_END_TEST
+
+GST_START_TEST(test_swizzle_rgba)
+{
+  static const guint8 bgra[4] = { 2, 1, 0, 3 };
+  static const guint8 argb[4] = { 1, 2, 3, 0 };
+  static const guint8 abgr[4] = { 3, 2, 1, 0 };
+
+  check_order(bgra, 4);
+  check_order(argb, 4);
+  check_order(abgr, 4);
+}
+GST_END_TEST
+
+static Suite* rerunswizzle_suite(void)
+{
+  Suite *s = suite_create("rerunswizzle");
+  TCase *tc = tcase_create("rows");
+
+  tcase_add_test(tc, test_swizzle_impl);
+  tcase_add_test(tc, test_swizzle_rgb);
+  tcase_add_test(tc, test_swizzle_rgba);
+
+  suite_add_tcase(s, tc);
+  return s;
+}
+
+GST_CHECK_MAIN(rerunswizzle);